@@ -17,6 +17,7 @@
 
 #include <infini_operators.h>
 #include "infinirt.h"
+#include "infiniccl.h"
 
 #ifndef INFINI_DATATYPE
 #define INFINI_DATATYPE
@@ -72,7 +73,7 @@ typedef struct
 //////////////////// APIs ///////////////////////
 /// @brief 创建模型
 /// @param device 协处理器种类
-/// @param ndev 协处理器数量
+/// @param ndev 协处理器数量，注意力头、FFN 和输出层词表按设备切分
 /// @param dev_ids 协处理器编号，长度为 ndev
 __C __export struct Model *
 create_model(LlamaMeta const *,
@@ -81,6 +82,91 @@ create_model(LlamaMeta const *,
              unsigned int ndev,
              unsigned int const *dev_ids);
 
+/// @brief 创建张量并行与流水线并行组合的模型，create_model 即 pp 为 1 的情形
+/// @param tp 每个流水线阶段内的张量并行设备数，权重按 tp 切分
+/// @param pp 流水线阶段数，各阶段按顺序持有连续的若干层；首阶段持有输入嵌入，末阶段持有输出层
+/// @param dev_ids 协处理器编号，长度为 tp * pp，按阶段排列：第 s 阶段为 dev_ids[s * tp, (s + 1) * tp)
+/// @note 阶段之间只传递隐藏状态；infer 将批次按请求拆成至多 pp 个微批次依次流过各阶段。
+/// 互联带宽较低、all-reduce 延迟占主导时，可用较小的 tp 换取更高吞吐。不支持 INFER_MODE_DUAL_STREAM
+__C __export struct Model *
+create_model_parallel(LlamaMeta const *,
+                      LlamaWeights const *,
+                      DeviceType device,
+                      unsigned int tp,
+                      unsigned int pp,
+                      unsigned int const *dev_ids);
+
+/// @brief 创建跨进程张量并行中的一个分片，每个进程持有一个设备
+/// @param dev_id 本进程使用的协处理器编号
+/// @param comm 由 infinicclCommInitRank 创建的通信器，模型销毁时一并释放；nrank 为 1 时可为空
+/// @param rank 本进程在通信器中的序号，决定加载的权重分片
+/// @param nrank 通信器中的进程总数
+/// @note 所有进程须以相同参数同步调用 infer，每个进程都会得到采样结果；不支持 INFER_MODE_DUAL_STREAM
+__C __export struct Model *
+create_model_with_comm(LlamaMeta const *,
+                       LlamaWeights const *,
+                       DeviceType device,
+                       unsigned int dev_id,
+                       infinicclComm_t comm,
+                       unsigned int rank,
+                       unsigned int nrank);
+
+typedef enum {
+    // 所有批次在同一条计算流上按提交顺序执行
+    INFER_MODE_DEFAULT = 0,
+    // 解码批次（每个请求 1 个 token）在高优先级流上执行，其余批次在低优先级流上执行；
+    // 两类批次可由不同线程同时调用 infer，长提示词的预填充不会阻塞解码
+    INFER_MODE_DUAL_STREAM = 1,
+} InferMode;
+
+/// @brief 设置推理模式，不可与 infer 并发调用
+__C __export void
+set_infer_mode(struct Model *, InferMode mode);
+
+/// @brief 将多卡推理中的 all-reduce 按 token 切成 nchunk 段，在独立的通信流上
+/// 与后续分段的 o_proj/MLP 计算重叠；仅用于预填充等 token 较多的批次，
+/// 1 表示关闭（默认）。不可与 infer 并发调用
+/// @note CPU 与模拟设备上集合通信和算子在同一线程中串行执行，无法重叠，此设置不生效
+__C __export void
+set_comm_overlap(struct Model *, unsigned int nchunk);
+
+/// @brief 设置多卡推理中 all-reduce 的压缩方式：传输前按块量化为 int8 或 fp8，
+/// 以精度换取带宽，适用于无 NVLink 等带宽受限的互联；后端不支持时退回精确
+/// all-reduce。默认 INFINICCL_COMPRESSION_NONE。不可与 infer 并发调用
+__C __export void
+set_comm_compression(struct Model *, infinicclCompression_t compression);
+
+/// @brief 分块预填充：infer 的 token 总数超过 max_tokens 时，拆成多次前向计算，
+/// 每次至多 max_tokens 个 token，激活显存因此与提示词长度无关。0 表示不限制（默认）。
+/// 不可与 infer 并发调用
+/// @note infer 在所有分块完成后才返回，解码结果仍会被同批的长提示词延后；
+/// 需要限制解码延迟时使用 infer_pass
+__C __export void
+set_prefill_chunk(struct Model *, unsigned int max_tokens);
+
+typedef enum {
+    MEMORY_CATEGORY_WEIGHT = 0,
+    MEMORY_CATEGORY_KV_CACHE = 1,
+    MEMORY_CATEGORY_ACTIVATION = 2,
+    MEMORY_CATEGORY_WORKSPACE = 3,
+    MEMORY_CATEGORY_COUNT = 4,
+} MemoryCategory;
+
+typedef struct
+{
+    // 按 MemoryCategory 索引，单位为字节
+    size_t current[MEMORY_CATEGORY_COUNT];
+    size_t peak[MEMORY_CATEGORY_COUNT];
+    // 所有类别之和；total_peak 为总量的峰值，不等于各类峰值之和
+    size_t total;
+    size_t total_peak;
+} MemoryStats;
+
+/// @brief 查询模型在单个设备上的显存占用
+/// @param idev 设备在 create_model 的 dev_ids 中的序号，create_model_with_comm 创建的模型为 0
+__C __export void
+get_memory_stats(struct Model const *, unsigned int idev, MemoryStats *stats);
+
 /// @brief 创建 KV Cache
 __C __export struct KVCache *
 create_kv_cache(struct Model const *);
@@ -90,11 +176,48 @@ __C __export struct KVCache *
 duplicate_kv_cache(struct Model const *,
                    struct KVCache const *, unsigned int seq_len);
 
-/// @brief 销毁 KV Cache
+/// @brief 销毁 KV Cache，须在销毁模型之前调用
 __C __export void
 drop_kv_cache(struct Model const *,
               struct KVCache *);
 
+/// @brief 创建跨请求的前缀缓存：以基数树按 token 序列索引已计算的 KV，
+/// 共享系统提示词或少样本前缀的请求只需预填充其余部分
+/// @param max_bytes 每个设备上缓存可占用的显存上限，超出时按最近最少使用淘汰
+__C __export struct PrefixCache *
+create_prefix_cache(struct Model const *, size_t max_bytes);
+
+/// @brief 查找 tokens 最长的已缓存前缀，将其 KV 复制到 kv_cache 的位置 [0, 返回值)
+/// @return 命中的 token 数，至多为 ntok - 1，使最后一个 token 仍经预填充得到采样结果；
+/// 调用方随后以 req_pos 为返回值提交其余 token
+__C __export unsigned int
+prefix_cache_match(struct PrefixCache *,
+                   unsigned int ntok, unsigned int const *tokens,
+                   struct KVCache *kv_cache);
+
+/// @brief 将 kv_cache 中位置 [0, ntok) 的 KV 以 tokens 为键加入缓存，已缓存的部分不重复存储；
+/// 新增部分超出缓存容量时只存储能放下的前段。通常在预填充完成后调用。与 prefix_cache_match 之间线程安全
+__C __export void
+prefix_cache_insert(struct PrefixCache *,
+                    unsigned int ntok, unsigned int const *tokens,
+                    struct KVCache const *kv_cache);
+
+typedef struct
+{
+    // 查找的 token 总数与命中的 token 总数
+    size_t lookup_tokens, hit_tokens;
+    // 当前驻留的 token 数与累计淘汰的 token 数
+    size_t resident_tokens, evicted_tokens;
+} PrefixCacheStats;
+
+/// @brief 查询前缀缓存的累计统计
+__C __export void
+get_prefix_cache_stats(struct PrefixCache const *, PrefixCacheStats *stats);
+
+/// @brief 销毁前缀缓存，须在销毁模型之前调用
+__C __export void
+destroy_prefix_cache(struct PrefixCache *);
+
 /// @brief 推理
 /// @param ntok 输入 token 总数
 /// @param tokens 输入 token
@@ -113,6 +236,84 @@ infer(struct Model const *,
       struct KVCache **kv_caches, unsigned int *ans,
       float temperature, unsigned int topk, float topp);
 
+/// @brief 在 set_prefill_chunk 的预算内执行一次前向计算后立即返回，参数与 infer 相同。
+/// 解码请求排在最前，其余预算按顺序分给提示词
+/// @param req_done 每个请求本次处理的 token 数，介于 0 与 req_lens 之间；
+/// 等于 req_lens 的请求在 ans 中有采样结果，其余请求的 ans 不变
+/// @note 调用方下次以剩余的 token 重新提交未完成的请求，req_pos 增加 req_done。
+/// 未设置预算或 token 总数不超过预算时等同于 infer，req_done 等于 req_lens
+__C __export void
+infer_pass(struct Model const *,
+           unsigned int ntok, unsigned int const *tokens,
+           unsigned int nreq, unsigned int const *req_lens, unsigned int const *req_pos,
+           struct KVCache **kv_caches, unsigned int *ans, unsigned int *req_done,
+           float temperature, unsigned int topk, float topp);
+
+typedef enum {
+    // 每个请求的最后一个 token，共 nreq 行
+    INFER_OUTPUT_LAST = 0,
+    // 每个输入 token，共 ntok 行，按 tokens 的顺序排列，可用于评估提示词的困惑度
+    INFER_OUTPUT_ALL = 1,
+} InferOutputRows;
+
+typedef struct
+{
+    InferOutputRows rows;
+    // 输出层的 logits，[行数, dvoc]，类型为 dt_logits
+    void *logits;
+    // 每行 log-softmax 最大的 nlogprobs 项，[行数, nlogprobs]，从大到小排列；nlogprobs 不超过 dvoc
+    unsigned int nlogprobs;
+    unsigned int *logprob_ids;
+    float *logprobs;
+    // 末层 RMSNorm 之后、输出层之前的隐藏状态，[行数, d]，类型为 dt_logits
+    void *hidden;
+} InferOutputs;
+
+/// @brief 推理，并按需返回 logits、top-k log-prob 与隐藏状态
+/// @param outputs 调用方提供的输出缓冲，各项为空（nlogprobs 为 0）时不做相应的拷贝与计算；
+/// outputs 为空时按 INFER_OUTPUT_LAST 处理
+/// @param ans 与 infer 相同，每个请求最后一个 token 的采样结果
+/// @note 请求 log-prob 时须将全部 [行数, dvoc] 的 logits 拷回主机（即使 logits 为空），
+/// 由主机逐行选出前 nlogprobs 项，INFER_OUTPUT_ALL 下该拷贝随 ntok 增长。
+/// infer_ex 总是在 rank 0 汇总完整 logits，且不做分块预填充。create_model_with_comm 创建的模型中，
+/// 只有 rank 0 的进程写入 logits 与 log-prob；同一步中所有进程须同样调用 infer_ex（而非 infer），
+/// 且 rows 相同，其他进程可传入空的 outputs。rows 不一致时终止进程，混用 infer 与 infer_ex 会使集合通信无法匹配
+__C __export void
+infer_ex(struct Model const *,
+         unsigned int ntok, unsigned int const *tokens,
+         unsigned int nreq, unsigned int const *req_lens, unsigned int const *req_pos,
+         struct KVCache **kv_caches, InferOutputs const *outputs, unsigned int *ans,
+         float temperature, unsigned int topk, float topp);
+
+/// @brief 投机解码的一步：草稿模型逐个提出 k 个 token，目标模型一次前向验证全部候选
+/// @param model 目标模型
+/// @param draft 草稿模型，词表须与目标模型一致
+/// @param tokens 每个请求尚未写入 KV Cache 的最后一个 token，位于 req_pos
+/// @param kv_caches 目标模型中每个请求的 KV Cache
+/// @param draft_kv_caches 草稿模型中每个请求的 KV Cache，须与 kv_caches 覆盖相同位置
+/// @param ans 输出 token，长度为 nreq * (k + 1)，第 i 个请求的输出从 ans[i * (k + 1)] 开始
+/// @param ans_lens 每个请求的输出 token 数量，介于 1 与 k + 1 之间
+/// @note 输出均由目标模型采样，与逐个 token 的 infer 同分布。下一步以每个请求的最后一个输出为 tokens，
+/// req_pos 增加 ans_lens；未被接受位置的 KV Cache 随之作废，无需回滚。不可与 infer 并发调用
+__C __export void
+infer_speculative(struct Model *model, struct Model const *draft,
+                  unsigned int nreq, unsigned int const *tokens,
+                  unsigned int const *req_pos,
+                  struct KVCache **kv_caches, struct KVCache **draft_kv_caches,
+                  unsigned int k, unsigned int *ans, unsigned int *ans_lens,
+                  float temperature, unsigned int topk, float topp);
+
+typedef struct
+{
+    // 验证次数（每步每个请求计一次）、草稿提出的 token 数、被目标模型接受的 token 数；
+    // 接受率为 accepted / proposed，每次验证平均产出 (accepted + rounds) / rounds 个 token
+    size_t rounds, proposed, accepted;
+} SpeculativeStats;
+
+/// @brief 查询以该模型为目标模型的投机解码累计统计
+__C __export void
+get_speculative_stats(struct Model const *, SpeculativeStats *stats);
+
 /// @brief 销毁模型
 __C __export void
 destroy_model(struct Model *);
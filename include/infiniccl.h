@@ -62,9 +62,90 @@ __C __export infinicclStatus_t infinicclCommInitAll(DeviceType deviceType,
                                                     infinicclComm_t *comms,
                                                     unsigned int numDevices,
                                                     unsigned int const *deviceIDs);
+// Opaque rendezvous handle for communicators whose ranks live in different
+// processes. Created by one process and handed to every rank out of band.
+#define INFINICCL_UNIQUE_ID_BYTES 128
+typedef struct {
+    char internal[INFINICCL_UNIQUE_ID_BYTES];
+} infinicclUniqueId;
+
+// The id stays valid until all ranks of one communicator have joined; the
+// calling process must stay alive until then.
+__C __export infinicclStatus_t infinicclGetUniqueId(infinicclUniqueId *id);
+// Creates the communicator of `rank` out of `nranks`; blocks until every rank
+// has called it with the same id.
+__C __export infinicclStatus_t infinicclCommInitRank(DeviceType deviceType,
+                                                     infinicclComm_t *comm,
+                                                     infinicclUniqueId const *id,
+                                                     unsigned int nranks,
+                                                     unsigned int rank,
+                                                     unsigned int deviceID);
 __C __export infinicclStatus_t infinicclCommDestroy(infinicclComm_t comm);
 __C __export infinicclStatus_t infinicclAllReduceSum(
     infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
     InfiniDataType_t datatype, infinirtStream_t stream);
 
+// Ranks are positions in the deviceIDs array the communicators were created
+// from, or the rank given to infinicclCommInitRank. Like the all-reduce, every
+// call is ordered on `stream`.
+
+// recvbuf holds sendcount elements from each rank, in rank order.
+__C __export infinicclStatus_t infinicclAllGather(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t sendcount,
+    InfiniDataType_t datatype, infinirtStream_t stream);
+// Sums sendbuf (recvcount elements per rank) across ranks; rank r receives
+// block r of the sum.
+__C __export infinicclStatus_t infinicclReduceScatterSum(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t recvcount,
+    InfiniDataType_t datatype, infinirtStream_t stream);
+// Copies sendbuf of rank `root` into recvbuf of every rank.
+__C __export infinicclStatus_t infinicclBroadcast(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
+    InfiniDataType_t datatype, unsigned int root, infinirtStream_t stream);
+// Point-to-point transfer; each send must be matched by a recv on `peer`
+// with the same count and datatype.
+__C __export infinicclStatus_t infinicclSend(infinicclComm_t comm,
+                                             void *sendbuf, size_t count,
+                                             InfiniDataType_t datatype,
+                                             unsigned int peer,
+                                             infinirtStream_t stream);
+__C __export infinicclStatus_t infinicclRecv(infinicclComm_t comm,
+                                             void *recvbuf, size_t count,
+                                             InfiniDataType_t datatype,
+                                             unsigned int peer,
+                                             infinirtStream_t stream);
+
+// Fused all-reduce and RMSNorm over rows of `dim` elements:
+//   recvbuf = sum of sendbuf over ranks (+ residual when not null)
+//   normbuf = recvbuf / sqrt(mean(recvbuf^2) + epsilon) * weight
+// residual may alias recvbuf. Backends without a fused implementation report
+// INFINICCL_STATUS_DEVICE_NOT_SUPPORTED; callers then fall back to separate
+// operators.
+__C __export infinicclStatus_t infinicclAllReduceSumRMSNorm(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, void const *residual,
+    void *normbuf, void const *weight, size_t nrow, size_t dim, float epsilon,
+    InfiniDataType_t datatype, InfiniDataType_t weightType,
+    infinirtStream_t stream);
+
+typedef enum {
+    INFINICCL_COMPRESSION_NONE = 0,
+    // Symmetric int8 with one float scale per block.
+    INFINICCL_COMPRESSION_INT8 = 1,
+    // FP8 E4M3 (max 448) with one float scale per block.
+    INFINICCL_COMPRESSION_FP8_E4M3 = 2,
+} infinicclCompression_t;
+
+// Elements sharing one scale in a compressed transfer.
+#define INFINICCL_COMPRESSION_BLOCK 256
+
+// Lossy all-reduce for bandwidth-bound links: every transfer carries 8-bit
+// values plus a float scale per block, and sums are taken in float. The
+// result is quantized once more for the final exchange, so all ranks still
+// see identical values. INFINICCL_COMPRESSION_NONE is the exact all-reduce.
+// Backends without it report INFINICCL_STATUS_DEVICE_NOT_SUPPORTED.
+__C __export infinicclStatus_t infinicclAllReduceSumCompressed(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
+    InfiniDataType_t datatype, infinicclCompression_t compression,
+    infinirtStream_t stream);
+
 #endif
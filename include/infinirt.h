@@ -23,6 +23,8 @@ typedef enum
     DEVICE_NVIDIA,
     DEVICE_CAMBRICON,
     DEVICE_ASCEND,
+    // Host-backed accelerator with modeled transfer cost; see infinirtSimConfig_t.
+    DEVICE_SIM,
 } DeviceType;
 
 typedef enum
@@ -35,32 +37,56 @@ typedef enum
     INFINIRT_STATUS_INVALID_ARGUMENT = 5,
     INFINIRT_STATUS_ILLEGAL_MEMORY_ACCESS = 6,
     INFINIRT_STATUS_NOT_READY = 7,
+    INFINIRT_STATUS_OUT_OF_MEMORY = 8,
+    INFINIRT_STATUS_ALREADY_REGISTERED = 9,
 } infinirtStatus_t;
 
+// Devices without a built-in backend are looked up as libinfinirt_<device>.so,
+// first in INFINIRT_BACKEND_PATH, then next to the runtime library and then on
+// the loader search path.
 __C __export infinirtStatus_t infinirtInit(DeviceType device);
+// Registers the backend plugin at `path` for `device`; a NULL path uses the
+// default lookup. A device keeps the first backend registered for it.
+__C __export infinirtStatus_t infinirtLoadBackend(DeviceType device, const char *path);
 
 // Device
 __C __export infinirtStatus_t infinirtDeviceSynchronize(DeviceType device, uint32_t deviceId);
+__C __export infinirtStatus_t infinirtDeviceCanAccessPeer(int *canAccessPeer, DeviceType device, uint32_t deviceId, uint32_t peerDeviceId);
+// Lets deviceId access memory on peerDeviceId. Enabling twice is not an error.
+__C __export infinirtStatus_t infinirtDeviceEnablePeerAccess(DeviceType device, uint32_t deviceId, uint32_t peerDeviceId);
 
 // Stream
 struct infinirtStream;
 typedef struct infinirtStream *infinirtStream_t;
 #define INFINIRT_NULL_STREAM nullptr
 __C __export infinirtStatus_t infinirtStreamCreate(infinirtStream_t *pStream, DeviceType device, uint32_t deviceId);
+// Lower numbers mean higher priority, as in CUDA. Out-of-range priorities are
+// clamped; devices without priorities report the range [0, 0].
+__C __export infinirtStatus_t infinirtStreamCreateWithPriority(infinirtStream_t *pStream, DeviceType device, uint32_t deviceId, int priority);
+__C __export infinirtStatus_t infinirtDeviceGetStreamPriorityRange(DeviceType device, uint32_t deviceId, int *leastPriority, int *greatestPriority);
 __C __export infinirtStatus_t infinirtStreamDestroy(infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtStreamSynchronize(infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtGetRawStream(void** ptr, infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtGetStreamDeviceInfo(DeviceType* deviceType, uint32_t *deviceId, infinirtStream_t stream);
+// Runs fn(userData) on the host once all prior work in the stream has completed.
+// fn must not call infinirt functions that synchronize with the same stream.
+__C __export infinirtStatus_t infinirtLaunchHostFunc(infinirtStream_t stream, void (*fn)(void *), void *userData);
 
 // Event
 struct infinirtEvent;
 typedef struct infinirtEvent *infinirtEvent_t;
+#define INFINIRT_EVENT_DEFAULT 0x0
+// Timestamps the event when it completes so it can be passed to infinirtEventElapsedTime.
+#define INFINIRT_EVENT_ENABLE_TIMING 0x1
 __C __export infinirtStatus_t infinirtEventCreate(infinirtEvent_t *pEvent, DeviceType device, uint32_t deviceId);
+__C __export infinirtStatus_t infinirtEventCreateWithFlags(infinirtEvent_t *pEvent, DeviceType device, uint32_t deviceId, uint32_t flags);
 __C __export infinirtStatus_t infinirtEventRecord(infinirtEvent_t event, infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtEventQuery(infinirtEvent_t event);
 __C __export infinirtStatus_t infinirtEventSynchronize(infinirtEvent_t event);
 __C __export infinirtStatus_t infinirtEventDestroy(infinirtEvent_t event);
 __C __export infinirtStatus_t infinirtStreamWaitEvent(infinirtEvent_t event, infinirtStream_t stream);
+// Milliseconds between two completed timing events recorded on the same device.
+__C __export infinirtStatus_t infinirtEventElapsedTime(infinirtEvent_t start, infinirtEvent_t end, float *ms);
 
 // Memory
 __C __export infinirtStatus_t infinirtMalloc(void **pMemory, DeviceType device, uint32_t deviceId, size_t size);
@@ -69,9 +95,72 @@ __C __export infinirtStatus_t infinirtMallocHost(void **pMemory, DeviceType devi
 __C __export infinirtStatus_t infinirtFree(void *ptr, DeviceType device, uint32_t deviceId);
 __C __export infinirtStatus_t infinirtFreeAsync(void *ptr, DeviceType device, uint32_t deviceId, infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtFreeHost(void *ptr, DeviceType device, uint32_t deviceId);
+// Pins an existing host range so copies from it run without a bounce buffer.
+// Ranges must not overlap and are unregistered by their start address; one
+// that overlaps a registered range fails with INFINIRT_STATUS_ALREADY_REGISTERED
+// and leaves that registration in place.
+__C __export infinirtStatus_t infinirtHostRegister(void *ptr, DeviceType device, uint32_t deviceId, size_t size);
+__C __export infinirtStatus_t infinirtHostUnregister(void *ptr, DeviceType device, uint32_t deviceId);
 __C __export infinirtStatus_t infinirtMemcpyH2D(void *dst, DeviceType device, uint32_t deviceId, const void *src, size_t size);
 __C __export infinirtStatus_t infinirtMemcpyH2DAsync(void *dst, DeviceType device, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtMemcpyD2H(void *dst, const void* src, DeviceType device, uint32_t deviceId, size_t size);
+__C __export infinirtStatus_t infinirtMemcpyD2HAsync(void *dst, const void* src, DeviceType device, uint32_t deviceId, size_t size, infinirtStream_t stream);
 __C __export infinirtStatus_t infinirtMemcpy(void *dst, const void* src, DeviceType device, uint32_t deviceId, size_t size);
 __C __export infinirtStatus_t infinirtMemcpyAsync(void *dst, const void* src, DeviceType device, uint32_t deviceId, size_t size, infinirtStream_t stream);
+// Copies between two devices of the same type without staging through host
+// memory. The stream must belong to either device.
+__C __export infinirtStatus_t infinirtMemcpyPeer(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, DeviceType device, size_t size);
+__C __export infinirtStatus_t infinirtMemcpyPeerAsync(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, DeviceType device, size_t size, infinirtStream_t stream);
+
+// Memory pool
+// Freed blocks stay cached in the pool and are handed out again in stream
+// order, so steady-state allocation does not reach the device allocator.
+struct infinirtMemPool;
+typedef struct infinirtMemPool *infinirtMemPool_t;
+typedef struct
+{
+    // Cached bytes the pool may hold on to once blocks are freed; anything
+    // above is returned to the device. SIZE_MAX keeps everything.
+    size_t releaseThreshold;
+} infinirtMemPoolConfig_t;
+typedef struct
+{
+    size_t reservedCurrent; // bytes obtained from the device
+    size_t reservedPeak;
+    size_t usedCurrent; // bytes handed out to callers
+    size_t usedPeak;
+} infinirtMemPoolStats_t;
+// config may be NULL for the defaults.
+__C __export infinirtStatus_t infinirtMemPoolCreate(infinirtMemPool_t *pPool, DeviceType device, uint32_t deviceId, const infinirtMemPoolConfig_t *config);
+__C __export infinirtStatus_t infinirtMemPoolDestroy(infinirtMemPool_t pool);
+__C __export infinirtStatus_t infinirtMallocFromPoolAsync(void **pMemory, size_t size, infinirtMemPool_t pool, infinirtStream_t stream);
+// With a null stream the caller guarantees the memory is no longer in use.
+__C __export infinirtStatus_t infinirtFreeToPoolAsync(void *ptr, infinirtMemPool_t pool, infinirtStream_t stream);
+// Releases cached memory until at most minBytesToKeep remain reserved.
+__C __export infinirtStatus_t infinirtMemPoolTrim(infinirtMemPool_t pool, size_t minBytesToKeep);
+__C __export infinirtStatus_t infinirtMemPoolGetStats(infinirtMemPool_t pool, infinirtMemPoolStats_t *stats);
+
+// Simulated device
+// DEVICE_SIM memory is host memory and its streams are host threads, with the
+// same ordering rules as CUDA streams. Copies and stream work are delayed to
+// model the configured device, so overlap can be measured without one.
+// Kernels are not modeled: operators run on the calling thread as for
+// DEVICE_CPU, outside stream order and without launch latency.
+typedef struct
+{
+    // Copy bandwidth in bytes per second; 0 makes copies free.
+    double h2dBandwidth;
+    double d2hBandwidth;
+    double d2dBandwidth;
+    // Delay before each stream operation starts.
+    uint32_t launchLatencyUs;
+    // Bytes each device can allocate; 0 is unlimited. Allocations beyond it
+    // fail with INFINIRT_STATUS_OUT_OF_MEMORY.
+    size_t memoryCapacity;
+} infinirtSimConfig_t;
+// Defaults come from INFINIRT_SIM_H2D_GBPS, INFINIRT_SIM_D2H_GBPS,
+// INFINIRT_SIM_D2D_GBPS, INFINIRT_SIM_LAUNCH_US and INFINIRT_SIM_MEMORY_MB.
+// A new config applies to operations issued after the call.
+__C __export infinirtStatus_t infinirtSimSetConfig(const infinirtSimConfig_t *config);
+__C __export infinirtStatus_t infinirtSimGetConfig(infinirtSimConfig_t *config);
 #endif
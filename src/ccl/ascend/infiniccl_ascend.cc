@@ -1,4 +1,6 @@
 #include "infiniccl_ascend.h"
+#include "../backend.h"
+#include "../bootstrap.h"
 #include "../../runtime/runtime.h"
 #include <acl/acl.h>
 #include <hccl.h>
@@ -65,6 +67,29 @@ infinicclStatus_t infinicclAscendCommInitAll(infinicclComm_t *comms,
     return INFINICCL_STATUS_SUCCESS;
 }
 
+// Same scheme as CUDA: rank 0's HCCL root info goes through the bootstrap.
+infinicclStatus_t infinicclAscendCommInitRank(infinicclComm_t *comm,
+                                              infinicclUniqueId const *id,
+                                              unsigned int nranks,
+                                              unsigned int rank,
+                                              unsigned int deviceID) {
+    SWITCH_DEVICE(deviceID);
+    HcclRootInfo rootInfo{};
+    if (rank == 0) {
+        HCCL_CALL(HcclGetRootInfo(&rootInfo));
+    }
+    std::vector<HcclRootInfo> rootInfos(nranks);
+    auto status = bootstrapAllGather(id, nranks, rank, &rootInfo,
+                                     sizeof(rootInfo), rootInfos.data());
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    HcclComm hcclComm;
+    HCCL_CALL(HcclCommInitRootInfo(nranks, &rootInfos[0], rank, &hcclComm));
+    *comm = new InfiniComm{DEVICE_ASCEND, deviceID, (void *)hcclComm};
+    return INFINICCL_STATUS_SUCCESS;
+}
+
 infinicclStatus_t infinicclAscendCommDestroy(infinicclComm_t comm) {
     HCCL_CALL(HcclCommDestroy(getHcclComm(comm)));
     delete comm;
@@ -83,3 +108,115 @@ infinicclStatus_t infinicclAscendAllReduceSum(infinicclComm_t comm,
     infinirtStreamSynchronize(stream);
     return INFINICCL_STATUS_SUCCESS;
 }
+
+// Collectives that only move data go through HCCL as bytes, so they accept
+// every datatype. Like the all-reduce they wait for the stream before
+// returning.
+#define BYTE_COUNT(count, datatype)                                            \
+    ((uint64_t)(count) * cclDataTypeSize(datatype))
+
+infinicclStatus_t infinicclAscendAllGather(infinicclComm_t comm, void *sendbuf,
+                                           void *recvbuf, size_t sendcount,
+                                           InfiniDataType_t datatype,
+                                           infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    HCCL_CALL(HcclAllGather(sendbuf, recvbuf, BYTE_COUNT(sendcount, datatype),
+                            HCCL_DATA_TYPE_UINT8, getHcclComm(comm),
+                            getAscendStream(stream)));
+    infinirtStreamSynchronize(stream);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclAscendReduceScatterSum(infinicclComm_t comm,
+                                                  void *sendbuf, void *recvbuf,
+                                                  size_t recvcount,
+                                                  InfiniDataType_t datatype,
+                                                  infinirtStream_t stream) {
+    if (datatype != INFINI_F32 && datatype != INFINI_F16) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    HCCL_CALL(HcclReduceScatter(sendbuf, recvbuf, (uint64_t)recvcount,
+                                getAscneDtype(datatype), HCCL_REDUCE_SUM,
+                                getHcclComm(comm), getAscendStream(stream)));
+    infinirtStreamSynchronize(stream);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// HcclBroadcast works in place, so the root stages sendbuf into recvbuf.
+infinicclStatus_t infinicclAscendBroadcast(infinicclComm_t comm, void *sendbuf,
+                                           void *recvbuf, size_t count,
+                                           InfiniDataType_t datatype,
+                                           unsigned int root,
+                                           infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    uint32_t rank;
+    HCCL_CALL(HcclGetRankId(getHcclComm(comm), &rank));
+    if (rank == root && sendbuf != recvbuf) {
+        if (infinirtMemcpyAsync(recvbuf, sendbuf, DEVICE_ASCEND,
+                                comm->deviceID, BYTE_COUNT(count, datatype),
+                                stream) != INFINIRT_STATUS_SUCCESS) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    HCCL_CALL(HcclBroadcast(recvbuf, BYTE_COUNT(count, datatype),
+                            HCCL_DATA_TYPE_UINT8, root, getHcclComm(comm),
+                            getAscendStream(stream)));
+    infinirtStreamSynchronize(stream);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclAscendSend(infinicclComm_t comm, void *sendbuf,
+                                      size_t count, InfiniDataType_t datatype,
+                                      unsigned int peer,
+                                      infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    HCCL_CALL(HcclSend(sendbuf, BYTE_COUNT(count, datatype),
+                       HCCL_DATA_TYPE_UINT8, peer, getHcclComm(comm),
+                       getAscendStream(stream)));
+    infinirtStreamSynchronize(stream);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclAscendRecv(infinicclComm_t comm, void *recvbuf,
+                                      size_t count, InfiniDataType_t datatype,
+                                      unsigned int peer,
+                                      infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    HCCL_CALL(HcclRecv(recvbuf, BYTE_COUNT(count, datatype),
+                       HCCL_DATA_TYPE_UINT8, peer, getHcclComm(comm),
+                       getAscendStream(stream)));
+    infinirtStreamSynchronize(stream);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+const infinicclBackend *getAscendCclBackend() {
+    static const infinicclBackend backend = [] {
+        infinicclBackend table{};
+        table.abiVersion = INFINICCL_BACKEND_ABI_VERSION;
+        table.commInitAll = infinicclAscendCommInitAll;
+        table.commInitRank = infinicclAscendCommInitRank;
+        table.commDestroy = infinicclAscendCommDestroy;
+        table.allReduceSum = infinicclAscendAllReduceSum;
+        table.allGather = infinicclAscendAllGather;
+        table.reduceScatterSum = infinicclAscendReduceScatterSum;
+        table.broadcast = infinicclAscendBroadcast;
+        table.send = infinicclAscendSend;
+        table.recv = infinicclAscendRecv;
+        return table;
+    }();
+    return &backend;
+}
+
+#ifdef INFINIRT_BACKEND_PLUGIN
+__C __export const infinicclBackend *infinicclGetBackend() {
+    return getAscendCclBackend();
+}
+#endif
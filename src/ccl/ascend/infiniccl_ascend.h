@@ -14,6 +14,14 @@ infinicclStatus_t infinicclAscendCommInitAll(
     unsigned int const *deviceIDs
 ) IMPL_WITH_ASCEND 
 
+infinicclStatus_t infinicclAscendCommInitRank(
+    infinicclComm_t *comm,
+    infinicclUniqueId const *id,
+    unsigned int nranks,
+    unsigned int rank,
+    unsigned int deviceID
+) IMPL_WITH_ASCEND 
+
 infinicclStatus_t infinicclAscendCommDestroy(
     infinicclComm_t comm
 ) IMPL_WITH_ASCEND 
@@ -26,4 +34,45 @@ infinicclStatus_t infinicclAscendAllReduceSum(
     infinirtStream_t stream
 ) IMPL_WITH_ASCEND
 
+infinicclStatus_t infinicclAscendAllGather(
+    infinicclComm_t comm,
+    void *sendbuf,
+    void *recvbuf, size_t sendcount,
+    InfiniDataType_t datatype,
+    infinirtStream_t stream
+) IMPL_WITH_ASCEND
+
+infinicclStatus_t infinicclAscendReduceScatterSum(
+    infinicclComm_t comm,
+    void *sendbuf,
+    void *recvbuf, size_t recvcount,
+    InfiniDataType_t datatype,
+    infinirtStream_t stream
+) IMPL_WITH_ASCEND
+
+infinicclStatus_t infinicclAscendBroadcast(
+    infinicclComm_t comm,
+    void *sendbuf,
+    void *recvbuf, size_t count,
+    InfiniDataType_t datatype,
+    unsigned int root,
+    infinirtStream_t stream
+) IMPL_WITH_ASCEND
+
+infinicclStatus_t infinicclAscendSend(
+    infinicclComm_t comm,
+    void *sendbuf, size_t count,
+    InfiniDataType_t datatype,
+    unsigned int peer,
+    infinirtStream_t stream
+) IMPL_WITH_ASCEND
+
+infinicclStatus_t infinicclAscendRecv(
+    infinicclComm_t comm,
+    void *recvbuf, size_t count,
+    InfiniDataType_t datatype,
+    unsigned int peer,
+    infinirtStream_t stream
+) IMPL_WITH_ASCEND
+
 #endif /* INFINICCL_ASCEND_H_ */
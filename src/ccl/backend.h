@@ -0,0 +1,63 @@
+#ifndef INFINICCL_BACKEND_H
+#define INFINICCL_BACKEND_H
+#include "infiniccl.h"
+#include "../runtime/backend.h"
+
+// Collective entry points of one device backend, dispatched the same way as
+// the infinirt table. A runtime plugin may also export infinicclGetBackend
+// to provide collectives for its device.
+#define INFINICCL_BACKEND_ABI_VERSION 5
+
+struct infinicclBackend {
+    uint32_t abiVersion;
+    infinicclStatus_t (*commInitAll)(infinicclComm_t *comms, unsigned int numDevices, unsigned int const *deviceIDs);
+    infinicclStatus_t (*commInitRank)(infinicclComm_t *comm, infinicclUniqueId const *id, unsigned int nranks, unsigned int rank, unsigned int deviceID);
+    infinicclStatus_t (*commDestroy)(infinicclComm_t comm);
+    infinicclStatus_t (*allReduceSum)(infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count, InfiniDataType_t datatype, infinirtStream_t stream);
+    infinicclStatus_t (*allGather)(infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t sendcount, InfiniDataType_t datatype, infinirtStream_t stream);
+    infinicclStatus_t (*reduceScatterSum)(infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t recvcount, InfiniDataType_t datatype, infinirtStream_t stream);
+    infinicclStatus_t (*broadcast)(infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count, InfiniDataType_t datatype, unsigned int root, infinirtStream_t stream);
+    infinicclStatus_t (*send)(infinicclComm_t comm, void *sendbuf, size_t count, InfiniDataType_t datatype, unsigned int peer, infinirtStream_t stream);
+    infinicclStatus_t (*recv)(infinicclComm_t comm, void *recvbuf, size_t count, InfiniDataType_t datatype, unsigned int peer, infinirtStream_t stream);
+    // Optional.
+    infinicclStatus_t (*allReduceSumRMSNorm)(infinicclComm_t comm, void *sendbuf, void *recvbuf, void const *residual, void *normbuf, void const *weight, size_t nrow, size_t dim, float epsilon, InfiniDataType_t datatype, InfiniDataType_t weightType, infinirtStream_t stream);
+    // Optional; never called with INFINICCL_COMPRESSION_NONE.
+    infinicclStatus_t (*allReduceSumCompressed)(infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count, InfiniDataType_t datatype, infinicclCompression_t compression, infinirtStream_t stream);
+};
+
+// Element size of `datatype`, 0 when unknown. Collectives that only move data
+// transfer count * size bytes and accept any datatype.
+inline size_t cclDataTypeSize(InfiniDataType_t datatype) {
+    switch (datatype) {
+    case INFINI_BYTE:
+    case INFINI_I8:
+    case INFINI_U8:
+    case INFINI_F8:
+    case INFINI_BOOL:
+        return 1;
+    case INFINI_I16:
+    case INFINI_U16:
+    case INFINI_F16:
+    case INFINI_BF16:
+        return 2;
+    case INFINI_I32:
+    case INFINI_U32:
+    case INFINI_F32:
+        return 4;
+    case INFINI_I64:
+    case INFINI_U64:
+    case INFINI_F64:
+        return 8;
+    }
+    return 0;
+}
+
+#define INFINICCL_BACKEND_ENTRY "infinicclGetBackend"
+typedef const infinicclBackend *(*infinicclGetBackendFn)();
+
+// Built-in backends, defined next to their implementations.
+const infinicclBackend *getCpuCclBackend();
+const infinicclBackend *getSimCclBackend();
+const infinicclBackend *getCudaCclBackend();
+const infinicclBackend *getAscendCclBackend();
+#endif
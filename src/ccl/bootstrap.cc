@@ -0,0 +1,230 @@
+#include "bootstrap.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+// Gives up on a rendezvous that has not completed after this long.
+constexpr int ROOT_TIMEOUT_MS = 10 * 60 * 1000;
+// A root that is still starting up refuses connections for a moment.
+constexpr int CONNECT_RETRIES = 50;
+constexpr auto CONNECT_RETRY_DELAY = std::chrono::milliseconds(100);
+
+// Layout of infinicclUniqueId::internal.
+struct RootHandle {
+    uint64_t magic;
+    in_addr_t addr; // network order
+    in_port_t port; // network order
+};
+static_assert(sizeof(RootHandle) <= INFINICCL_UNIQUE_ID_BYTES,
+              "RootHandle does not fit in infinicclUniqueId");
+
+struct Header {
+    uint64_t magic;
+    uint32_t nranks;
+    uint32_t rank;
+    uint64_t size;
+};
+
+in_addr_t bootstrapAddr() {
+    auto env = std::getenv("INFINICCL_BOOTSTRAP_ADDR");
+    in_addr_t addr = inet_addr(env != nullptr ? env : "127.0.0.1");
+    return addr == INADDR_NONE ? inet_addr("127.0.0.1") : addr;
+}
+
+void closeAll(std::vector<int> const &fds) {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+// Accepts one connection per rank, then answers each with all blobs.
+void serveRoot(int listen_fd, uint64_t magic) {
+    std::vector<int> fds;
+    std::vector<char> blobs;
+    uint32_t nranks = 0, joined = 0;
+    uint64_t size = 0;
+    bool failed = false;
+    while (!failed && (nranks == 0 || joined < nranks)) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, ROOT_TIMEOUT_MS) <= 0) {
+            failed = true;
+            break;
+        }
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        Header header;
+        if (!socketRecvAll(fd, &header, sizeof(header)) ||
+            header.magic != magic) {
+            // Not one of ours; keep waiting for the real ranks.
+            close(fd);
+            continue;
+        }
+        if (nranks == 0) {
+            nranks = header.nranks;
+            size = header.size;
+            fds.assign(nranks, -1);
+            blobs.resize(nranks * size);
+        }
+        if (header.nranks != nranks || header.size != size ||
+            header.rank >= nranks || fds[header.rank] >= 0 ||
+            !socketRecvAll(fd, blobs.data() + header.rank * size, size)) {
+            close(fd);
+            failed = true;
+            break;
+        }
+        fds[header.rank] = fd;
+        joined++;
+    }
+    if (!failed) {
+        for (int fd : fds) {
+            socketSendAll(fd, blobs.data(), blobs.size());
+        }
+    }
+    // Ranks that see the connection close early report a failed init.
+    closeAll(fds);
+    close(listen_fd);
+}
+} // namespace
+
+bool socketSendAll(int fd, void const *data, size_t size) {
+    auto ptr = static_cast<char const *>(data);
+    while (size > 0) {
+        auto n = send(fd, ptr, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool socketRecvAll(int fd, void *data, size_t size) {
+    auto ptr = static_cast<char *>(data);
+    while (size > 0) {
+        auto n = recv(fd, ptr, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+int socketListen(unsigned int backlog, in_port_t *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, backlog) != 0 ||
+        getsockname(fd, (sockaddr *)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = addr.sin_port;
+    return fd;
+}
+
+int socketConnect(in_addr_t addr, in_port_t port) {
+    sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = addr;
+    peer.sin_port = port;
+    for (int attempt = 0; attempt < CONNECT_RETRIES; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (sockaddr *)&peer, sizeof(peer)) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        close(fd);
+        std::this_thread::sleep_for(CONNECT_RETRY_DELAY);
+    }
+    return -1;
+}
+
+infinicclStatus_t bootstrapCreateRoot(infinicclUniqueId *id) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = bootstrapAddr();
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (sockaddr *)&addr, &len) != 0) {
+        close(fd);
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    RootHandle handle{};
+    handle.magic = std::random_device()() |
+                   (uint64_t(std::random_device()()) << 32);
+    handle.addr = addr.sin_addr.s_addr;
+    handle.port = addr.sin_port;
+    std::memset(id, 0, sizeof(*id));
+    std::memcpy(id->internal, &handle, sizeof(handle));
+    std::thread(serveRoot, fd, handle.magic).detach();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+int bootstrapConnect(infinicclUniqueId const *id) {
+    RootHandle handle;
+    std::memcpy(&handle, id->internal, sizeof(handle));
+    return socketConnect(handle.addr, handle.port);
+}
+
+infinicclStatus_t bootstrapExchange(infinicclUniqueId const *id, int fd,
+                                    unsigned int nranks, unsigned int rank,
+                                    void const *data, size_t size, void *out) {
+    RootHandle handle;
+    std::memcpy(&handle, id->internal, sizeof(handle));
+    Header header{handle.magic, nranks, rank, size};
+    bool ok = socketSendAll(fd, &header, sizeof(header)) &&
+              socketSendAll(fd, data, size) &&
+              socketRecvAll(fd, out, nranks * size);
+    close(fd);
+    return ok ? INFINICCL_STATUS_SUCCESS : INFINICCL_STATUS_EXECUTION_FAILED;
+}
+
+infinicclStatus_t bootstrapAllGather(infinicclUniqueId const *id,
+                                     unsigned int nranks, unsigned int rank,
+                                     void const *data, size_t size, void *out) {
+    int fd = bootstrapConnect(id);
+    if (fd < 0) {
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    return bootstrapExchange(id, fd, nranks, rank, data, size, out);
+}
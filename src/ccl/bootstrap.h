@@ -0,0 +1,37 @@
+#ifndef INFINICCL_BOOTSTRAP_H
+#define INFINICCL_BOOTSTRAP_H
+#include "infiniccl.h"
+#include <netinet/in.h>
+
+// TCP rendezvous behind infinicclGetUniqueId / infinicclCommInitRank. The
+// unique id names a root socket served by a thread of the process that
+// created it; every rank connects once, sends a blob and receives the blobs
+// of all ranks. The root binds INFINICCL_BOOTSTRAP_ADDR (IPv4, default
+// 127.0.0.1), so set it to a routable address to span nodes.
+
+// Starts the root of one rendezvous and describes it in `id`.
+infinicclStatus_t bootstrapCreateRoot(infinicclUniqueId *id);
+
+// Connects to the root of `id`; returns the socket or -1.
+int bootstrapConnect(infinicclUniqueId const *id);
+
+// Sends `size` bytes for `rank` over a socket from bootstrapConnect and
+// receives nranks * size bytes in rank order into `out`. Closes the socket.
+infinicclStatus_t bootstrapExchange(infinicclUniqueId const *id, int fd,
+                                    unsigned int nranks, unsigned int rank,
+                                    void const *data, size_t size, void *out);
+
+// bootstrapConnect followed by bootstrapExchange.
+infinicclStatus_t bootstrapAllGather(infinicclUniqueId const *id,
+                                     unsigned int nranks, unsigned int rank,
+                                     void const *data, size_t size, void *out);
+
+// Blocking helpers shared with the socket transport. Both return false on
+// error or a closed peer.
+bool socketSendAll(int fd, void const *data, size_t size);
+bool socketRecvAll(int fd, void *data, size_t size);
+
+// Listening socket on any interface with an ephemeral port, or -1.
+int socketListen(unsigned int backlog, in_port_t *port);
+int socketConnect(in_addr_t addr, in_port_t port);
+#endif
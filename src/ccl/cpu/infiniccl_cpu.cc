@@ -0,0 +1,1001 @@
+#include "infiniccl_cpu.h"
+#include "../backend.h"
+#include "../../runtime/runtime.h"
+#include "../../utils.h"
+#include "socket_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+// Elements per rank chunk are a multiple of this so that neighbouring ranks
+// never write the same cache line.
+constexpr size_t CHUNK_ALIGN = 64;
+// Elements accumulated in float per pass over the senders.
+constexpr size_t REDUCE_TILE = 256;
+
+struct CpuCommGroup {
+    unsigned int size;
+    std::mutex mutex;
+    std::condition_variable cv;
+    unsigned int arrived = 0;
+    uint64_t generation = 0;
+    // Buffers published by each rank for the collective in flight.
+    std::vector<const void *> send;
+    std::vector<void *> recv;
+    std::vector<void *> norm;
+    // Point-to-point slots indexed by src * size + dst; a sender parks its
+    // buffer here until the receiver has copied it out.
+    std::vector<const void *> mailbox;
+    std::vector<size_t> mailbox_bytes;
+
+    explicit CpuCommGroup(unsigned int size)
+        : size(size), send(size), recv(size), norm(size), mailbox(size * size),
+          mailbox_bytes(size * size) {}
+
+    void barrier() {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto current = generation;
+        if (++arrived == size) {
+            arrived = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != current; });
+    }
+};
+
+struct CpuComm {
+    std::shared_ptr<CpuCommGroup> group;
+    unsigned int rank;
+    // Replaces the group for communicators from infinicclCommInitRank, whose
+    // ranks do not share an address space.
+    std::unique_ptr<SocketMesh> mesh;
+
+    unsigned int size() const { return mesh ? mesh->size() : group->size; }
+};
+
+inline CpuComm *getCpuComm(infinicclComm_t comm) {
+    return static_cast<CpuComm *>(comm->comm);
+}
+
+inline float bitsToFloat(uint32_t bits) {
+    float val;
+    std::memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+inline uint32_t floatToBits(float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+// Branch-free f16 conversions, with selects done on masks, so that loops
+// over a tile vectorize. They agree bit for bit with f16_to_f32 and
+// f32_to_f16 apart from NaN payloads, which f32_to_f16 drops anyway.
+inline float halfToFloat(uint16_t h) {
+    uint32_t w = (uint32_t)h << 16;
+    uint32_t sign = w & 0x80000000u;
+    uint32_t two_w = w + w;
+    // Rebias the exponent by scaling; covers normals, infinities and NaNs.
+    float normal = bitsToFloat((two_w >> 4) + (0xE0u << 23)) * 0x1.0p-112f;
+    // Subnormals: place the mantissa under a 0.5 exponent and subtract 0.5.
+    float subnormal = bitsToFloat((two_w >> 17) | (126u << 23)) - 0.5f;
+    uint32_t is_subnormal = -(uint32_t)(two_w < (1u << 27));
+    return bitsToFloat(sign | (floatToBits(subnormal) & is_subnormal) |
+                       (floatToBits(normal) & ~is_subnormal));
+}
+inline uint16_t floatToHalf(float val) {
+    // Rounds to nearest even by adding a bias that pushes the dropped bits
+    // out of the mantissa; overflow saturates to infinity.
+    float base = (std::fabs(val) * 0x1.0p+112f) * 0x1.0p-110f;
+    uint32_t w = floatToBits(val);
+    uint32_t shl1_w = w + w;
+    uint32_t sign = w & 0x80000000u;
+    uint32_t bias = std::max(shl1_w & 0xFF000000u, 0x71000000u);
+    base = bitsToFloat((bias >> 1) + 0x07800000u) + base;
+    uint32_t bits = floatToBits(base);
+    uint32_t nonsign = ((bits >> 13) & 0x7C00u) + (bits & 0x0FFFu);
+    uint32_t is_nan = -(uint32_t)(shl1_w > 0xFF000000u);
+    return (uint16_t)((sign >> 16) | (0x7E00u & is_nan) | (nonsign & ~is_nan));
+}
+
+template <typename T> inline float load(const T *src, size_t i) {
+    return src[i];
+}
+template <> inline float load(const uint16_t *src, size_t i) {
+    return halfToFloat(src[i]);
+}
+template <typename T> inline void store(T *dst, size_t i, float val) {
+    dst[i] = val;
+}
+template <> inline void store(uint16_t *dst, size_t i, float val) {
+    dst[i] = floatToHalf(val);
+}
+
+// Tile loops. A full tile has a constant trip count, which the compiler
+// vectorizes also at -O2; only a short last tile runs the generic loop.
+template <typename T>
+inline void loadTile(float *__restrict acc, const T *__restrict src,
+                     size_t len) {
+    if (len == REDUCE_TILE) {
+        for (size_t i = 0; i < REDUCE_TILE; i++) {
+            acc[i] = load(src, i);
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            acc[i] = load(src, i);
+        }
+    }
+}
+template <typename T>
+inline void addTile(float *__restrict acc, const T *__restrict src,
+                    size_t len) {
+    if (len == REDUCE_TILE) {
+        for (size_t i = 0; i < REDUCE_TILE; i++) {
+            acc[i] += load(src, i);
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            acc[i] += load(src, i);
+        }
+    }
+}
+template <typename T>
+inline void storeTile(T *__restrict dst, const float *__restrict acc,
+                      size_t len) {
+    if (len == REDUCE_TILE) {
+        for (size_t i = 0; i < REDUCE_TILE; i++) {
+            store(dst, i, acc[i]);
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            store(dst, i, acc[i]);
+        }
+    }
+}
+
+// dst[0, n) = sum of every sender over [offset, offset + n), in rank order so
+// all ranks see bitwise identical results. Sums a tile of all senders before
+// storing, which keeps it correct when dst aliases one of the senders.
+template <typename T>
+void reduceRange(T *dst, std::vector<const void *> const &srcs, size_t offset,
+                 size_t n) {
+    float acc[REDUCE_TILE];
+    for (size_t tile = 0; tile < n; tile += REDUCE_TILE) {
+        size_t len = std::min(REDUCE_TILE, n - tile);
+        loadTile(acc, static_cast<const T *>(srcs[0]) + offset + tile, len);
+        for (size_t r = 1; r < srcs.size(); r++) {
+            addTile(acc, static_cast<const T *>(srcs[r]) + offset + tile, len);
+        }
+        storeTile(dst + tile, acc, len);
+    }
+}
+
+// acc[0, dim) = residual + every sender over [offset, offset + dim).
+template <typename T>
+void sumRow(float *acc, std::vector<const void *> const &srcs,
+            const void *residual, size_t offset, size_t dim) {
+    for (size_t tile = 0; tile < dim; tile += REDUCE_TILE) {
+        size_t len = std::min(REDUCE_TILE, dim - tile);
+        if (residual != nullptr) {
+            loadTile(acc + tile,
+                     static_cast<const T *>(residual) + offset + tile, len);
+        } else {
+            std::fill(acc + tile, acc + tile + len, 0.f);
+        }
+        for (auto src : srcs) {
+            addTile(acc + tile, static_cast<const T *>(src) + offset + tile,
+                    len);
+        }
+    }
+}
+
+void reduceRange(InfiniDataType_t datatype, void *dst,
+                 std::vector<const void *> const &srcs, size_t offset,
+                 size_t n) {
+    if (datatype == INFINI_F32) {
+        reduceRange(static_cast<float *>(dst), srcs, offset, n);
+    } else {
+        reduceRange(static_cast<uint16_t *>(dst), srcs, offset, n);
+    }
+}
+
+template <typename T>
+void storeNormRow(T *sum, T *norm, const float *acc, const float *w,
+                  float scale, size_t dim) {
+    float normed[REDUCE_TILE];
+    for (size_t tile = 0; tile < dim; tile += REDUCE_TILE) {
+        size_t len = std::min(REDUCE_TILE, dim - tile);
+        for (size_t i = 0; i < len; i++) {
+            normed[i] = acc[tile + i] * scale * w[tile + i];
+        }
+        storeTile(sum + tile, acc + tile, len);
+        storeTile(norm + tile, normed, len);
+    }
+}
+
+infinicclStatus_t commInitAll(DeviceType device, infinicclComm_t *comms,
+                              unsigned int numDevices,
+                              unsigned int const *deviceIDs) {
+    if (numDevices == 0) {
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    }
+    auto group = std::make_shared<CpuCommGroup>(numDevices);
+    for (unsigned int i = 0; i < numDevices; i++) {
+        comms[i] = new InfiniComm{device, deviceIDs[i],
+                                  new CpuComm{group, i, nullptr}};
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t commInitRank(DeviceType device, infinicclComm_t *comm,
+                               infinicclUniqueId const *id,
+                               unsigned int nranks, unsigned int rank,
+                               unsigned int deviceID) {
+    std::unique_ptr<SocketMesh> mesh;
+    auto status = SocketMesh::create(id, nranks, rank, &mesh);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    *comm = new InfiniComm{device, deviceID,
+                           new CpuComm{nullptr, rank, std::move(mesh)}};
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Waits for work queued on `stream`; host collectives then run inline.
+inline infinicclStatus_t drainStream(infinirtStream_t stream) {
+    if (stream != nullptr &&
+        infinirtStreamSynchronize(stream) != INFINIRT_STATUS_SUCCESS) {
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+std::vector<float> loadWeight(void const *weight, InfiniDataType_t weightType,
+                              size_t dim) {
+    auto w = std::vector<float>(dim);
+    for (size_t i = 0; i < dim; i++) {
+        w[i] = weightType == INFINI_F32
+                   ? load(static_cast<const float *>(weight), i)
+                   : load(static_cast<const uint16_t *>(weight), i);
+    }
+    return w;
+}
+
+// Collectives over a socket mesh. At step s every rank sends to rank + s and
+// receives from rank - s, so each step is a permutation and no pair waits on
+// another. Sums are still taken in rank order on the owner of a chunk.
+
+infinicclStatus_t meshAllReduce(SocketMesh &mesh, const void *sendbuf,
+                                void *recvbuf, size_t count,
+                                InfiniDataType_t datatype) {
+    auto n = mesh.size(), rank = mesh.rank();
+    size_t elem_size = cclDataTypeSize(datatype);
+    size_t chunk = (count + n - 1) / n;
+    auto chunkBegin = [&](unsigned int r) { return std::min(count, r * chunk); };
+    auto chunkBytes = [&](unsigned int r) {
+        return (chunkBegin(r + 1) - chunkBegin(r)) * elem_size;
+    };
+    auto send = static_cast<const char *>(sendbuf);
+    auto recv = static_cast<char *>(recvbuf);
+    size_t own_bytes = chunkBytes(rank);
+    // The other ranks' contributions to this rank's chunk.
+    auto staging = std::vector<char>(n * own_bytes);
+    auto srcs = std::vector<const void *>(n);
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        srcs[src] = staging.data() + src * own_bytes;
+        if (!mesh.sendRecv(dst, send + chunkBegin(dst) * elem_size,
+                           chunkBytes(dst), src, staging.data() + src * own_bytes,
+                           own_bytes)) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    srcs[rank] = send + chunkBegin(rank) * elem_size;
+    reduceRange(datatype, recv + chunkBegin(rank) * elem_size, srcs, 0,
+                chunkBegin(rank + 1) - chunkBegin(rank));
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        if (!mesh.sendRecv(dst, recv + chunkBegin(rank) * elem_size, own_bytes,
+                           src, recv + chunkBegin(src) * elem_size,
+                           chunkBytes(src))) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t meshAllGather(SocketMesh &mesh, const void *sendbuf,
+                                void *recvbuf, size_t bytes) {
+    auto n = mesh.size(), rank = mesh.rank();
+    auto recv = static_cast<char *>(recvbuf);
+    if (recv + rank * bytes != sendbuf) {
+        std::memcpy(recv + rank * bytes, sendbuf, bytes);
+    }
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        if (!mesh.sendRecv(dst, sendbuf, bytes, src, recv + src * bytes,
+                           bytes)) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t meshReduceScatter(SocketMesh &mesh, const void *sendbuf,
+                                    void *recvbuf, size_t recvcount,
+                                    InfiniDataType_t datatype) {
+    auto n = mesh.size(), rank = mesh.rank();
+    size_t bytes = recvcount * cclDataTypeSize(datatype);
+    auto send = static_cast<const char *>(sendbuf);
+    auto staging = std::vector<char>(n * bytes);
+    auto srcs = std::vector<const void *>(n);
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        srcs[src] = staging.data() + src * bytes;
+        if (!mesh.sendRecv(dst, send + dst * bytes, bytes, src,
+                           staging.data() + src * bytes, bytes)) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    srcs[rank] = send + rank * bytes;
+    reduceRange(datatype, recvbuf, srcs, 0, recvcount);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t meshBroadcast(SocketMesh &mesh, const void *sendbuf,
+                                void *recvbuf, size_t bytes,
+                                unsigned int root) {
+    if (mesh.rank() != root) {
+        return mesh.recv(root, recvbuf, bytes)
+                   ? INFINICCL_STATUS_SUCCESS
+                   : INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    for (unsigned int r = 0; r < mesh.size(); r++) {
+        if (r != root && !mesh.send(r, sendbuf, bytes)) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    if (recvbuf != sendbuf) {
+        std::memcpy(recvbuf, sendbuf, bytes);
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Rows cannot be normalized where they are summed without a second exchange
+// for the norms, so every rank all-reduces the whole buffer and normalizes it
+// locally. Rank 0 folds the residual into its contribution.
+infinicclStatus_t meshAllReduceRMSNorm(SocketMesh &mesh, const void *sendbuf,
+                                       void *recvbuf, void const *residual,
+                                       void *normbuf, void const *weight,
+                                       size_t nrow, size_t dim, float epsilon,
+                                       InfiniDataType_t datatype,
+                                       InfiniDataType_t weightType) {
+    size_t count = nrow * dim;
+    std::vector<char> with_residual;
+    if (residual != nullptr && mesh.rank() == 0) {
+        with_residual.resize(count * cclDataTypeSize(datatype));
+        reduceRange(datatype, with_residual.data(), {sendbuf, residual}, 0,
+                    count);
+        sendbuf = with_residual.data();
+    }
+    auto status = meshAllReduce(mesh, sendbuf, recvbuf, count, datatype);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto acc = std::vector<float>(dim);
+    auto w = loadWeight(weight, weightType, dim);
+    auto sum = std::vector<const void *>{recvbuf};
+    for (size_t row = 0; row < nrow; row++) {
+        size_t offset = row * dim;
+        if (datatype == INFINI_F32) {
+            sumRow<float>(acc.data(), sum, nullptr, offset, dim);
+        } else {
+            sumRow<uint16_t>(acc.data(), sum, nullptr, offset, dim);
+        }
+        float ss = 0;
+        for (size_t i = 0; i < dim; i++) {
+            ss += acc[i] * acc[i];
+        }
+        float scale = 1.f / std::sqrt(ss / dim + epsilon);
+        if (datatype == INFINI_F32) {
+            storeNormRow(static_cast<float *>(recvbuf) + offset,
+                         static_cast<float *>(normbuf) + offset, acc.data(),
+                         w.data(), scale, dim);
+        } else {
+            storeNormRow(static_cast<uint16_t *>(recvbuf) + offset,
+                         static_cast<uint16_t *>(normbuf) + offset, acc.data(),
+                         w.data(), scale, dim);
+        }
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Wire format of n compressed elements: one float scale per block, then one
+// byte per element.
+inline size_t packedSize(size_t n) {
+    size_t nblock = (n + INFINICCL_COMPRESSION_BLOCK - 1) /
+                    INFINICCL_COMPRESSION_BLOCK;
+    return nblock * sizeof(float) + n;
+}
+
+inline float compressionRange(infinicclCompression_t compression) {
+    return compression == INFINICCL_COMPRESSION_INT8 ? 127.f : 448.f;
+}
+
+void pack(const float *src, size_t n, infinicclCompression_t compression,
+          uint8_t *out) {
+    auto scales = reinterpret_cast<float *>(out);
+    auto values = out + packedSize(n) - n;
+    float range = compressionRange(compression);
+    for (size_t block = 0; block * INFINICCL_COMPRESSION_BLOCK < n; block++) {
+        size_t begin = block * INFINICCL_COMPRESSION_BLOCK;
+        size_t end = std::min(n, begin + INFINICCL_COMPRESSION_BLOCK);
+        float absmax = 0;
+        for (size_t i = begin; i < end; i++) {
+            absmax = std::max(absmax, std::fabs(src[i]));
+        }
+        float scale = absmax / range;
+        float inv = scale > 0 ? 1.f / scale : 0.f;
+        scales[block] = scale;
+        for (size_t i = begin; i < end; i++) {
+            if (compression == INFINICCL_COMPRESSION_INT8) {
+                values[i] = uint8_t(int8_t(std::nearbyint(src[i] * inv)));
+            } else {
+                values[i] = f32_to_f8e4m3(src[i] * inv);
+            }
+        }
+    }
+}
+
+// acc[0, n) += decoded values.
+void unpackAdd(const uint8_t *in, size_t n,
+               infinicclCompression_t compression, float *acc) {
+    auto scales = reinterpret_cast<const float *>(in);
+    auto values = in + packedSize(n) - n;
+    for (size_t i = 0; i < n; i++) {
+        float scale = scales[i / INFINICCL_COMPRESSION_BLOCK];
+        float val = compression == INFINICCL_COMPRESSION_INT8
+                        ? float(int8_t(values[i]))
+                        : f8e4m3_to_f32(values[i]);
+        acc[i] += val * scale;
+    }
+}
+
+void toFloat(InfiniDataType_t datatype, const void *src, size_t n,
+             float *dst) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = datatype == INFINI_F32
+                     ? load(static_cast<const float *>(src), i)
+                     : load(static_cast<const uint16_t *>(src), i);
+    }
+}
+
+void fromFloat(InfiniDataType_t datatype, const float *src, size_t n,
+               void *dst) {
+    for (size_t i = 0; i < n; i++) {
+        if (datatype == INFINI_F32) {
+            store(static_cast<float *>(dst), i, src[i]);
+        } else {
+            store(static_cast<uint16_t *>(dst), i, src[i]);
+        }
+    }
+}
+
+// Chunks of a compressed all-reduce start on block boundaries so that no
+// scale is shared between owners.
+struct CompressedLayout {
+    size_t count, chunk;
+    unsigned int nranks;
+
+    CompressedLayout(size_t count, unsigned int nranks)
+        : count(count), nranks(nranks) {
+        chunk = (count + nranks - 1) / nranks;
+        chunk = (chunk + INFINICCL_COMPRESSION_BLOCK - 1) /
+                INFINICCL_COMPRESSION_BLOCK * INFINICCL_COMPRESSION_BLOCK;
+    }
+    size_t begin(unsigned int r) const { return std::min(count, r * chunk); }
+    size_t len(unsigned int r) const { return begin(r + 1) - begin(r); }
+    // Packets of every chunk laid out back to back, one slot per chunk.
+    size_t slot() const { return packedSize(chunk); }
+};
+
+// Compresses every chunk of sendbuf into its slot of `packets`.
+void packChunks(CompressedLayout const &layout, const void *sendbuf,
+                InfiniDataType_t datatype, infinicclCompression_t compression,
+                std::vector<uint8_t> &packets) {
+    auto input = std::vector<float>(layout.count);
+    toFloat(datatype, sendbuf, layout.count, input.data());
+    packets.resize(layout.nranks * layout.slot());
+    for (unsigned int r = 0; r < layout.nranks; r++) {
+        pack(input.data() + layout.begin(r), layout.len(r), compression,
+             packets.data() + r * layout.slot());
+    }
+}
+
+// Sums one chunk from the packets of all ranks, in rank order, and compresses
+// the result for the all-gather.
+void reducePackets(std::vector<const uint8_t *> const &packets, size_t n,
+                   infinicclCompression_t compression, uint8_t *out) {
+    auto acc = std::vector<float>(n, 0.f);
+    for (auto packet : packets) {
+        unpackAdd(packet, n, compression, acc.data());
+    }
+    pack(acc.data(), n, compression, out);
+}
+
+// Decodes the reduced packet of chunk r into recvbuf.
+void unpackChunk(CompressedLayout const &layout, unsigned int r,
+                 const uint8_t *packet, InfiniDataType_t datatype,
+                 infinicclCompression_t compression, void *recvbuf) {
+    auto out = std::vector<float>(layout.len(r), 0.f);
+    unpackAdd(packet, out.size(), compression, out.data());
+    fromFloat(datatype, out.data(), out.size(),
+              static_cast<char *>(recvbuf) +
+                  layout.begin(r) * cclDataTypeSize(datatype));
+}
+
+infinicclStatus_t meshAllReduceCompressed(SocketMesh &mesh,
+                                          const void *sendbuf, void *recvbuf,
+                                          size_t count,
+                                          InfiniDataType_t datatype,
+                                          infinicclCompression_t compression) {
+    auto n = mesh.size(), rank = mesh.rank();
+    auto layout = CompressedLayout(count, n);
+    size_t slot = layout.slot();
+    auto packets = std::vector<uint8_t>();
+    packChunks(layout, sendbuf, datatype, compression, packets);
+    // Packets of this rank's chunk from every rank, then of every reduced
+    // chunk.
+    auto staging = std::vector<uint8_t>(n * slot);
+    auto reduced = std::vector<uint8_t>(n * slot);
+    auto srcs = std::vector<const uint8_t *>(n);
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        srcs[src] = staging.data() + src * slot;
+        if (!mesh.sendRecv(dst, packets.data() + dst * slot,
+                           packedSize(layout.len(dst)), src,
+                           staging.data() + src * slot,
+                           packedSize(layout.len(rank)))) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    srcs[rank] = packets.data() + rank * slot;
+    reducePackets(srcs, layout.len(rank), compression,
+                  reduced.data() + rank * slot);
+    for (unsigned int step = 1; step < n; step++) {
+        unsigned int dst = (rank + step) % n, src = (rank + n - step) % n;
+        if (!mesh.sendRecv(dst, reduced.data() + rank * slot,
+                           packedSize(layout.len(rank)), src,
+                           reduced.data() + src * slot,
+                           packedSize(layout.len(src)))) {
+            return INFINICCL_STATUS_EXECUTION_FAILED;
+        }
+    }
+    for (unsigned int r = 0; r < n; r++) {
+        unpackChunk(layout, r, reduced.data() + r * slot, datatype,
+                    compression, recvbuf);
+    }
+    return INFINICCL_STATUS_SUCCESS;
+}
+} // namespace
+
+infinicclStatus_t infinicclCpuCommInitAll(infinicclComm_t *comms,
+                                          unsigned int numDevices,
+                                          unsigned int const *deviceIDs) {
+    return commInitAll(DEVICE_CPU, comms, numDevices, deviceIDs);
+}
+
+infinicclStatus_t infinicclSimCommInitAll(infinicclComm_t *comms,
+                                          unsigned int numDevices,
+                                          unsigned int const *deviceIDs) {
+    return commInitAll(DEVICE_SIM, comms, numDevices, deviceIDs);
+}
+
+infinicclStatus_t infinicclCpuCommInitRank(infinicclComm_t *comm,
+                                           infinicclUniqueId const *id,
+                                           unsigned int nranks,
+                                           unsigned int rank,
+                                           unsigned int deviceID) {
+    return commInitRank(DEVICE_CPU, comm, id, nranks, rank, deviceID);
+}
+
+infinicclStatus_t infinicclSimCommInitRank(infinicclComm_t *comm,
+                                           infinicclUniqueId const *id,
+                                           unsigned int nranks,
+                                           unsigned int rank,
+                                           unsigned int deviceID) {
+    return commInitRank(DEVICE_SIM, comm, id, nranks, rank, deviceID);
+}
+
+// The group is released with its last communicator, the mesh with its own.
+infinicclStatus_t infinicclCpuCommDestroy(infinicclComm_t comm) {
+    delete getCpuComm(comm);
+    delete comm;
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Reduce-scatter then all-gather through the published buffers: rank r sums
+// chunk r of every sender into its own recvbuf, then copies the other chunks
+// out of their owners' recvbufs. Every rank of the group must call it.
+infinicclStatus_t infinicclCpuAllReduceSum(infinicclComm_t comm, void *sendbuf,
+                                           void *recvbuf, size_t count,
+                                           InfiniDataType_t datatype,
+                                           infinirtStream_t stream) {
+    size_t elem_size;
+    switch (datatype) {
+    case INFINI_F32:
+        elem_size = sizeof(float);
+        break;
+    case INFINI_F16:
+        elem_size = sizeof(uint16_t);
+        break;
+    default:
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (cpu_comm->mesh) {
+        return meshAllReduce(*cpu_comm->mesh, sendbuf, recvbuf, count,
+                             datatype);
+    }
+    auto &group = *cpu_comm->group;
+    auto rank = cpu_comm->rank;
+    if (group.size == 1) {
+        if (recvbuf != sendbuf) {
+            std::memcpy(recvbuf, sendbuf, count * elem_size);
+        }
+        return INFINICCL_STATUS_SUCCESS;
+    }
+
+    group.send[rank] = sendbuf;
+    group.recv[rank] = recvbuf;
+    group.barrier();
+
+    size_t chunk = (count + group.size - 1) / group.size;
+    chunk = (chunk + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+    auto chunkBegin = [&](unsigned int r) { return std::min(count, r * chunk); };
+    size_t begin = chunkBegin(rank), end = chunkBegin(rank + 1);
+    reduceRange(datatype, static_cast<char *>(recvbuf) + begin * elem_size,
+                group.send, begin, end - begin);
+    group.barrier();
+
+    auto dst = static_cast<char *>(recvbuf);
+    for (unsigned int r = 0; r < group.size; r++) {
+        if (r == rank) {
+            continue;
+        }
+        size_t b = chunkBegin(r), e = chunkBegin(r + 1);
+        std::memcpy(dst + b * elem_size,
+                    static_cast<const char *>(group.recv[r]) + b * elem_size,
+                    (e - b) * elem_size);
+    }
+    // Owners may not reuse their buffers until every rank has read them.
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Each rank copies every rank's block straight out of its sendbuf.
+infinicclStatus_t infinicclCpuAllGather(infinicclComm_t comm, void *sendbuf,
+                                        void *recvbuf, size_t sendcount,
+                                        InfiniDataType_t datatype,
+                                        infinirtStream_t stream) {
+    size_t bytes = sendcount * cclDataTypeSize(datatype);
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (cpu_comm->mesh) {
+        return meshAllGather(*cpu_comm->mesh, sendbuf, recvbuf, bytes);
+    }
+    auto &group = *cpu_comm->group;
+    group.send[cpu_comm->rank] = sendbuf;
+    group.barrier();
+    auto dst = static_cast<char *>(recvbuf);
+    for (unsigned int r = 0; r < group.size; r++) {
+        // Skips the in-place case where the block is already there.
+        if (dst + r * bytes != group.send[r]) {
+            std::memcpy(dst + r * bytes, group.send[r], bytes);
+        }
+    }
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCpuReduceScatterSum(infinicclComm_t comm,
+                                               void *sendbuf, void *recvbuf,
+                                               size_t recvcount,
+                                               InfiniDataType_t datatype,
+                                               infinirtStream_t stream) {
+    if (datatype != INFINI_F32 && datatype != INFINI_F16) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (cpu_comm->mesh) {
+        return meshReduceScatter(*cpu_comm->mesh, sendbuf, recvbuf, recvcount,
+                                 datatype);
+    }
+    auto &group = *cpu_comm->group;
+    auto rank = cpu_comm->rank;
+    group.send[rank] = sendbuf;
+    group.barrier();
+    reduceRange(datatype, recvbuf, group.send, rank * recvcount, recvcount);
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCpuBroadcast(infinicclComm_t comm, void *sendbuf,
+                                        void *recvbuf, size_t count,
+                                        InfiniDataType_t datatype,
+                                        unsigned int root,
+                                        infinirtStream_t stream) {
+    size_t bytes = count * cclDataTypeSize(datatype);
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (root >= cpu_comm->size()) {
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    if (cpu_comm->mesh) {
+        return meshBroadcast(*cpu_comm->mesh, sendbuf, recvbuf, bytes, root);
+    }
+    auto &group = *cpu_comm->group;
+    if (cpu_comm->rank == root) {
+        group.send[root] = sendbuf;
+    }
+    group.barrier();
+    if (recvbuf != group.send[root]) {
+        std::memcpy(recvbuf, group.send[root], bytes);
+    }
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Blocks until `peer` has received the buffer.
+infinicclStatus_t infinicclCpuSend(infinicclComm_t comm, void *sendbuf,
+                                   size_t count, InfiniDataType_t datatype,
+                                   unsigned int peer, infinirtStream_t stream) {
+    size_t bytes = count * cclDataTypeSize(datatype);
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (peer >= cpu_comm->size() || peer == cpu_comm->rank) {
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    if (cpu_comm->mesh) {
+        return cpu_comm->mesh->send(peer, sendbuf, bytes)
+                   ? INFINICCL_STATUS_SUCCESS
+                   : INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    auto &group = *cpu_comm->group;
+    size_t slot = cpu_comm->rank * group.size + peer;
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.cv.wait(lock, [&] { return group.mailbox[slot] == nullptr; });
+    group.mailbox[slot] = sendbuf;
+    group.mailbox_bytes[slot] = bytes;
+    group.cv.notify_all();
+    group.cv.wait(lock, [&] { return group.mailbox[slot] != sendbuf; });
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCpuRecv(infinicclComm_t comm, void *recvbuf,
+                                   size_t count, InfiniDataType_t datatype,
+                                   unsigned int peer, infinirtStream_t stream) {
+    size_t bytes = count * cclDataTypeSize(datatype);
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (peer >= cpu_comm->size() || peer == cpu_comm->rank) {
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    // The stream carries no sizes, so a mismatched count on the mesh goes
+    // undetected; the shared-memory path checks it.
+    if (cpu_comm->mesh) {
+        return cpu_comm->mesh->recv(peer, recvbuf, bytes)
+                   ? INFINICCL_STATUS_SUCCESS
+                   : INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    auto &group = *cpu_comm->group;
+    size_t slot = peer * group.size + cpu_comm->rank;
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.cv.wait(lock, [&] { return group.mailbox[slot] != nullptr; });
+    auto src = group.mailbox[slot];
+    auto sent = group.mailbox_bytes[slot];
+    // The sender stays parked until the slot is cleared, so the copy can run
+    // without the lock.
+    lock.unlock();
+    std::memcpy(recvbuf, src, std::min(bytes, sent));
+    lock.lock();
+    group.mailbox[slot] = nullptr;
+    group.cv.notify_all();
+    return sent == bytes ? INFINICCL_STATUS_SUCCESS
+                   : INFINICCL_STATUS_INVALID_ARGUMENT;
+}
+
+// Rows are split across ranks instead of elements so that each owner can
+// normalize its rows while the sums are still in cache; owners then publish
+// both outputs for the others to copy.
+infinicclStatus_t infinicclCpuAllReduceSumRMSNorm(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, void const *residual,
+    void *normbuf, void const *weight, size_t nrow, size_t dim, float epsilon,
+    InfiniDataType_t datatype, InfiniDataType_t weightType,
+    infinirtStream_t stream) {
+    if ((datatype != INFINI_F32 && datatype != INFINI_F16) ||
+        (weightType != INFINI_F32 && weightType != INFINI_F16)) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (cpu_comm->mesh) {
+        return meshAllReduceRMSNorm(*cpu_comm->mesh, sendbuf, recvbuf,
+                                    residual, normbuf, weight, nrow, dim,
+                                    epsilon, datatype, weightType);
+    }
+    auto &group = *cpu_comm->group;
+    auto rank = cpu_comm->rank;
+    group.send[rank] = sendbuf;
+    group.recv[rank] = recvbuf;
+    group.norm[rank] = normbuf;
+    group.barrier();
+
+    size_t rows = (nrow + group.size - 1) / group.size;
+    auto rowBegin = [&](unsigned int r) { return std::min(nrow, r * rows); };
+    auto acc = std::vector<float>(dim);
+    auto w = loadWeight(weight, weightType, dim);
+    for (size_t row = rowBegin(rank); row < rowBegin(rank + 1); row++) {
+        size_t offset = row * dim;
+        if (datatype == INFINI_F32) {
+            sumRow<float>(acc.data(), group.send, residual, offset, dim);
+        } else {
+            sumRow<uint16_t>(acc.data(), group.send, residual, offset, dim);
+        }
+        float ss = 0;
+        for (size_t i = 0; i < dim; i++) {
+            ss += acc[i] * acc[i];
+        }
+        float scale = 1.f / std::sqrt(ss / dim + epsilon);
+        if (datatype == INFINI_F32) {
+            storeNormRow(static_cast<float *>(recvbuf) + offset,
+                         static_cast<float *>(normbuf) + offset, acc.data(),
+                         w.data(), scale, dim);
+        } else {
+            storeNormRow(static_cast<uint16_t *>(recvbuf) + offset,
+                         static_cast<uint16_t *>(normbuf) + offset, acc.data(),
+                         w.data(), scale, dim);
+        }
+    }
+    group.barrier();
+
+    size_t row_bytes = dim * cclDataTypeSize(datatype);
+    for (unsigned int r = 0; r < group.size; r++) {
+        if (r == rank) {
+            continue;
+        }
+        size_t b = rowBegin(r), n = rowBegin(r + 1) - b;
+        std::memcpy(static_cast<char *>(recvbuf) + b * row_bytes,
+                    static_cast<const char *>(group.recv[r]) + b * row_bytes,
+                    n * row_bytes);
+        std::memcpy(static_cast<char *>(normbuf) + b * row_bytes,
+                    static_cast<const char *>(group.norm[r]) + b * row_bytes,
+                    n * row_bytes);
+    }
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+// Same exchange as the exact all-reduce, but ranks publish compressed packets
+// instead of their buffers. Only the mesh saves bandwidth; in shared memory
+// it reproduces the numerics of a compressed link.
+infinicclStatus_t infinicclCpuAllReduceSumCompressed(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
+    InfiniDataType_t datatype, infinicclCompression_t compression,
+    infinirtStream_t stream) {
+    if (datatype != INFINI_F32 && datatype != INFINI_F16) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    auto status = drainStream(stream);
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    auto cpu_comm = getCpuComm(comm);
+    if (cpu_comm->size() == 1) {
+        if (recvbuf != sendbuf) {
+            std::memcpy(recvbuf, sendbuf, count * cclDataTypeSize(datatype));
+        }
+        return INFINICCL_STATUS_SUCCESS;
+    }
+    if (cpu_comm->mesh) {
+        return meshAllReduceCompressed(*cpu_comm->mesh, sendbuf, recvbuf,
+                                       count, datatype, compression);
+    }
+    auto &group = *cpu_comm->group;
+    auto rank = cpu_comm->rank;
+    auto layout = CompressedLayout(count, group.size);
+    size_t slot = layout.slot();
+    auto packets = std::vector<uint8_t>();
+    packChunks(layout, sendbuf, datatype, compression, packets);
+    auto reduced = std::vector<uint8_t>(slot);
+    group.send[rank] = packets.data();
+    group.recv[rank] = reduced.data();
+    group.barrier();
+
+    auto srcs = std::vector<const uint8_t *>(group.size);
+    for (unsigned int r = 0; r < group.size; r++) {
+        srcs[r] = static_cast<const uint8_t *>(group.send[r]) + rank * slot;
+    }
+    reducePackets(srcs, layout.len(rank), compression, reduced.data());
+    group.barrier();
+
+    for (unsigned int r = 0; r < group.size; r++) {
+        unpackChunk(layout, r, static_cast<const uint8_t *>(group.recv[r]),
+                    datatype, compression, recvbuf);
+    }
+    // Owners may not free their packets until every rank has read them.
+    group.barrier();
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+const infinicclBackend *getCpuCclBackend() {
+    static const infinicclBackend backend = [] {
+        infinicclBackend table{};
+        table.abiVersion = INFINICCL_BACKEND_ABI_VERSION;
+        table.commInitAll = infinicclCpuCommInitAll;
+        table.commInitRank = infinicclCpuCommInitRank;
+        table.commDestroy = infinicclCpuCommDestroy;
+        table.allReduceSum = infinicclCpuAllReduceSum;
+        table.allGather = infinicclCpuAllGather;
+        table.reduceScatterSum = infinicclCpuReduceScatterSum;
+        table.broadcast = infinicclCpuBroadcast;
+        table.send = infinicclCpuSend;
+        table.recv = infinicclCpuRecv;
+        table.allReduceSumRMSNorm = infinicclCpuAllReduceSumRMSNorm;
+        table.allReduceSumCompressed = infinicclCpuAllReduceSumCompressed;
+        return table;
+    }();
+    return &backend;
+}
+
+const infinicclBackend *getSimCclBackend() {
+    static const infinicclBackend backend = [] {
+        infinicclBackend table = *getCpuCclBackend();
+        table.commInitAll = infinicclSimCommInitAll;
+        table.commInitRank = infinicclSimCommInitRank;
+        return table;
+    }();
+    return &backend;
+}
@@ -0,0 +1,50 @@
+#ifndef INFINICCL_CPU_H_
+#define INFINICCL_CPU_H_
+#include "infiniccl.h"
+
+// The CPU backend is always built. Ranks are threads of one process sharing
+// the host address space; collectives run on the calling thread once the
+// stream has drained, like every other host operator. It also serves the
+// simulated accelerator, whose memory is host memory. Communicators from
+// infinicclCommInitRank may span processes and move data over TCP instead.
+
+infinicclStatus_t infinicclCpuCommInitAll(infinicclComm_t *comms, unsigned int numDevices, unsigned int const *deviceIDs);
+infinicclStatus_t infinicclSimCommInitAll(infinicclComm_t *comms, unsigned int numDevices, unsigned int const *deviceIDs);
+infinicclStatus_t infinicclCpuCommInitRank(infinicclComm_t *comm, infinicclUniqueId const *id, unsigned int nranks, unsigned int rank, unsigned int deviceID);
+infinicclStatus_t infinicclSimCommInitRank(infinicclComm_t *comm, infinicclUniqueId const *id, unsigned int nranks, unsigned int rank, unsigned int deviceID);
+infinicclStatus_t infinicclCpuCommDestroy(infinicclComm_t comm);
+infinicclStatus_t infinicclCpuAllReduceSum(infinicclComm_t comm, void *sendbuf,
+                                           void *recvbuf, size_t count,
+                                           InfiniDataType_t datatype,
+                                           infinirtStream_t stream);
+infinicclStatus_t infinicclCpuAllGather(infinicclComm_t comm, void *sendbuf,
+                                        void *recvbuf, size_t sendcount,
+                                        InfiniDataType_t datatype,
+                                        infinirtStream_t stream);
+infinicclStatus_t infinicclCpuReduceScatterSum(infinicclComm_t comm,
+                                               void *sendbuf, void *recvbuf,
+                                               size_t recvcount,
+                                               InfiniDataType_t datatype,
+                                               infinirtStream_t stream);
+infinicclStatus_t infinicclCpuBroadcast(infinicclComm_t comm, void *sendbuf,
+                                        void *recvbuf, size_t count,
+                                        InfiniDataType_t datatype,
+                                        unsigned int root,
+                                        infinirtStream_t stream);
+infinicclStatus_t infinicclCpuSend(infinicclComm_t comm, void *sendbuf,
+                                   size_t count, InfiniDataType_t datatype,
+                                   unsigned int peer, infinirtStream_t stream);
+infinicclStatus_t infinicclCpuRecv(infinicclComm_t comm, void *recvbuf,
+                                   size_t count, InfiniDataType_t datatype,
+                                   unsigned int peer, infinirtStream_t stream);
+infinicclStatus_t infinicclCpuAllReduceSumRMSNorm(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, void const *residual,
+    void *normbuf, void const *weight, size_t nrow, size_t dim, float epsilon,
+    InfiniDataType_t datatype, InfiniDataType_t weightType,
+    infinirtStream_t stream);
+infinicclStatus_t infinicclCpuAllReduceSumCompressed(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
+    InfiniDataType_t datatype, infinicclCompression_t compression,
+    infinirtStream_t stream);
+
+#endif /* INFINICCL_CPU_H_ */
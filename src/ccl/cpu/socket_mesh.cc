@@ -0,0 +1,143 @@
+#include "socket_mesh.h"
+#include "../bootstrap.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+struct PeerAddress {
+    in_addr_t addr; // network order
+    in_port_t port; // network order
+};
+
+inline bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+} // namespace
+
+// Each rank listens first, then publishes the address it reaches the root
+// from. Lower ranks accept, higher ranks connect, so every pair ends up with
+// exactly one connection.
+infinicclStatus_t SocketMesh::create(infinicclUniqueId const *id,
+                                     unsigned int nranks, unsigned int rank,
+                                     std::unique_ptr<SocketMesh> *mesh) {
+    if (nranks == 0 || rank >= nranks) {
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    }
+    in_port_t port;
+    int listen_fd = socketListen(nranks, &port);
+    if (listen_fd < 0) {
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    int root_fd = bootstrapConnect(id);
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    if (root_fd < 0 || getsockname(root_fd, (sockaddr *)&local, &len) != 0) {
+        if (root_fd >= 0) {
+            close(root_fd);
+        }
+        close(listen_fd);
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    PeerAddress self{local.sin_addr.s_addr, port};
+    auto peers = std::vector<PeerAddress>(nranks);
+    auto status = bootstrapExchange(id, root_fd, nranks, rank, &self,
+                                    sizeof(self), peers.data());
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        close(listen_fd);
+        return status;
+    }
+
+    std::unique_ptr<SocketMesh> result(new SocketMesh(rank, nranks));
+    bool ok = true;
+    for (unsigned int peer = 0; ok && peer < rank; peer++) {
+        int fd = socketConnect(peers[peer].addr, peers[peer].port);
+        uint32_t self_rank = rank;
+        ok = fd >= 0 && socketSendAll(fd, &self_rank, sizeof(self_rank));
+        result->fds[peer] = fd;
+    }
+    for (unsigned int accepted = rank + 1; ok && accepted < nranks;
+         accepted++) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        uint32_t peer;
+        ok = fd >= 0 && socketRecvAll(fd, &peer, sizeof(peer)) &&
+             peer > rank && peer < nranks && result->fds[peer] < 0;
+        if (!ok) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        result->fds[peer] = fd;
+    }
+    close(listen_fd);
+    if (!ok) {
+        return INFINICCL_STATUS_EXECUTION_FAILED;
+    }
+    *mesh = std::move(result);
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+SocketMesh::~SocketMesh() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool SocketMesh::send(unsigned int peer, void const *data, size_t size) {
+    return socketSendAll(fds[peer], data, size);
+}
+
+bool SocketMesh::recv(unsigned int peer, void *data, size_t size) {
+    return socketRecvAll(fds[peer], data, size);
+}
+
+bool SocketMesh::sendRecv(unsigned int dst, void const *sendData,
+                          size_t sendSize, unsigned int src, void *recvData,
+                          size_t recvSize) {
+    auto out = static_cast<char const *>(sendData);
+    auto in = static_cast<char *>(recvData);
+    size_t sent = 0, received = 0;
+    while (sent < sendSize || received < recvSize) {
+        pollfd pfds[2];
+        int npfd = 0, send_idx = -1, recv_idx = -1;
+        if (sent < sendSize) {
+            send_idx = npfd;
+            pfds[npfd++] = {fds[dst], POLLOUT, 0};
+        }
+        if (received < recvSize) {
+            recv_idx = npfd;
+            pfds[npfd++] = {fds[src], POLLIN, 0};
+        }
+        if (poll(pfds, npfd, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (send_idx >= 0 && pfds[send_idx].revents != 0) {
+            auto n = ::send(fds[dst], out + sent, sendSize - sent,
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0 && !wouldBlock()) {
+                return false;
+            }
+            sent += n > 0 ? n : 0;
+        }
+        if (recv_idx >= 0 && pfds[recv_idx].revents != 0) {
+            auto n = ::recv(fds[src], in + received, recvSize - received,
+                            MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && !wouldBlock())) {
+                return false;
+            }
+            received += n > 0 ? n : 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef INFINICCL_SOCKET_MESH_H_
+#define INFINICCL_SOCKET_MESH_H_
+#include "infiniccl.h"
+#include <memory>
+#include <vector>
+
+// Full mesh of TCP connections between the ranks of one communicator. CPU
+// communicators created with infinicclCommInitRank move their data over it,
+// since their ranks may live in different processes or on different nodes.
+class SocketMesh {
+public:
+    // Every rank of `id` must call it; ranks find each other through the
+    // bootstrap root.
+    static infinicclStatus_t create(infinicclUniqueId const *id,
+                                    unsigned int nranks, unsigned int rank,
+                                    std::unique_ptr<SocketMesh> *mesh);
+    ~SocketMesh();
+
+    unsigned int rank() const { return _rank; }
+    unsigned int size() const { return (unsigned int)fds.size(); }
+
+    // Blocking; false when the peer is gone.
+    bool send(unsigned int peer, void const *data, size_t size);
+    bool recv(unsigned int peer, void *data, size_t size);
+    // Sends to `dst` while receiving from `src`, so a ring of exchanges never
+    // stalls on full socket buffers.
+    bool sendRecv(unsigned int dst, void const *sendData, size_t sendSize,
+                  unsigned int src, void *recvData, size_t recvSize);
+
+private:
+    SocketMesh(unsigned int rank, unsigned int nranks)
+        : _rank(rank), fds(nranks, -1) {}
+
+    unsigned int _rank;
+    std::vector<int> fds; // -1 at this rank
+};
+
+#endif /* INFINICCL_SOCKET_MESH_H_ */
@@ -1,4 +1,6 @@
 #include "infiniccl_cuda.h"
+#include "../backend.h"
+#include "../bootstrap.h"
 #include "../../runtime/runtime.h"
 #include <cuda_runtime.h>
 #include <iostream>
@@ -58,6 +60,30 @@ infinicclStatus_t infinicclCudaCommInitAll(infinicclComm_t *comms,
     return INFINICCL_STATUS_SUCCESS;
 }
 
+// Rank 0's NCCL id travels through the infiniccl bootstrap, so callers only
+// pass one kind of id around.
+infinicclStatus_t infinicclCudaCommInitRank(infinicclComm_t *comm,
+                                            infinicclUniqueId const *id,
+                                            unsigned int nranks,
+                                            unsigned int rank,
+                                            unsigned int deviceID) {
+    ncclUniqueId ncclId{};
+    if (rank == 0) {
+        NCCL_CALL(ncclGetUniqueId(&ncclId));
+    }
+    std::vector<ncclUniqueId> ncclIds(nranks);
+    auto status = bootstrapAllGather(id, nranks, rank, &ncclId,
+                                     sizeof(ncclId), ncclIds.data());
+    if (status != INFINICCL_STATUS_SUCCESS) {
+        return status;
+    }
+    SWITCH_DEVICE(deviceID);
+    ncclComm_t ncclComm;
+    NCCL_CALL(ncclCommInitRank(&ncclComm, nranks, ncclIds[0], rank));
+    *comm = new InfiniComm{DEVICE_NVIDIA, deviceID, (void *)ncclComm};
+    return INFINICCL_STATUS_SUCCESS;
+}
+
 infinicclStatus_t infinicclCudaCommDestroy(infinicclComm_t comm) {
     NCCL_CALL(ncclCommDestroy(getNcclComm(comm)));
     delete comm;
@@ -76,3 +102,102 @@ infinicclStatus_t infinicclCudaAllReduceSum(infinicclComm_t comm, void *sendbuf,
                             ncclSum, getNcclComm(comm), getCudaStream(stream)));
     return INFINICCL_STATUS_SUCCESS;
 }
+
+// Collectives that only move data go through NCCL as bytes, so they accept
+// every datatype.
+#define BYTE_COUNT(count, datatype)                                            \
+    ((count) * cclDataTypeSize(datatype))
+
+infinicclStatus_t infinicclCudaAllGather(infinicclComm_t comm, void *sendbuf,
+                                         void *recvbuf, size_t sendcount,
+                                         InfiniDataType_t datatype,
+                                         infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    SWITCH_DEVICE(comm->deviceID);
+    NCCL_CALL(ncclAllGather(sendbuf, recvbuf, BYTE_COUNT(sendcount, datatype),
+                            ncclUint8, getNcclComm(comm),
+                            getCudaStream(stream)));
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCudaReduceScatterSum(infinicclComm_t comm,
+                                                void *sendbuf, void *recvbuf,
+                                                size_t recvcount,
+                                                InfiniDataType_t datatype,
+                                                infinirtStream_t stream) {
+    if (datatype != INFINI_F32 && datatype != INFINI_F16) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    SWITCH_DEVICE(comm->deviceID);
+    NCCL_CALL(ncclReduceScatter(sendbuf, recvbuf, recvcount,
+                                getCudaDtype(datatype), ncclSum,
+                                getNcclComm(comm), getCudaStream(stream)));
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCudaBroadcast(infinicclComm_t comm, void *sendbuf,
+                                         void *recvbuf, size_t count,
+                                         InfiniDataType_t datatype,
+                                         unsigned int root,
+                                         infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    SWITCH_DEVICE(comm->deviceID);
+    NCCL_CALL(ncclBroadcast(sendbuf, recvbuf, BYTE_COUNT(count, datatype),
+                            ncclUint8, (int)root, getNcclComm(comm),
+                            getCudaStream(stream)));
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCudaSend(infinicclComm_t comm, void *sendbuf,
+                                    size_t count, InfiniDataType_t datatype,
+                                    unsigned int peer,
+                                    infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    SWITCH_DEVICE(comm->deviceID);
+    NCCL_CALL(ncclSend(sendbuf, BYTE_COUNT(count, datatype), ncclUint8,
+                       (int)peer, getNcclComm(comm), getCudaStream(stream)));
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+infinicclStatus_t infinicclCudaRecv(infinicclComm_t comm, void *recvbuf,
+                                    size_t count, InfiniDataType_t datatype,
+                                    unsigned int peer,
+                                    infinirtStream_t stream) {
+    if (cclDataTypeSize(datatype) == 0) {
+        return INFINICCL_STATUS_BAD_DATATYPE;
+    }
+    SWITCH_DEVICE(comm->deviceID);
+    NCCL_CALL(ncclRecv(recvbuf, BYTE_COUNT(count, datatype), ncclUint8,
+                       (int)peer, getNcclComm(comm), getCudaStream(stream)));
+    return INFINICCL_STATUS_SUCCESS;
+}
+
+const infinicclBackend *getCudaCclBackend() {
+    static const infinicclBackend backend = [] {
+        infinicclBackend table{};
+        table.abiVersion = INFINICCL_BACKEND_ABI_VERSION;
+        table.commInitAll = infinicclCudaCommInitAll;
+        table.commInitRank = infinicclCudaCommInitRank;
+        table.commDestroy = infinicclCudaCommDestroy;
+        table.allReduceSum = infinicclCudaAllReduceSum;
+        table.allGather = infinicclCudaAllGather;
+        table.reduceScatterSum = infinicclCudaReduceScatterSum;
+        table.broadcast = infinicclCudaBroadcast;
+        table.send = infinicclCudaSend;
+        table.recv = infinicclCudaRecv;
+        return table;
+    }();
+    return &backend;
+}
+
+#ifdef INFINIRT_BACKEND_PLUGIN
+__C __export const infinicclBackend *infinicclGetBackend() {
+    return getCudaCclBackend();
+}
+#endif
@@ -11,9 +11,33 @@
 infinicclStatus_t
 infinicclCudaCommInitAll(infinicclComm_t *comms, unsigned int numDevices, unsigned int const *deviceIDs) IMPL_WITH_CUDA infinicclStatus_t
 infinicclCudaCommDestroy(infinicclComm_t comm) IMPL_WITH_CUDA 
+infinicclStatus_t infinicclCudaCommInitRank(infinicclComm_t *comm,
+                              infinicclUniqueId const *id,
+                              unsigned int nranks, unsigned int rank,
+                              unsigned int deviceID) IMPL_WITH_CUDA
 infinicclStatus_t infinicclCudaAllReduceSum(infinicclComm_t comm, void *sendbuf,
                               void *recvbuf, size_t count,
                               InfiniDataType_t datatype,
                               infinirtStream_t stream) IMPL_WITH_CUDA
+infinicclStatus_t infinicclCudaAllGather(infinicclComm_t comm, void *sendbuf,
+                              void *recvbuf, size_t sendcount,
+                              InfiniDataType_t datatype,
+                              infinirtStream_t stream) IMPL_WITH_CUDA
+infinicclStatus_t infinicclCudaReduceScatterSum(infinicclComm_t comm, void *sendbuf,
+                              void *recvbuf, size_t recvcount,
+                              InfiniDataType_t datatype,
+                              infinirtStream_t stream) IMPL_WITH_CUDA
+infinicclStatus_t infinicclCudaBroadcast(infinicclComm_t comm, void *sendbuf,
+                              void *recvbuf, size_t count,
+                              InfiniDataType_t datatype, unsigned int root,
+                              infinirtStream_t stream) IMPL_WITH_CUDA
+infinicclStatus_t infinicclCudaSend(infinicclComm_t comm, void *sendbuf,
+                              size_t count, InfiniDataType_t datatype,
+                              unsigned int peer,
+                              infinirtStream_t stream) IMPL_WITH_CUDA
+infinicclStatus_t infinicclCudaRecv(infinicclComm_t comm, void *recvbuf,
+                              size_t count, InfiniDataType_t datatype,
+                              unsigned int peer,
+                              infinirtStream_t stream) IMPL_WITH_CUDA
 
 #endif /* INFINICCL_CUDA_H_ */
@@ -1,53 +1,203 @@
 #include "infiniccl.h"
 #include "../runtime/runtime.h"
-#include "./ascend/infiniccl_ascend.h"
-#include "./cuda/infiniccl_cuda.h"
+#include "backend.h"
+#include "bootstrap.h"
+#include <atomic>
+#include <dlfcn.h>
+#include <mutex>
+
+namespace {
+constexpr size_t MAX_DEVICE_TYPES = 16;
+
+// Mirrors the infinirt registry: built-in backends up front, plugins looked
+// up on first communicator creation for their device.
+struct CclBackendRegistry {
+    std::atomic<const infinicclBackend *> tables[MAX_DEVICE_TYPES];
+    std::mutex mutex;
+
+    CclBackendRegistry() {
+        for (auto &table : tables) {
+            table.store(nullptr, std::memory_order_relaxed);
+        }
+        tables[DEVICE_CPU].store(getCpuCclBackend(), std::memory_order_relaxed);
+        tables[DEVICE_SIM].store(getSimCclBackend(), std::memory_order_relaxed);
+#ifdef ENABLE_NV_GPU
+        tables[DEVICE_NVIDIA].store(getCudaCclBackend(),
+                                    std::memory_order_relaxed);
+#endif
+#ifdef ENABLE_ASCEND_NPU
+        tables[DEVICE_ASCEND].store(getAscendCclBackend(),
+                                    std::memory_order_relaxed);
+#endif
+    }
+};
+
+CclBackendRegistry &registry() {
+    static CclBackendRegistry instance;
+    return instance;
+}
+
+const infinicclBackend *getCclBackend(DeviceType device) {
+    if ((size_t)device >= MAX_DEVICE_TYPES)
+        return nullptr;
+    return registry().tables[device].load(std::memory_order_acquire);
+}
+
+const infinicclBackend *loadCclBackend(DeviceType device) {
+    if ((size_t)device >= MAX_DEVICE_TYPES)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if (auto table = getCclBackend(device))
+        return table;
+    void *library = openBackendLibrary(device);
+    if (library == nullptr)
+        return nullptr;
+    auto entry = reinterpret_cast<infinicclGetBackendFn>(
+        dlsym(library, INFINICCL_BACKEND_ENTRY));
+    if (entry == nullptr)
+        return nullptr;
+    auto table = entry();
+    if (table == nullptr || table->abiVersion != INFINICCL_BACKEND_ABI_VERSION)
+        return nullptr;
+    registry().tables[device].store(table, std::memory_order_release);
+    return table;
+}
+} // namespace
+
+#define DISPATCH(DEVICE, FN, ...)                                              \
+    do {                                                                       \
+        auto backend = getCclBackend(DEVICE);                                  \
+        if (backend == nullptr || backend->FN == nullptr)                      \
+            return INFINICCL_STATUS_DEVICE_NOT_SUPPORTED;                      \
+        return backend->FN(__VA_ARGS__);                                       \
+    } while (0)
+
+#define CHECK_COMM(COMM, STREAM)                                               \
+    do {                                                                       \
+        if ((COMM) == nullptr)                                                 \
+            return INFINICCL_STATUS_COMMUNICATOR_UNINITIALIZED;                \
+        if ((STREAM) != nullptr && (COMM)->deviceType != (STREAM)->device)     \
+            return INFINICCL_STATUS_DEVICE_MISMATCH;                           \
+    } while (0)
 
 __C infinicclStatus_t infinicclCommInitAll(DeviceType deviceType,
                                            infinicclComm_t *comms,
                                            unsigned numDevices, unsigned const *deviceIDs) {
-    switch (deviceType) {
-    case DEVICE_NVIDIA:
-        return infinicclCudaCommInitAll(comms, numDevices, deviceIDs);
-    case DEVICE_ASCEND:
-        return infinicclAscendCommInitAll(comms, numDevices, deviceIDs);
-    default:
+    auto backend = getCclBackend(deviceType);
+    if (backend == nullptr)
+        backend = loadCclBackend(deviceType);
+    if (backend == nullptr || backend->commInitAll == nullptr)
         return INFINICCL_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    return backend->commInitAll(comms, numDevices, deviceIDs);
+}
+
+__C infinicclStatus_t infinicclGetUniqueId(infinicclUniqueId *id) {
+    if (id == nullptr)
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    return bootstrapCreateRoot(id);
+}
+
+__C infinicclStatus_t infinicclCommInitRank(DeviceType deviceType,
+                                            infinicclComm_t *comm,
+                                            infinicclUniqueId const *id,
+                                            unsigned nranks, unsigned rank,
+                                            unsigned deviceID) {
+    if (comm == nullptr || id == nullptr || rank >= nranks)
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    auto backend = getCclBackend(deviceType);
+    if (backend == nullptr)
+        backend = loadCclBackend(deviceType);
+    if (backend == nullptr || backend->commInitRank == nullptr)
+        return INFINICCL_STATUS_DEVICE_NOT_SUPPORTED;
+    return backend->commInitRank(comm, id, nranks, rank, deviceID);
 }
 
 __C infinicclStatus_t infinicclCommDestroy(infinicclComm_t comm) {
     if (comm == nullptr) {
         return INFINICCL_STATUS_SUCCESS;
     }
-    switch (comm->deviceType) {
-    case DEVICE_NVIDIA:
-        return infinicclCudaCommDestroy(comm);
-    case DEVICE_ASCEND:
-        return infinicclAscendCommDestroy(comm);
-    default:
-        return INFINICCL_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(comm->deviceType, commDestroy, comm);
 }
 
 __C infinicclStatus_t infinicclAllReduceSum(infinicclComm_t comm, void *sendbuf,
                                             void *recvbuf, size_t count,
                                             InfiniDataType_t datatype,
                                             infinirtStream_t stream) {
-    if (comm == nullptr) {
-        return INFINICCL_STATUS_COMMUNICATOR_UNINITIALIZED;
-    }
-    if (stream != nullptr && comm->deviceType != stream->device) {
-        return INFINICCL_STATUS_DEVICE_MISMATCH;
-    }
-    switch (comm->deviceType) {
-    case DEVICE_NVIDIA:
-        return infinicclCudaAllReduceSum(comm, sendbuf, recvbuf, count,
-                                         datatype, stream);
-    case DEVICE_ASCEND:
-        return infinicclAscendAllReduceSum(comm, sendbuf, recvbuf, count,
-                                           datatype, stream);
-    default:
-        return INFINICCL_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, allReduceSum, comm, sendbuf, recvbuf, count,
+             datatype, stream);
+}
+
+
+__C infinicclStatus_t infinicclAllGather(infinicclComm_t comm, void *sendbuf,
+                                         void *recvbuf, size_t sendcount,
+                                         InfiniDataType_t datatype,
+                                         infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, allGather, comm, sendbuf, recvbuf, sendcount,
+             datatype, stream);
+}
+
+__C infinicclStatus_t infinicclReduceScatterSum(infinicclComm_t comm,
+                                                void *sendbuf, void *recvbuf,
+                                                size_t recvcount,
+                                                InfiniDataType_t datatype,
+                                                infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, reduceScatterSum, comm, sendbuf, recvbuf,
+             recvcount, datatype, stream);
+}
+
+__C infinicclStatus_t infinicclBroadcast(infinicclComm_t comm, void *sendbuf,
+                                         void *recvbuf, size_t count,
+                                         InfiniDataType_t datatype,
+                                         unsigned int root,
+                                         infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, broadcast, comm, sendbuf, recvbuf, count,
+             datatype, root, stream);
+}
+
+__C infinicclStatus_t infinicclSend(infinicclComm_t comm, void *sendbuf,
+                                    size_t count, InfiniDataType_t datatype,
+                                    unsigned int peer,
+                                    infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, send, comm, sendbuf, count, datatype, peer,
+             stream);
+}
+
+__C infinicclStatus_t infinicclRecv(infinicclComm_t comm, void *recvbuf,
+                                    size_t count, InfiniDataType_t datatype,
+                                    unsigned int peer,
+                                    infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, recv, comm, recvbuf, count, datatype, peer,
+             stream);
+}
+
+__C infinicclStatus_t infinicclAllReduceSumRMSNorm(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, void const *residual,
+    void *normbuf, void const *weight, size_t nrow, size_t dim, float epsilon,
+    InfiniDataType_t datatype, InfiniDataType_t weightType,
+    infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    DISPATCH(comm->deviceType, allReduceSumRMSNorm, comm, sendbuf, recvbuf,
+             residual, normbuf, weight, nrow, dim, epsilon, datatype,
+             weightType, stream);
+}
+
+__C infinicclStatus_t infinicclAllReduceSumCompressed(
+    infinicclComm_t comm, void *sendbuf, void *recvbuf, size_t count,
+    InfiniDataType_t datatype, infinicclCompression_t compression,
+    infinirtStream_t stream) {
+    CHECK_COMM(comm, stream);
+    if (compression == INFINICCL_COMPRESSION_NONE)
+        DISPATCH(comm->deviceType, allReduceSum, comm, sendbuf, recvbuf, count,
+                 datatype, stream);
+    if (compression != INFINICCL_COMPRESSION_INT8 &&
+        compression != INFINICCL_COMPRESSION_FP8_E4M3)
+        return INFINICCL_STATUS_INVALID_ARGUMENT;
+    DISPATCH(comm->deviceType, allReduceSumCompressed, comm, sendbuf, recvbuf,
+             count, datatype, compression, stream);
 }
@@ -3,11 +3,21 @@
 #include "infini_infer.h"
 #include "infiniccl.h"
 #include "infinirt.h"
+#include "../ops/sample_candidates.h"
+#include "../ops/top_logprobs.h"
+#include "../ops/varlen_attention.h"
 #include "llama_weights.h"
+#include "prefix_tree.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
 #include <random>
 #include <thread>
 #include <vector>
 
+// Smallest token chunk worth a separate all-reduce.
+constexpr unsigned int COMM_CHUNK_MIN_TOKENS = 64;
+
 struct DeviceResource
 {
     // Device
@@ -22,22 +32,58 @@ struct DeviceResource
     // Streams
     infinirtStream_t stream_compute, stream_data, stream_cache;
     infinicclComm_t comm;
+    // Decode lane of INFER_MODE_DUAL_STREAM, null otherwise. Decode batches
+    // get their own handle, streams and communicator so they never queue
+    // behind prefill work.
+    infiniopHandle_t handle_decode;
+    infinirtStream_t stream_decode, stream_decode_data;
+    infinicclComm_t comm_decode;
+    // Tensor-parallel all-reduce overlap, see set_comm_overlap. stream_comm
+    // is null while it is off.
+    infinirtStream_t stream_comm;
+    unsigned int comm_chunks;
+    // Tensor-parallel all-reduces, see set_comm_compression.
+    infinicclCompression_t comm_compression;
+    // Pipeline stage, see create_model_parallel. The weights above cover the
+    // stage's layers only; the embedding lives on the first stage and the
+    // output head on the last. comm_pipe links the device with the same
+    // tensor-parallel rank in every stage, ranked by stage.
+    unsigned int stage, nstage;
+    infinicclComm_t comm_pipe;
+    // Memory
+    std::shared_ptr<MemoryAccount> memory;
 };
 
+infiniopHandle_t create_handle(DeviceType device, unsigned int dev_id) {
+    infiniopHandle_t handle;
+    // Simulated devices compute with the CPU operators, which run on the
+    // calling thread rather than on the SIM stream.
+    infiniopCreateHandle(&handle, device == DEVICE_SIM ? DevCpu : (Device)device,
+                         dev_id);
+    return handle;
+}
+
 void create_device_resource(DeviceResource *rsrc, LlamaMeta const *meta,
                                    LlamaWeights const *weights,
                                    DeviceType device, unsigned int idev,
                                    unsigned int ndev, unsigned int dev_id,
-                                   infinicclComm_t comm) {
-    infiniopHandle_t handle;
-    infiniopCreateHandle(&handle, (Device)device, dev_id);
+                                   infinicclComm_t comm, unsigned int stage,
+                                   unsigned int nstage,
+                                   infinicclComm_t comm_pipe,
+                                   std::shared_ptr<HostPins> pins) {
+    auto handle = create_handle(device, dev_id);
+    auto memory = std::make_shared<MemoryAccount>();
+    MemoryScope scope(memory, MEMORY_CATEGORY_WEIGHT);
+    HostPinScope pin_scope(std::move(pins));
     infinirtStream_t stream_compute, stream_data, stream_cache;
     infinirtStreamCreate(&stream_compute, device, dev_id);
     infinirtStreamCreate(&stream_data, device, dev_id);
     infinirtStreamCreate(&stream_cache, device, dev_id);
     std::vector<std::shared_ptr<Tensor>> w_attn_norm, w_attn_qkv, w_attn_out,
         w_ffn_norm, w_ffn_gate_up, w_ffn_down;
-    for (size_t layer = 0; layer < meta->nlayer; layer++) {
+    auto layers = stage_layers(meta->nlayer, stage, nstage);
+    for (size_t layer = layers.begin; layer < layers.begin + layers.len;
+         layer++) {
         w_attn_norm.push_back(
             get_attn_norm(meta, weights, layer, device, dev_id));
         w_attn_qkv.push_back(
@@ -52,12 +98,17 @@ void create_device_resource(DeviceResource *rsrc, LlamaMeta const *meta,
             get_ffn_down(meta, weights, layer, idev, ndev, device, dev_id));
     }
 
+    auto first = stage == 0, last = stage + 1 == nstage;
     *rsrc = DeviceResource{device,
                               dev_id,
                               handle,
-                              get_in_embd(meta, weights, device, dev_id),
-                              get_out_norm(meta, weights, device, dev_id),
-                              get_out_embd(meta, weights, device, dev_id),
+                              first ? get_in_embd(meta, weights, device, dev_id)
+                                    : nullptr,
+                              last ? get_out_norm(meta, weights, device, dev_id)
+                                   : nullptr,
+                              last ? get_out_embd(meta, weights, idev, ndev,
+                                                  device, dev_id)
+                                   : nullptr,
                               get_sin_table(meta, device, dev_id),
                               get_cos_table(meta, device, dev_id),
                               w_attn_norm,
@@ -69,58 +120,247 @@ void create_device_resource(DeviceResource *rsrc, LlamaMeta const *meta,
                               stream_compute,
                               stream_data,
                               stream_cache,
-                              comm};
+                              comm,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              1,
+                              INFINICCL_COMPRESSION_NONE,
+                              stage,
+                              nstage,
+                              comm_pipe,
+                              memory};
 }
 
 struct Model
 {
     LlamaMeta meta;
-    std::vector<DeviceResource> const dev;
-    Model(LlamaMeta const &_meta, std::vector<DeviceResource> const &&_dev)
-        : meta(_meta), dev(std::move(_dev)) {}
+    std::vector<DeviceResource> dev;
+    // Tensor-parallel rank of dev[0] and size of the group. The group spans
+    // processes when nrank > dev.size().
+    unsigned int rank, nrank;
+    // Pipeline stages; dev holds nstage groups of dev.size() / nstage
+    // devices, stage by stage.
+    unsigned int nstage;
+    // Token budget of one forward pass, see set_prefill_chunk. 0 is
+    // unlimited.
+    unsigned int prefill_chunk;
+    // Speculative decoding with this model as the target, see
+    // get_speculative_stats.
+    std::atomic<uint64_t> spec_rounds{0}, spec_proposed{0}, spec_accepted{0};
+    Model(LlamaMeta const &_meta, std::vector<DeviceResource> const &&_dev,
+          unsigned int _rank, unsigned int _nrank, unsigned int _nstage)
+        : meta(_meta), dev(std::move(_dev)), rank(_rank), nrank(_nrank),
+          nstage(_nstage), prefill_chunk(0) {}
 };
 
 __C struct Model *create_model(LlamaMeta const *meta,
                                LlamaWeights const *weights, DeviceType device,
                                unsigned int ndev, unsigned int const *dev_ids) {
-    ASSERT_EQ(meta->nh % ndev, 0);
-    ASSERT_EQ(meta->nkvh % ndev, 0);
-    ASSERT_EQ(meta->di % ndev, 0);
+    return create_model_parallel(meta, weights, device, ndev, 1, dev_ids);
+}
+
+__C struct Model *create_model_parallel(LlamaMeta const *meta,
+                                        LlamaWeights const *weights,
+                                        DeviceType device, unsigned int tp,
+                                        unsigned int pp,
+                                        unsigned int const *dev_ids) {
+    ASSERT(tp > 0 && pp > 0 && pp <= meta->nlayer);
+    ASSERT_EQ(meta->nh % tp, 0);
+    ASSERT_EQ(meta->nkvh % tp, 0);
+    ASSERT_EQ(meta->di % tp, 0);
     RUN_INFINI(infinirtInit(device));
+    auto ndev = tp * pp;
     auto dev = std::vector<DeviceResource>(ndev);
+    // comms[stage * tp + t] joins the devices of one stage, pipe_comms
+    // the devices of tensor-parallel rank t across stages.
     auto comms = std::vector<infinicclComm_t>(ndev, nullptr);
-    if (ndev > 1) {
-        RUN_INFINI(infinicclCommInitAll(device, comms.data(), ndev, dev_ids));
+    auto pipe_comms = std::vector<infinicclComm_t>(ndev, nullptr);
+    for (unsigned int stage = 0; tp > 1 && stage < pp; stage++) {
+        RUN_INFINI(infinicclCommInitAll(device, &comms[stage * tp], tp,
+                                        &dev_ids[stage * tp]));
     }
+    for (unsigned int t = 0; pp > 1 && t < tp; t++) {
+        auto ids = std::vector<unsigned int>(pp);
+        auto column = std::vector<infinicclComm_t>(pp);
+        for (unsigned int stage = 0; stage < pp; stage++) {
+            ids[stage] = dev_ids[stage * tp + t];
+        }
+        RUN_INFINI(
+            infinicclCommInitAll(device, column.data(), pp, ids.data()));
+        for (unsigned int stage = 0; stage < pp; stage++) {
+            pipe_comms[stage * tp + t] = column[stage];
+        }
+    }
+    // Shared by the loader threads, so weights replicated on every device
+    // are pinned once; they are unregistered once loading is done.
+    auto pins = std::make_shared<HostPins>();
     auto threads = std::vector<std::thread>(ndev);
-    for (unsigned int idev = 0; idev < ndev; idev++) {
-        threads[idev] =
-            std::thread(create_device_resource, &(dev[idev]), meta, weights,
-                        device, idev, ndev, dev_ids[idev], comms[idev]);
+    for (unsigned int i = 0; i < ndev; i++) {
+        threads[i] = std::thread(create_device_resource, &(dev[i]), meta,
+                                 weights, device, i % tp, tp, dev_ids[i],
+                                 comms[i], i / tp, pp, pipe_comms[i], pins);
     }
-    for (unsigned int idev = 0; idev < ndev; idev++) {
-        threads[idev].join();
+    for (unsigned int i = 0; i < ndev; i++) {
+        threads[i].join();
     }
-    
-    auto model = new Model(*meta, std::move(dev));
+
+    auto model = new Model(*meta, std::move(dev), 0, tp, pp);
     return model;
 }
 
+__C struct Model *create_model_with_comm(LlamaMeta const *meta,
+                                         LlamaWeights const *weights,
+                                         DeviceType device,
+                                         unsigned int dev_id,
+                                         infinicclComm_t comm,
+                                         unsigned int rank,
+                                         unsigned int nrank) {
+    ASSERT(rank < nrank);
+    ASSERT(comm != nullptr || nrank == 1);
+    ASSERT_EQ(meta->nh % nrank, 0);
+    ASSERT_EQ(meta->nkvh % nrank, 0);
+    ASSERT_EQ(meta->di % nrank, 0);
+    RUN_INFINI(infinirtInit(device));
+    auto dev = std::vector<DeviceResource>(1);
+    create_device_resource(&dev[0], meta, weights, device, rank, nrank, dev_id,
+                           comm, 0, 1, nullptr, std::make_shared<HostPins>());
+    return new Model(*meta, std::move(dev), rank, nrank, 1);
+}
+
+void create_decode_lane(DeviceResource *rsrc, infinicclComm_t comm) {
+    auto device = rsrc->device;
+    auto dev_id = rsrc->device_id;
+    int least, greatest;
+    RUN_INFINI(infinirtDeviceGetStreamPriorityRange(device, dev_id, &least,
+                                                    &greatest));
+    // Prefill moves to the lowest priority so decode preempts it even where
+    // default streams are not the lowest.
+    RUN_INFINI(infinirtStreamSynchronize(rsrc->stream_compute));
+    RUN_INFINI(infinirtStreamDestroy(rsrc->stream_compute));
+    RUN_INFINI(infinirtStreamCreateWithPriority(&rsrc->stream_compute, device,
+                                                dev_id, least));
+    rsrc->handle_decode = create_handle(device, dev_id);
+    RUN_INFINI(infinirtStreamCreateWithPriority(&rsrc->stream_decode, device,
+                                                dev_id, greatest));
+    RUN_INFINI(infinirtStreamCreateWithPriority(&rsrc->stream_decode_data,
+                                                device, dev_id, greatest));
+    rsrc->comm_decode = comm;
+}
+
+void destroy_decode_lane(DeviceResource *rsrc) {
+    RUN_INFINI(infinirtStreamSynchronize(rsrc->stream_decode));
+    RUN_INFINI(infinirtStreamSynchronize(rsrc->stream_decode_data));
+    RUN_INFINI(infinirtStreamSynchronize(rsrc->stream_compute));
+    infiniopDestroyHandle(rsrc->handle_decode);
+    infinirtStreamDestroy(rsrc->stream_decode);
+    infinirtStreamDestroy(rsrc->stream_decode_data);
+    infinicclCommDestroy(rsrc->comm_decode);
+    rsrc->handle_decode = nullptr;
+    rsrc->stream_decode = nullptr;
+    rsrc->stream_decode_data = nullptr;
+    rsrc->comm_decode = nullptr;
+    RUN_INFINI(infinirtStreamDestroy(rsrc->stream_compute));
+    RUN_INFINI(infinirtStreamCreate(&rsrc->stream_compute, rsrc->device,
+                                    rsrc->device_id));
+}
+
+__C void set_infer_mode(struct Model *model, InferMode mode) {
+    auto ndev = model->dev.size();
+    auto dual = model->dev[0].stream_decode != nullptr;
+    if (dual == (mode == INFER_MODE_DUAL_STREAM)) {
+        return;
+    }
+    if (dual) {
+        for (auto &rsrc : model->dev) {
+            destroy_decode_lane(&rsrc);
+        }
+        return;
+    }
+    // Collectives of the two lanes may run concurrently, so each lane has
+    // its own communicator.
+    // The second communicator can only be created for a group that lives in
+    // this process, and stage hand-offs have a single lane.
+    ASSERT_EQ(model->nstage, 1);
+    ASSERT_EQ(model->nrank, ndev);
+    auto comms = std::vector<infinicclComm_t>(ndev, nullptr);
+    if (ndev > 1) {
+        auto dev_ids = std::vector<unsigned int>(ndev);
+        for (unsigned int idev = 0; idev < ndev; idev++) {
+            dev_ids[idev] = model->dev[idev].device_id;
+        }
+        RUN_INFINI(infinicclCommInitAll(model->dev[0].device, comms.data(),
+                                        ndev, dev_ids.data()));
+    }
+    for (unsigned int idev = 0; idev < ndev; idev++) {
+        create_decode_lane(&model->dev[idev], comms[idev]);
+    }
+}
+
+__C void set_comm_overlap(struct Model *model, unsigned int nchunk) {
+    nchunk = std::max(nchunk, 1u);
+    for (auto &rsrc : model->dev) {
+        if (rsrc.stream_comm != nullptr) {
+            RUN_INFINI(infinirtStreamSynchronize(rsrc.stream_comm));
+            RUN_INFINI(infinirtStreamDestroy(rsrc.stream_comm));
+            rsrc.stream_comm = nullptr;
+        }
+        // Host collectives drain the stream and reduce on the calling
+        // thread, which also runs the host operators, so chunks could only
+        // serialize; without stream_comm infer_device never chunks.
+        if (nchunk > 1 && model->nrank > 1 && !runs_on_host(rsrc.device)) {
+            RUN_INFINI(infinirtStreamCreate(&rsrc.stream_comm, rsrc.device,
+                                            rsrc.device_id));
+        }
+        rsrc.comm_chunks = nchunk;
+    }
+}
+
+__C void set_prefill_chunk(struct Model *model, unsigned int max_tokens) {
+    model->prefill_chunk = max_tokens;
+}
+
+__C void set_comm_compression(struct Model *model,
+                              infinicclCompression_t compression) {
+    for (auto &rsrc : model->dev) {
+        rsrc.comm_compression = compression;
+    }
+}
+
 struct KVCache {
+    // Owner id of the cache's storages in the memory accounts.
+    uint64_t id;
     std::vector<std::vector<std::shared_ptr<Tensor>>> k, v;
+    // Per device, recorded after the last work touching the cache. Work on
+    // any stream waits for it first, so a request can move between the
+    // prefill and decode lanes.
+    std::vector<infinirtEvent_t> ready;
 };
 
+// Owner ids of KV and prefix cache storages in the memory accounts.
+uint64_t next_cache_id() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id++;
+}
+
 __C struct KVCache *create_kv_cache(struct Model const *model) {
     KVCache *cache = new KVCache();
+    cache->id = next_cache_id();
     auto ndev = model->dev.size();
-    auto nkvh = model->meta.nkvh / ndev;
+    auto nkvh = model->meta.nkvh / model->nrank;
     auto max_len = model->meta.dctx;
     auto dh = model->meta.dh;
     auto shape = std::vector<index_t>{nkvh, max_len, dh};
     for (unsigned int idev = 0; idev < ndev; idev++) {
+        MemoryScope scope(model->dev[idev].memory, MEMORY_CATEGORY_KV_CACHE,
+                          cache->id);
         auto kcache = std::vector<std::shared_ptr<Tensor>>();
         auto vcache = std::vector<std::shared_ptr<Tensor>>();
-        for (unsigned int layer = 0; layer < model->meta.nlayer; layer++) {
+        // Only the layers of the device's pipeline stage.
+        auto nlayer = model->dev[idev].w_attn_norm.size();
+        for (unsigned int layer = 0; layer < nlayer; layer++) {
             kcache.push_back(std::move(Tensor::buffer(model->meta.dt_mat, shape,
                                                 model->dev[idev].device,
                                                 model->dev[idev].device_id,
@@ -132,6 +372,11 @@ __C struct KVCache *create_kv_cache(struct Model const *model) {
         }
         cache->k.push_back(kcache);
         cache->v.push_back(vcache);
+        infinirtEvent_t ready;
+        RUN_INFINI(infinirtEventCreate(&ready, model->dev[idev].device,
+                                       model->dev[idev].device_id));
+        RUN_INFINI(infinirtEventRecord(ready, model->dev[idev].stream_cache));
+        cache->ready.push_back(ready);
     }
 
     return cache;
@@ -143,7 +388,10 @@ __C struct KVCache *duplicate_kv_cache(struct Model const *model,
     auto new_kv_cache = create_kv_cache(model);
     auto ndev = model->dev.size();
     for (unsigned int idev = 0; idev < ndev; idev++) {
-        for (unsigned int layer = 0; layer < model->meta.nlayer; layer++) {
+        RUN_INFINI(infinirtStreamWaitEvent(kv_cache->ready[idev],
+                                           model->dev[idev].stream_cache));
+        for (unsigned int layer = 0; layer < kv_cache->k[idev].size();
+             layer++) {
             new_kv_cache->k[idev][layer]
                 ->slice(1, 0, seq_len)
                 ->copy_from(kv_cache->k[idev][layer]->slice(1, 0, seq_len),
@@ -156,21 +404,166 @@ __C struct KVCache *duplicate_kv_cache(struct Model const *model,
                             model->dev[idev].handle,
                             model->dev[idev].stream_cache);
         }
+        RUN_INFINI(infinirtEventRecord(new_kv_cache->ready[idev],
+                                       model->dev[idev].stream_cache));
     }
     return new_kv_cache;
 }
 
-__C void drop_kv_cache(struct Model const *, struct KVCache *kv_cache) {
+__C void drop_kv_cache(struct Model const *model, struct KVCache *kv_cache) {
+    // The buffers are released on stream_cache once pending work is done.
+    for (unsigned int idev = 0; idev < model->dev.size(); idev++) {
+        RUN_INFINI(infinirtStreamWaitEvent(kv_cache->ready[idev],
+                                           model->dev[idev].stream_cache));
+        RUN_INFINI(infinirtEventDestroy(kv_cache->ready[idev]));
+    }
     delete kv_cache;
 }
 
+// KV of a run of positions held by a prefix cache: per device and layer,
+// [nkvh, len, dh] like the matching rows of a KVCache.
+struct KVSegment {
+    std::vector<std::vector<std::shared_ptr<Tensor>>> k, v;
+};
+
+struct PrefixCache {
+    PrefixCache(struct Model const *model, size_t capacity)
+        : model(model), id(next_cache_id()), tree(capacity) {}
+
+    struct Model const *model;
+    uint64_t id;
+    PrefixTree<KVSegment> tree;
+    size_t lookup_tokens = 0, hit_tokens = 0;
+    mutable std::mutex mutex;
+};
+
+__C struct PrefixCache *create_prefix_cache(struct Model const *model,
+                                            size_t max_bytes) {
+    // The budget holds on every device, so the one storing the most layers
+    // sets the capacity.
+    size_t token_bytes = 0;
+    for (auto const &rsrc : model->dev) {
+        token_bytes = std::max(token_bytes,
+                               2 * rsrc.w_attn_norm.size() * model->meta.nkvh /
+                                   model->nrank * model->meta.dh *
+                                   dt_size(model->meta.dt_mat));
+    }
+    return new PrefixCache(model, max_bytes / token_bytes);
+}
+
+__C unsigned int prefix_cache_match(struct PrefixCache *cache,
+                                    unsigned int ntok,
+                                    unsigned int const *tokens,
+                                    struct KVCache *kv_cache) {
+    auto model = cache->model;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->lookup_tokens += ntok;
+    // The last token is left to prefill so that it yields a sample.
+    auto spans = cache->tree.match(tokens, ntok > 0 ? ntok - 1 : 0);
+    if (spans.empty()) {
+        return 0;
+    }
+    for (unsigned int idev = 0; idev < model->dev.size(); idev++) {
+        auto const &rsrc = model->dev[idev];
+        RUN_INFINI(infinirtStreamWaitEvent(kv_cache->ready[idev],
+                                           rsrc.stream_cache));
+        for (auto const &span : spans) {
+            for (unsigned int layer = 0; layer < kv_cache->k[idev].size();
+                 layer++) {
+                kv_cache->k[idev][layer]
+                    ->slice(1, span.pos, span.len)
+                    ->copy_from(span.block->k[idev][layer]->slice(
+                                    1, span.offset, span.len),
+                                rsrc.handle, rsrc.stream_cache);
+                kv_cache->v[idev][layer]
+                    ->slice(1, span.pos, span.len)
+                    ->copy_from(span.block->v[idev][layer]->slice(
+                                    1, span.offset, span.len),
+                                rsrc.handle, rsrc.stream_cache);
+            }
+        }
+        RUN_INFINI(infinirtEventRecord(kv_cache->ready[idev],
+                                       rsrc.stream_cache));
+    }
+    unsigned int hit = spans.back().pos + spans.back().len;
+    cache->hit_tokens += hit;
+    return hit;
+}
+
+__C void prefix_cache_insert(struct PrefixCache *cache, unsigned int ntok,
+                             unsigned int const *tokens,
+                             struct KVCache const *kv_cache) {
+    auto model = cache->model;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    for (unsigned int idev = 0; idev < model->dev.size(); idev++) {
+        RUN_INFINI(infinirtStreamWaitEvent(kv_cache->ready[idev],
+                                           model->dev[idev].stream_cache));
+    }
+    cache->tree.insert(tokens, ntok, [&](size_t pos, size_t len) {
+        auto segment = KVSegment();
+        auto shape = std::vector<index_t>{model->meta.nkvh / model->nrank,
+                                          len, model->meta.dh};
+        for (unsigned int idev = 0; idev < model->dev.size(); idev++) {
+            auto const &rsrc = model->dev[idev];
+            MemoryScope scope(rsrc.memory, MEMORY_CATEGORY_KV_CACHE,
+                              cache->id);
+            auto kseg = std::vector<std::shared_ptr<Tensor>>();
+            auto vseg = std::vector<std::shared_ptr<Tensor>>();
+            for (unsigned int layer = 0; layer < kv_cache->k[idev].size();
+                 layer++) {
+                auto k = Tensor::buffer(model->meta.dt_mat, shape, rsrc.device,
+                                        rsrc.device_id, rsrc.stream_cache);
+                auto v = Tensor::buffer(model->meta.dt_mat, shape, rsrc.device,
+                                        rsrc.device_id, rsrc.stream_cache);
+                k->copy_from(kv_cache->k[idev][layer]->slice(1, pos, len),
+                             rsrc.handle, rsrc.stream_cache);
+                v->copy_from(kv_cache->v[idev][layer]->slice(1, pos, len),
+                             rsrc.handle, rsrc.stream_cache);
+                kseg.push_back(k);
+                vseg.push_back(v);
+            }
+            segment.k.push_back(kseg);
+            segment.v.push_back(vseg);
+        }
+        return segment;
+    });
+    for (unsigned int idev = 0; idev < model->dev.size(); idev++) {
+        RUN_INFINI(infinirtEventRecord(kv_cache->ready[idev],
+                                       model->dev[idev].stream_cache));
+    }
+}
+
+__C void get_prefix_cache_stats(struct PrefixCache const *cache,
+                                PrefixCacheStats *stats) {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    stats->lookup_tokens = cache->lookup_tokens;
+    stats->hit_tokens = cache->hit_tokens;
+    stats->resident_tokens = cache->tree.resident();
+    stats->evicted_tokens = cache->tree.evicted();
+}
+
+__C void destroy_prefix_cache(struct PrefixCache *cache) {
+    // Segments are released on stream_cache after the copies reading them.
+    delete cache;
+}
+
+// idev and ndev place the device in the tensor-parallel group of its stage;
+// local indexes it among the nlocal devices of this process, as the caches
+// are. Stages after the first receive the hidden states from the previous
+// one instead of embedding tokens, and all but the last hand them on.
+// ans receives one sample per request, taken after its last token, or one
+// per token when all_tokens is set; outputs, when given, receives the same
+// rows.
 void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
-                  unsigned int idev, unsigned int ndev, unsigned int ntok,
+                  unsigned int idev, unsigned int ndev, unsigned int local,
+                  unsigned int nlocal, unsigned int ntok,
                   unsigned int const *tokens, unsigned int nreq,
                   unsigned int const *req_lens, unsigned int const *req_pos,
                   struct KVCache **kv_caches, unsigned int *ans,
-                  float temperature, unsigned int topk, float topp) {
-    auto nlayer = meta.nlayer;
+                  float temperature, unsigned int topk, float topp,
+                  bool all_tokens, InferOutputs const *outputs) {
+    unsigned int nlayer = rsrc.w_attn_norm.size();
+    auto first = rsrc.stage == 0, last = rsrc.stage + 1 == rsrc.nstage;
     auto nkvh = meta.nkvh / ndev;
     auto nh = meta.nh / ndev;
     auto dctx = meta.dctx;
@@ -181,13 +574,17 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
     auto dvoc = meta.dvoc;
     auto device = rsrc.device;
     auto device_id = rsrc.device_id;
-    auto stream_compute = rsrc.stream_compute;
-    auto stream_data = rsrc.stream_data;
-    auto stream_cache = rsrc.stream_cache;
+    // Batches of one token per request are decode steps.
+    auto decode = rsrc.stream_decode != nullptr && ntok == nreq;
+    auto handle = decode ? rsrc.handle_decode : rsrc.handle;
+    auto stream_compute = decode ? rsrc.stream_decode : rsrc.stream_compute;
+    auto stream_data = decode ? rsrc.stream_decode_data : rsrc.stream_data;
+    auto comm = decode ? rsrc.comm_decode : rsrc.comm;
     void *stream_compute_raw;
     infinirtGetRawStream(&stream_compute_raw, stream_compute);
 
     // Allocate buffers
+    MemoryScope activation_scope(rsrc.memory, MEMORY_CATEGORY_ACTIVATION);
     auto logits_in =
         Tensor::buffer(dt_logits, {ntok, d}, device, device_id, stream_data);
     auto logits_out =
@@ -196,11 +593,44 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
                                   device, device_id, stream_data);
     auto o_buf = Tensor::buffer(dt_logits, {ntok, nh * dh}, device, device_id,
                                 stream_data);
-    auto prob_buf =
-        Tensor::buffer(dt_logits, {nreq, dvoc}, device, device_id, stream_data);
+    // Each device of the last stage computes the logits of its vocabulary
+    // shard for the nout sampled rows. With several shards, each reduces its
+    // rows to top-k candidate records and rank 0 draws from those of all
+    // shards. The full logits are gathered into prob_buf on rank 0 instead
+    // under infer_ex, or when the records would be larger. That choice must
+    // be the same on every rank, so it follows the entry point, which all
+    // processes share, rather than the buffers this one passed.
+    unsigned int nout = all_tokens ? ntok : nreq;
+    auto shard = vocab_shard(dvoc, idev, ndev);
+    auto gather_logits = outputs != nullptr;
+    unsigned int sample_k = temperature <= 0 ? 1 : topk;
+    auto record_size = candidate_record_size(sample_k);
+    auto reduce_candidates = last && ndev > 1 && !gather_logits &&
+                             sample_k > 0 &&
+                             record_size * ndev < dt_size(dt_logits) * dvoc;
+    auto prob_buf = last && idev == 0 && !reduce_candidates
+                        ? Tensor::buffer(dt_logits, {nout, dvoc}, device,
+                                         device_id, stream_data)
+                        : nullptr;
+    auto logits_shard = !last || ndev == 1
+                            ? prob_buf
+                            : Tensor::buffer(dt_logits, {nout, shard.len},
+                                             device, device_id, stream_data);
     auto result_buf =
-        Tensor::buffer(INFINI_U64, {nreq}, device, device_id, stream_data);
-    auto result_cpu = std::vector<uint64_t>(nreq);
+        last ? Tensor::buffer(INFINI_U64, {nout}, device, device_id, stream_data)
+             : nullptr;
+    // Records are whole 8-byte words, so they move as U64.
+    auto record_words = record_size / sizeof(uint64_t);
+    auto records_send = reduce_candidates
+                            ? Tensor::buffer(INFINI_U64, {nout * record_words},
+                                             device, device_id, stream_data)
+                            : nullptr;
+    auto records_recv =
+        reduce_candidates
+            ? Tensor::buffer(INFINI_U64, {ndev * nout * record_words}, device,
+                             device_id, stream_data)
+            : nullptr;
+    auto result_cpu = std::vector<uint64_t>(nout);
     // Prepare inputs
     auto batch_pos_ids = std::vector<index_t>(ntok);
     index_t req_start = 0;
@@ -217,33 +647,45 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
                                      rsrc.device, rsrc.device_id);
     } else {
         pos_ids_buf = Tensor::buffer(INFINI_U64, {ntok}, rsrc.device,
-                                     rsrc.device_id, rsrc.stream_compute);
-        RUN_INFINI(infinirtMemcpyH2DAsync(pos_ids_buf->data(rsrc.stream_compute), device,
+                                     rsrc.device_id, stream_compute);
+        RUN_INFINI(infinirtMemcpyH2DAsync(pos_ids_buf->data(stream_compute), device,
                                device_id, batch_pos_ids.data(), sizeof(uint64_t) * ntok,
-                               rsrc.stream_compute));
+                               stream_compute));
     }
-    for (unsigned int i = 0; i < ntok; i++) {
+    for (unsigned int i = 0; first && i < ntok; i++) {
         RUN_INFINI(infinirtMemcpyAsync(logits_in->data(i * d, stream_compute),
                             rsrc.w_in_embd->data(tokens[i] * d, stream_compute),
                             device, device_id,
                             dt_size(dt_logits) * d, stream_compute));
     }
+    if (!first) {
+        RUN_INFINI(infinicclRecv(rsrc.comm_pipe,
+                                 logits_in->data(stream_compute), ntok * d,
+                                 dt_logits, rsrc.stage - 1, stream_compute));
+    }
+    for (unsigned int req = 0; req < nreq; req++) {
+        RUN_INFINI(infinirtStreamWaitEvent(kv_caches[req]->ready[local],
+                                           stream_compute));
+    }
+    if (runs_on_host(device)) {
+        // CPU operators run on this thread rather than on the stream.
+        RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+    }
 
     // Prepare operators and workspace
-    void *workspace;
     size_t workspace_size = 0, temp_size = 0;
     infiniopRMSNormDescriptor_t desc_norm;
     RUN_INFINI(infiniopCreateRMSNormDescriptor(
-        rsrc.handle, &desc_norm, logits_in->desc()->get(),
+        handle, &desc_norm, logits_in->desc()->get(),
         logits_out->desc()->get(), rsrc.w_attn_norm[0]->desc()->get(),
         meta.epsilon));
     RUN_INFINI(infiniopGetRMSNormWorkspaceSize(desc_norm, &workspace_size));
     infiniopMatmulDescriptor_t desc_attn_qkv, desc_attn_o;
     RUN_INFINI(infiniopCreateMatmulDescriptor(
-        rsrc.handle, &desc_attn_qkv, qkv_buf->desc()->get(), 1.0,
+        handle, &desc_attn_qkv, qkv_buf->desc()->get(), 1.0,
         logits_in->desc()->get(), rsrc.w_attn_qkv[0]->desc()->get(), 0.0));
     RUN_INFINI(infiniopCreateMatmulDescriptor(
-        rsrc.handle, &desc_attn_o, logits_in->desc()->get(), 1.0,
+        handle, &desc_attn_o, logits_in->desc()->get(), 1.0,
         o_buf->desc()->get(), rsrc.w_attn_out[0]->desc()->get(),
         idev == 0 ? 1.0 : 0.0)); // only rank 0 adds residual
     RUN_INFINI(infiniopGetMatmulWorkspaceSize(desc_attn_qkv, &temp_size));
@@ -253,28 +695,113 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
     infiniopRoPEDescriptor_t desc_rope_q, desc_rope_k;
     qkv_buf->dim_split(1, {nh + nkvh * 2, dh}); // (ntok, nh + 2 * nkvh, dh)
     RUN_INFINI(infiniopCreateRoPEDescriptor(
-        rsrc.handle, &desc_rope_q, qkv_buf->slice(1, 0, nh)->desc()->get(),
+        handle, &desc_rope_q, qkv_buf->slice(1, 0, nh)->desc()->get(),
         pos_ids_buf->desc()->get(), rsrc.sin_table->desc()->get(),
         rsrc.cos_table->desc()->get()));
     RUN_INFINI(infiniopGetRoPEWorkspaceSize(desc_rope_q, &temp_size));
     workspace_size = std::max(workspace_size, temp_size);
     RUN_INFINI(infiniopCreateRoPEDescriptor(
-        rsrc.handle, &desc_rope_k, qkv_buf->slice(1, nh, nkvh)->desc()->get(),
+        handle, &desc_rope_k, qkv_buf->slice(1, nh, nkvh)->desc()->get(),
         pos_ids_buf->desc()->get(), rsrc.sin_table->desc()->get(),
         rsrc.cos_table->desc()->get()));
     RUN_INFINI(infiniopGetRoPEWorkspaceSize(desc_rope_k, &temp_size));
     workspace_size = std::max(workspace_size, temp_size);
     infiniopMLPDescriptor_t desc_mlp;
     RUN_INFINI(infiniopCreateMLPDescriptor(
-        rsrc.handle, &desc_mlp, logits_in->desc()->get(),
+        handle, &desc_mlp, logits_in->desc()->get(),
         logits_out->desc()->get(), rsrc.w_ffn_gate_up[0]->desc()->get(),
         rsrc.w_ffn_down[0]->desc()->get(), 1.0, idev == 0));
     RUN_INFINI(infiniopGetMLPWorkspaceSize(desc_mlp, &temp_size));
     workspace_size = std::max(workspace_size, temp_size);
+    // Chunked all-reduce: o_proj and the MLP run per token chunk, and chunk
+    // c is reduced on stream_comm while chunk c + 1 computes. The decode lane
+    // never chunks, so only one communicator ever uses stream_comm.
+    unsigned int nchunk = 1;
+    if (comm != nullptr && !decode && rsrc.stream_comm != nullptr) {
+        nchunk = std::max(1u, std::min(rsrc.comm_chunks,
+                                       ntok / COMM_CHUNK_MIN_TOKENS));
+    }
+    auto chunk_begin = [&](unsigned int c) { return size_t(ntok) * c / nchunk; };
+    auto desc_attn_o_chunks = std::vector<infiniopMatmulDescriptor_t>();
+    auto desc_mlp_chunks = std::vector<infiniopMLPDescriptor_t>();
+    auto chunk_events = std::vector<infinirtEvent_t>();
+    infinirtEvent_t reduced = nullptr;
+    if (nchunk > 1) {
+        desc_attn_o_chunks.resize(nchunk);
+        desc_mlp_chunks.resize(nchunk);
+        chunk_events.resize(nchunk);
+        for (unsigned int c = 0; c < nchunk; c++) {
+            auto begin = chunk_begin(c), len = chunk_begin(c + 1) - begin;
+            auto out = logits_in->slice(0, begin, len);
+            RUN_INFINI(infiniopCreateMatmulDescriptor(
+                handle, &desc_attn_o_chunks[c], out->desc()->get(), 1.0,
+                o_buf->slice(0, begin, len)->desc()->get(),
+                rsrc.w_attn_out[0]->desc()->get(), idev == 0 ? 1.0 : 0.0));
+            RUN_INFINI(infiniopGetMatmulWorkspaceSize(desc_attn_o_chunks[c],
+                                                      &temp_size));
+            workspace_size = std::max(workspace_size, temp_size);
+            RUN_INFINI(infiniopCreateMLPDescriptor(
+                handle, &desc_mlp_chunks[c], out->desc()->get(),
+                logits_out->slice(0, begin, len)->desc()->get(),
+                rsrc.w_ffn_gate_up[0]->desc()->get(),
+                rsrc.w_ffn_down[0]->desc()->get(), 1.0, idev == 0));
+            RUN_INFINI(infiniopGetMLPWorkspaceSize(desc_mlp_chunks[c],
+                                                   &temp_size));
+            workspace_size = std::max(workspace_size, temp_size);
+            RUN_INFINI(infinirtEventCreate(&chunk_events[c], device, device_id));
+        }
+        RUN_INFINI(infinirtEventCreate(&reduced, device, device_id));
+    }
+    // In-place all-reduce of logits_in rows [begin, begin + len). Backends
+    // without compressed collectives fall back to the exact one.
+    auto all_reduce = [&](size_t begin, size_t len, infinirtStream_t stream) {
+        auto buf = logits_in->data(begin * d, stream);
+        auto status = infinicclAllReduceSumCompressed(
+            comm, buf, buf, len * d, dt_logits, rsrc.comm_compression, stream);
+        if (status == INFINICCL_STATUS_DEVICE_NOT_SUPPORTED) {
+            status = infinicclAllReduceSum(comm, buf, buf, len * d, dt_logits,
+                                           stream);
+        }
+        RUN_INFINI(status);
+    };
+    // Hands chunk c of logits_in to stream_comm once its producer is queued.
+    auto reduce_chunk = [&](unsigned int c) {
+        auto begin = chunk_begin(c), len = chunk_begin(c + 1) - begin;
+        RUN_INFINI(infinirtEventRecord(chunk_events[c], stream_compute));
+        RUN_INFINI(infinirtStreamWaitEvent(chunk_events[c], rsrc.stream_comm));
+        all_reduce(begin, len, rsrc.stream_comm);
+    };
+    // Everything after the chunks reads all of logits_in.
+    auto wait_reduced = [&]() {
+        RUN_INFINI(infinirtEventRecord(reduced, rsrc.stream_comm));
+        RUN_INFINI(infinirtStreamWaitEvent(reduced, stream_compute));
+    };
+    // Host devices attend over the whole batch in one call per layer; others
+    // launch one attention operator per request.
+    auto varlen = runs_on_host(device) && meta.dt_mat == dt_logits &&
+                  (dt_logits == INFINI_F16 || dt_logits == INFINI_F32);
+    auto varlen_desc = VarlenAttentionDesc{
+        dt_logits,
+        nh,
+        nkvh,
+        dh,
+        stride_t((nh + nkvh * 2) * dh),
+        stride_t((nh + nkvh * 2) * dh),
+        stride_t(nh * dh),
+        stride_t(dctx * dh),
+    };
+    auto cu_seqlens = std::vector<size_t>(nreq + 1, 0);
+    auto past_lens = std::vector<size_t>(nreq);
+    auto k_caches = std::vector<void *>(nreq);
+    auto v_caches = std::vector<void *>(nreq);
+    for (unsigned int req = 0; req < nreq; req++) {
+        cu_seqlens[req + 1] = cu_seqlens[req] + req_lens[req];
+        past_lens[req] = req_pos[req];
+    }
     auto desc_attns = std::vector<infiniopAttentionDescriptor_t>(nreq);
     size_t token_offset = 0;
     o_buf->dim_split(1, {nh, dh});
-    for (unsigned int req = 0; req < nreq; req++) {
+    for (unsigned int req = 0; !varlen && req < nreq; req++) {
         auto past_len = req_pos[req];
         auto seq_len = req_lens[req];
         auto o = o_buf->slice({{0, token_offset, seq_len}});
@@ -285,10 +812,10 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
         auto v =
             qkv_buf->slice({{0, token_offset, seq_len}, {1, nh + nkvh, nkvh}})
                 ->permute({1, 0, 2});
-        auto k_cache = kv_caches[req]->k[idev][0];
-        auto v_cache = kv_caches[req]->v[idev][0];
+        auto k_cache = kv_caches[req]->k[local][0];
+        auto v_cache = kv_caches[req]->v[local][0];
         RUN_INFINI(infiniopCreateAttentionDescriptor(
-            rsrc.handle, &desc_attns[req], o->desc()->get(), q->desc()->get(),
+            handle, &desc_attns[req], o->desc()->get(), q->desc()->get(),
             k->desc()->get(), v->desc()->get(), k_cache->desc()->get(),
             v_cache->desc()->get(), past_len));
         RUN_INFINI(
@@ -296,38 +823,77 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
         workspace_size = std::max(workspace_size, temp_size);
         token_offset += seq_len;
     }
-    infiniopRMSNormDescriptor_t desc_norm_out;
-    RUN_INFINI(infiniopCreateRMSNormDescriptor(
-        rsrc.handle, &desc_norm_out, logits_out->slice(0, 0, 1)->desc()->get(),
-        logits_out->slice(0, 0, 1)->desc()->get(),
-        rsrc.w_out_norm->desc()->get(), meta.epsilon));
-    RUN_INFINI(infiniopGetRMSNormWorkspaceSize(desc_norm_out, &temp_size));
-    workspace_size = std::max(workspace_size, temp_size);
-    infiniopMatmulDescriptor_t desc_out_embd;
-    RUN_INFINI(infiniopCreateMatmulDescriptor(
-        rsrc.handle, &desc_out_embd, prob_buf->desc()->get(), 1.0,
-        logits_out->slice(0, 0, nreq)->desc()->get(),
-        rsrc.w_out_embd->desc()->get(), 0.0));
-    RUN_INFINI(infiniopGetMatmulWorkspaceSize(desc_out_embd, &temp_size));
-    workspace_size = std::max(workspace_size, temp_size);
-    infiniopRandomSampleDescriptor_t desc_sample;
-    RUN_INFINI(infiniopCreateRandomSampleDescriptor(
-        rsrc.handle, &desc_sample,
-        TensorDesc::create(INFINI_U64, {1}, {1})->get(),
-        TensorDesc::create(dt_logits, {dvoc}, {1})->get()));
-    RUN_INFINI(infiniopGetRandomSampleWorkspaceSize(desc_sample, &temp_size));
-    workspace_size = std::max(workspace_size, temp_size);
+    infiniopRMSNormDescriptor_t desc_norm_out = nullptr;
+    infiniopMatmulDescriptor_t desc_out_embd = nullptr;
+    infiniopRandomSampleDescriptor_t desc_sample = nullptr;
+    if (last) {
+        RUN_INFINI(infiniopCreateRMSNormDescriptor(
+            handle, &desc_norm_out, logits_out->slice(0, 0, 1)->desc()->get(),
+            logits_out->slice(0, 0, 1)->desc()->get(),
+            rsrc.w_out_norm->desc()->get(), meta.epsilon));
+        RUN_INFINI(infiniopGetRMSNormWorkspaceSize(desc_norm_out, &temp_size));
+        workspace_size = std::max(workspace_size, temp_size);
+        RUN_INFINI(infiniopCreateMatmulDescriptor(
+            handle, &desc_out_embd, logits_shard->desc()->get(), 1.0,
+            logits_out->slice(0, 0, nout)->desc()->get(),
+            rsrc.w_out_embd->desc()->get(), 0.0));
+        RUN_INFINI(infiniopGetMatmulWorkspaceSize(desc_out_embd, &temp_size));
+        workspace_size = std::max(workspace_size, temp_size);
+        // Greedy candidate reduction takes the argmax of each shard row.
+        auto sample_len = reduce_candidates ? shard.len : dvoc;
+        RUN_INFINI(infiniopCreateRandomSampleDescriptor(
+            handle, &desc_sample,
+            TensorDesc::create(INFINI_U64, {1}, {1})->get(),
+            TensorDesc::create(dt_logits, {sample_len}, {1})->get()));
+        RUN_INFINI(
+            infiniopGetRandomSampleWorkspaceSize(desc_sample, &temp_size));
+        workspace_size = std::max(workspace_size, temp_size);
+    }
     // Allocate workspace
-    RUN_INFINI(infinirtMallocAsync(&workspace, device, device_id,
-                                   workspace_size, stream_compute));
+    std::shared_ptr<Storage> workspace_storage;
+    {
+        MemoryScope scope(rsrc.memory, MEMORY_CATEGORY_WORKSPACE);
+        workspace_storage = Storage::createAsync(workspace_size, device,
+                                                 device_id, stream_compute);
+    }
+    auto workspace = workspace_storage->memory;
+    // All-reduce of logits_in that also writes its RMSNorm to logits_out, in
+    // one pass over the activation. Returns false when the backend has no
+    // fused collective and the caller still has to normalize. The fused
+    // collective is exact, so compressed all-reduces skip it.
+    auto all_reduce_norm = [&](std::shared_ptr<Tensor> weight) {
+        if (rsrc.comm_compression != INFINICCL_COMPRESSION_NONE) {
+            all_reduce(0, ntok, stream_compute);
+            return false;
+        }
+        auto status = infinicclAllReduceSumRMSNorm(
+            comm, logits_in->data(stream_compute),
+            logits_in->data(stream_compute), nullptr,
+            logits_out->data(stream_compute), weight->data(stream_compute),
+            ntok, d, meta.epsilon, dt_logits, meta.dt_norm, stream_compute);
+        if (status == INFINICCL_STATUS_DEVICE_NOT_SUPPORTED) {
+            RUN_INFINI(infinicclAllReduceSum(
+                comm, logits_in->data(stream_compute),
+                logits_in->data(stream_compute), ntok * d, dt_logits,
+                stream_compute));
+            return false;
+        }
+        RUN_INFINI(status);
+        return true;
+    };
+    // Whether logits_out already holds the norm the next block needs.
+    bool normed = false;
 
     for (unsigned int layer = 0; layer < nlayer; layer++) {
         // 1. Attention
         // rms norm
-        RUN_INFINI(infiniopRMSNorm(
-            desc_norm, workspace, workspace_size,
-            logits_out->data(stream_compute), logits_in->data(),
-            rsrc.w_attn_norm[layer]->data(stream_compute), stream_compute_raw));
+        if (!normed) {
+            RUN_INFINI(infiniopRMSNorm(
+                desc_norm, workspace, workspace_size,
+                logits_out->data(stream_compute), logits_in->data(),
+                rsrc.w_attn_norm[layer]->data(stream_compute),
+                stream_compute_raw));
+        }
         // qkv_proj
         RUN_INFINI(infiniopMatmul(
             desc_attn_qkv, workspace, workspace_size,
@@ -346,8 +912,24 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
                                 rsrc.cos_table->data(stream_compute),
                                 stream_compute_raw));
 
+        if (varlen) {
+            for (unsigned int req = 0; req < nreq; req++) {
+                k_caches[req] =
+                    kv_caches[req]->k[local][layer]->data(stream_compute);
+                v_caches[req] =
+                    kv_caches[req]->v[local][layer]->data(stream_compute);
+            }
+            varlen_attention(varlen_desc, o_buf->data(stream_compute),
+                             qkv_buf->data(stream_compute),
+                             qkv_buf->data(nh * dh, stream_compute),
+                             qkv_buf->data((nh + nkvh) * dh, stream_compute),
+                             nreq, cu_seqlens.data(), past_lens.data(),
+                             k_caches.data(), v_caches.data(),
+                             std::max(1u, std::thread::hardware_concurrency() /
+                                              nlocal));
+        }
         size_t token_offset = 0;
-        for (unsigned int req = 0; req < nreq; req++) {
+        for (unsigned int req = 0; !varlen && req < nreq; req++) {
             auto past_len = req_pos[req];
             auto seq_len = req_lens[req];
             // self attention
@@ -361,54 +943,138 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
                 qkv_buf->data(token_offset * (nh + nkvh * 2) * dh +
                                   (nh + nkvh) * dh,
                               stream_compute),
-                kv_caches[req]->k[idev][layer]->data(stream_compute),
-                kv_caches[req]->v[idev][layer]->data(stream_compute),
+                kv_caches[req]->k[local][layer]->data(stream_compute),
+                kv_caches[req]->v[local][layer]->data(stream_compute),
                 stream_compute_raw));
 
             token_offset += seq_len;
         }
         // o_proj
-        RUN_INFINI(infiniopMatmul(
-            desc_attn_o, workspace, workspace_size,
-            logits_in->data(stream_compute), o_buf->data(),
-            rsrc.w_attn_out[layer]->data(stream_compute), stream_compute_raw));
+        if (nchunk > 1) {
+            for (unsigned int c = 0; c < nchunk; c++) {
+                auto begin = chunk_begin(c);
+                RUN_INFINI(infiniopMatmul(
+                    desc_attn_o_chunks[c], workspace, workspace_size,
+                    logits_in->data(begin * d, stream_compute),
+                    o_buf->data(begin * nh * dh),
+                    rsrc.w_attn_out[layer]->data(stream_compute),
+                    stream_compute_raw));
+                reduce_chunk(c);
+            }
+            wait_reduced();
+        } else {
+            RUN_INFINI(infiniopMatmul(
+                desc_attn_o, workspace, workspace_size,
+                logits_in->data(stream_compute), o_buf->data(),
+                rsrc.w_attn_out[layer]->data(stream_compute),
+                stream_compute_raw));
+        }
 
         // All_reduce if distributed
-        if (rsrc.comm != nullptr) {
-            RUN_INFINI(infinicclAllReduceSum(
-                rsrc.comm, logits_in->data(stream_compute),
-                logits_in->data(stream_compute), ntok * d, dt_logits,
-                stream_compute));
+        normed = false;
+        if (comm != nullptr && nchunk == 1) {
+            normed = all_reduce_norm(rsrc.w_ffn_norm[layer]);
         }
 
         // 2. FFN
         // rms_norm
-        RUN_INFINI(infiniopRMSNorm(
-            desc_norm, workspace, workspace_size,
-            logits_out->data(stream_compute), logits_in->data(stream_compute),
-            rsrc.w_ffn_norm[layer]->data(stream_compute), stream_compute_raw));
+        if (!normed) {
+            RUN_INFINI(infiniopRMSNorm(
+                desc_norm, workspace, workspace_size,
+                logits_out->data(stream_compute),
+                logits_in->data(stream_compute),
+                rsrc.w_ffn_norm[layer]->data(stream_compute),
+                stream_compute_raw));
+        }
         // mlp
-        RUN_INFINI(infiniopMLP(
-            desc_mlp, workspace, workspace_size,
-            logits_in->data(stream_compute), logits_out->data(stream_compute),
-            rsrc.w_ffn_gate_up[layer]->data(stream_compute),
-            rsrc.w_ffn_down[layer]->data(stream_compute), stream_compute_raw));
+        if (nchunk > 1) {
+            for (unsigned int c = 0; c < nchunk; c++) {
+                auto begin = chunk_begin(c);
+                RUN_INFINI(infiniopMLP(
+                    desc_mlp_chunks[c], workspace, workspace_size,
+                    logits_in->data(begin * d, stream_compute),
+                    logits_out->data(begin * d, stream_compute),
+                    rsrc.w_ffn_gate_up[layer]->data(stream_compute),
+                    rsrc.w_ffn_down[layer]->data(stream_compute),
+                    stream_compute_raw));
+                reduce_chunk(c);
+            }
+            wait_reduced();
+        } else {
+            RUN_INFINI(infiniopMLP(
+                desc_mlp, workspace, workspace_size,
+                logits_in->data(stream_compute),
+                logits_out->data(stream_compute),
+                rsrc.w_ffn_gate_up[layer]->data(stream_compute),
+                rsrc.w_ffn_down[layer]->data(stream_compute),
+                stream_compute_raw));
+        }
 
-        // All_reduce if distributed
-        if (rsrc.comm != nullptr) {
-            RUN_INFINI(infinicclAllReduceSum(
-                rsrc.comm, logits_in->data(stream_compute),
-                logits_in->data(stream_compute), ntok * d, dt_logits,
-                stream_compute));
+        // All_reduce if distributed, fused with the next layer's norm
+        normed = false;
+        if (comm != nullptr && nchunk == 1) {
+            if (layer + 1 < nlayer) {
+                normed = all_reduce_norm(rsrc.w_attn_norm[layer + 1]);
+            } else {
+                all_reduce(0, ntok, stream_compute);
+            }
         }
     }
-    // Sample and Output
-    uint64_t tmp;
-    if (idev == 0) {
-        size_t token_offset = 0;
-        for (unsigned int req = 0; req < nreq; req++) {
+    for (unsigned int req = 0; req < nreq; req++) {
+        RUN_INFINI(infinirtEventRecord(kv_caches[req]->ready[local],
+                                       stream_compute));
+    }
+    if (!last) {
+        RUN_INFINI(infinicclSend(rsrc.comm_pipe,
+                                 logits_in->data(stream_compute), ntok * d,
+                                 dt_logits, rsrc.stage + 1, stream_compute));
+    } else {
+        // The first device of the last stage in this process reports; of the
+        // outputs requested through infer_ex, only tensor-parallel rank 0
+        // holds the full logits.
+        auto reporter = local == nlocal - nlocal / rsrc.nstage;
+        // Processes passing different rows to infer_ex would size the
+        // collectives below differently.
+        if (outputs != nullptr && nlocal < ndev) {
+            auto rows_buf =
+                Tensor::buffer(INFINI_F32, {1}, device, device_id, stream_data);
+            float rows = all_tokens ? 1.f : 0.f;
+            RUN_INFINI(infinirtMemcpyH2DAsync(
+                rows_buf->data(stream_compute), device, device_id, &rows,
+                sizeof(rows), stream_compute));
+            RUN_INFINI(infinicclAllReduceSum(
+                comm, rows_buf->data(stream_compute),
+                rows_buf->data(stream_compute), 1, INFINI_F32, stream_compute));
+            RUN_INFINI(infinirtMemcpyD2HAsync(
+                &rows, rows_buf->data(stream_compute), device, device_id,
+                sizeof(rows), stream_compute));
+            RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+            ASSERT(rows == 0.f || rows == float(ndev));
+        }
+        auto want_logprobs = reporter && outputs != nullptr && idev == 0 &&
+                             outputs->nlogprobs > 0 &&
+                             outputs->logprob_ids != nullptr &&
+                             outputs->logprobs != nullptr;
+        auto logits_cpu = std::vector<char>();
+        void *logits_host = reporter && outputs != nullptr && idev == 0
+                                ? outputs->logits
+                                : nullptr;
+        if (want_logprobs && logits_host == nullptr) {
+            logits_cpu.resize(prob_buf->byte_size());
+            logits_host = logits_cpu.data();
+        }
+        // Output head
+        if (all_tokens) {
+            RUN_INFINI(infiniopRMSNorm(
+                desc_norm, workspace, workspace_size,
+                logits_out->data(stream_compute),
+                logits_in->data(stream_compute),
+                rsrc.w_out_norm->data(stream_compute), stream_compute_raw));
+        }
+        token_offset = 0;
+        for (unsigned int req = 0; !all_tokens && req < nreq; req++) {
             auto seq_len = req_lens[req];
-            token_offset += seq_len;   
+            token_offset += seq_len;
             RUN_INFINI(infiniopRMSNorm(
                 desc_norm_out, workspace, workspace_size,
                 logits_out->data(req * d, stream_compute),
@@ -417,29 +1083,164 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
         }
         RUN_INFINI(infiniopMatmul(
             desc_out_embd, workspace, workspace_size,
-            prob_buf->data(stream_compute), logits_out->data(stream_compute),
+            logits_shard->data(stream_compute),
+            logits_out->data(stream_compute),
             rsrc.w_out_embd->data(stream_compute), stream_compute_raw));
-        std::random_device _rd;
-        std::mt19937 gen(_rd());
-        token_offset = 0;
-        for (unsigned int req = 0; req < nreq; req++) {
-            auto past_len = req_pos[req];
-            auto seq_len = req_lens[req];
-            float random_val = std::uniform_real_distribution<float>(0, 1)(gen);
-            RUN_INFINI(infiniopRandomSample(
-                desc_sample, workspace, workspace_size,
-                result_buf->data(req, stream_compute),
-                prob_buf->data(req * dvoc, stream_compute), random_val, topp,
-                topk, temperature, stream_compute_raw));
-            token_offset += seq_len;
+        if (reduce_candidates) {
+            auto records = std::vector<char>(nout * record_size);
+            if (sample_k == 1) {
+                // The shard's argmax on the device, then only its logit is
+                // read back.
+                for (unsigned int row = 0; row < nout; row++) {
+                    RUN_INFINI(infiniopRandomSample(
+                        desc_sample, workspace, workspace_size,
+                        result_buf->data(row, stream_compute),
+                        logits_shard->data(row * shard.len, stream_compute),
+                        0.f, 1.f, 1, 1.f, stream_compute_raw));
+                }
+                RUN_INFINI(infinirtMemcpyD2HAsync(
+                    result_cpu.data(), result_buf->data(stream_compute),
+                    device, device_id, sizeof(uint64_t) * nout,
+                    stream_compute));
+                RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+                auto values = std::vector<char>(nout * dt_size(dt_logits));
+                for (unsigned int row = 0; row < nout; row++) {
+                    RUN_INFINI(infinirtMemcpyD2HAsync(
+                        values.data() + row * dt_size(dt_logits),
+                        logits_shard->data(row * shard.len + result_cpu[row],
+                                           stream_compute),
+                        device, device_id, dt_size(dt_logits),
+                        stream_compute));
+                }
+                RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+                for (unsigned int row = 0; row < nout; row++) {
+                    float logit =
+                        dt_logits == INFINI_F16
+                            ? f16_to_f32(((uint16_t const *)values.data())[row])
+                            : ((float const *)values.data())[row];
+                    auto header = CandidateHeader{logit, 1.f};
+                    auto top = SampleCandidate{
+                        logit, uint32_t(shard.begin + result_cpu[row])};
+                    auto record = records.data() + row * record_size;
+                    std::memcpy(record, &header, sizeof(header));
+                    std::memcpy(record + sizeof(header), &top, sizeof(top));
+                }
+            } else {
+                auto shard_cpu = std::vector<char>(logits_shard->byte_size());
+                RUN_INFINI(infinirtMemcpyD2HAsync(
+                    shard_cpu.data(), logits_shard->data(stream_compute),
+                    device, device_id, shard_cpu.size(), stream_compute));
+                RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+                shard_candidates(
+                    dt_logits, shard_cpu.data(), nout, shard.len, shard.begin,
+                    sample_k, temperature, records.data(),
+                    std::max(1u, std::thread::hardware_concurrency() / nlocal));
+            }
+            RUN_INFINI(infinirtMemcpyH2DAsync(
+                records_send->data(stream_compute), device, device_id,
+                records.data(), records.size(), stream_compute));
+            RUN_INFINI(infinicclAllGather(
+                comm, records_send->data(stream_compute),
+                records_recv->data(stream_compute), nout * record_words,
+                INFINI_U64, stream_compute));
+            if (idev == 0) {
+                auto gathered = std::vector<char>(ndev * records.size());
+                RUN_INFINI(infinirtMemcpyD2HAsync(
+                    gathered.data(), records_recv->data(stream_compute),
+                    device, device_id, gathered.size(), stream_compute));
+                RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+                std::random_device _rd;
+                std::mt19937 gen(_rd());
+                auto random_vals = std::vector<float>(nout);
+                for (auto &r : random_vals) {
+                    r = std::uniform_real_distribution<float>(0, 1)(gen);
+                }
+                sample_candidates(gathered.data(), ndev, nout, sample_k,
+                                  temperature, topp, random_vals.data(),
+                                  result_cpu.data());
+                RUN_INFINI(infinirtMemcpyH2DAsync(
+                    result_buf->data(stream_compute), device, device_id,
+                    result_cpu.data(), sizeof(uint64_t) * nout,
+                    stream_compute));
+            }
+            // The host buffers above are read by the pending copies.
+            RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+        } else if (idev != 0) {
+            RUN_INFINI(infinicclSend(comm, logits_shard->data(stream_compute),
+                                     nout * shard.len, dt_logits, 0,
+                                     stream_compute));
+        } else {
+            // Gather the shards row by row. Rank 0 holds the largest shard,
+            // so logits_shard also fits every peer's.
+            for (unsigned int r = 0; ndev > 1 && r < ndev; r++) {
+                auto peer = vocab_shard(dvoc, r, ndev);
+                if (r > 0) {
+                    RUN_INFINI(infinicclRecv(
+                        comm, logits_shard->data(stream_compute),
+                        nout * peer.len, dt_logits, r, stream_compute));
+                }
+                for (unsigned int row = 0; row < nout; row++) {
+                    RUN_INFINI(infinirtMemcpyAsync(
+                        prob_buf->data(row * dvoc + peer.begin, stream_compute),
+                        logits_shard->data(row * peer.len, stream_compute),
+                        device, device_id, dt_size(dt_logits) * peer.len,
+                        stream_compute));
+                }
+            }
+            if (runs_on_host(device)) {
+                RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+            }
+            // Copied ahead of sampling, which may reuse prob_buf. Host
+            // devices sample on this thread while the copy waits on the
+            // stream worker, so let it finish first.
+            if (logits_host != nullptr) {
+                RUN_INFINI(infinirtMemcpyD2HAsync(
+                    logits_host, prob_buf->data(stream_compute), device,
+                    device_id, prob_buf->byte_size(), stream_compute));
+                if (runs_on_host(device)) {
+                    RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+                }
+            }
+            std::random_device _rd;
+            std::mt19937 gen(_rd());
+            for (unsigned int row = 0; row < nout; row++) {
+                float random_val =
+                    std::uniform_real_distribution<float>(0, 1)(gen);
+                RUN_INFINI(infiniopRandomSample(
+                    desc_sample, workspace, workspace_size,
+                    result_buf->data(row, stream_compute),
+                    prob_buf->data(row * dvoc, stream_compute), random_val,
+                    topp, topk, temperature, stream_compute_raw));
+            }
         }
-        RUN_INFINI(infinirtStreamSynchronize(stream_compute));
-        RUN_INFINI(infinirtMemcpyD2H(&tmp, result_buf->data(stream_data),
-                          device, device_id, sizeof(uint64_t) * nreq));
-        for (unsigned int req = 0; req < nreq; req++) {
-            // ans[req] = (unsigned int)result_cpu[req];
-            ans[req] = (unsigned int)tmp;
-
+        // Every process needs the sampled tokens to feed the next step.
+        if (nlocal < ndev) {
+            RUN_INFINI(infinicclBroadcast(
+                comm, result_buf->data(stream_compute),
+                result_buf->data(stream_compute), nout, INFINI_U64, 0,
+                stream_compute));
+        }
+        if (reporter) {
+            // A synchronous copy would also wait for the other lane.
+            RUN_INFINI(infinirtMemcpyD2HAsync(
+                result_cpu.data(), result_buf->data(stream_compute), device,
+                device_id, sizeof(uint64_t) * nout, stream_compute));
+            if (outputs != nullptr && outputs->hidden != nullptr) {
+                RUN_INFINI(infinirtMemcpyD2HAsync(
+                    outputs->hidden, logits_out->data(stream_compute), device,
+                    device_id, dt_size(dt_logits) * nout * d,
+                    stream_compute));
+            }
+            RUN_INFINI(infinirtStreamSynchronize(stream_compute));
+            for (unsigned int row = 0; row < nout; row++) {
+                ans[row] = (unsigned int)result_cpu[row];
+            }
+            if (want_logprobs) {
+                top_logprobs(
+                    dt_logits, logits_host, nout, dvoc, outputs->nlogprobs,
+                    outputs->logprob_ids, outputs->logprobs,
+                    std::max(1u, std::thread::hardware_concurrency() / nlocal));
+            }
         }
     }
 
@@ -450,13 +1251,192 @@ void infer_device(LlamaMeta const &meta, DeviceResource const &rsrc,
     infiniopDestroyRoPEDescriptor(desc_rope_q);
     infiniopDestroyRoPEDescriptor(desc_rope_k);
     infiniopDestroyMLPDescriptor(desc_mlp);
-    for (unsigned int req = 0; req < nreq; req++) {
+    for (unsigned int c = 0; c < desc_attn_o_chunks.size(); c++) {
+        infiniopDestroyMatmulDescriptor(desc_attn_o_chunks[c]);
+        infiniopDestroyMLPDescriptor(desc_mlp_chunks[c]);
+        infinirtEventDestroy(chunk_events[c]);
+    }
+    if (reduced != nullptr) {
+        infinirtEventDestroy(reduced);
+    }
+    for (unsigned int req = 0; !varlen && req < nreq; req++) {
         infiniopDestroyAttentionDescriptor(desc_attns[req]);
     }
-    infiniopDestroyRMSNormDescriptor(desc_norm_out);
-    infiniopDestroyMatmulDescriptor(desc_out_embd);
-    infiniopDestroyRandomSampleDescriptor(desc_sample);
-    infinirtFree(workspace, device, device_id);
+    if (last) {
+        infiniopDestroyRMSNormDescriptor(desc_norm_out);
+        infiniopDestroyMatmulDescriptor(desc_out_embd);
+        infiniopDestroyRandomSampleDescriptor(desc_sample);
+    }
+    // The buffers are released on stream_data, behind this step's work.
+    infinirtEvent_t done;
+    RUN_INFINI(infinirtEventCreate(&done, device, device_id));
+    RUN_INFINI(infinirtEventRecord(done, stream_compute));
+    RUN_INFINI(infinirtStreamWaitEvent(done, stream_data));
+    RUN_INFINI(infinirtEventDestroy(done));
+}
+
+struct MicroBatch {
+    unsigned int req_begin, nreq, tok_begin, ntok;
+};
+
+// Splits a batch into at most n runs of whole requests with similar token
+// counts, so pipeline stages get work of similar length.
+std::vector<MicroBatch> micro_batches(unsigned int nreq,
+                                      unsigned int const *req_lens,
+                                      unsigned int n) {
+    n = std::max(1u, std::min(n, nreq));
+    size_t total = 0;
+    for (unsigned int req = 0; req < nreq; req++) {
+        total += req_lens[req];
+    }
+    auto batches = std::vector<MicroBatch>();
+    unsigned int req = 0, tok = 0;
+    for (unsigned int m = 0; m < n; m++) {
+        auto mb = MicroBatch{req, 0, tok, 0};
+        auto target = total * (m + 1) / n;
+        // Leave at least one request for every later micro-batch.
+        while (req < nreq - (n - 1 - m) && (mb.nreq == 0 || tok < target)) {
+            mb.nreq++;
+            mb.ntok += req_lens[req];
+            tok += req_lens[req++];
+        }
+        batches.push_back(mb);
+    }
+    return batches;
+}
+
+// Caller buffers of infer_ex advanced to output row `row`.
+InferOutputs offset_outputs(InferOutputs const &outputs,
+                            LlamaMeta const &meta, size_t row) {
+    auto shifted = outputs;
+    auto row_bytes = dt_size(meta.dt_logits);
+    if (shifted.logits != nullptr) {
+        shifted.logits = (char *)shifted.logits + row * meta.dvoc * row_bytes;
+    }
+    if (shifted.hidden != nullptr) {
+        shifted.hidden = (char *)shifted.hidden + row * meta.d * row_bytes;
+    }
+    if (shifted.logprob_ids != nullptr) {
+        shifted.logprob_ids += row * shifted.nlogprobs;
+    }
+    if (shifted.logprobs != nullptr) {
+        shifted.logprobs += row * shifted.nlogprobs;
+    }
+    return shifted;
+}
+
+// One forward pass of the whole batch on every device of the model. With
+// all_tokens, ans and outputs hold a row after every token rather than per
+// request.
+void infer_step(struct Model const *model, unsigned int const *tokens,
+                unsigned int nreq, unsigned int const *req_lens,
+                unsigned int const *req_pos, struct KVCache **kv_caches,
+                unsigned int *ans, float temperature, unsigned int topk,
+                float topp, bool all_tokens = false,
+                InferOutputs const *outputs = nullptr) {
+    unsigned int nlocal = model->dev.size();
+    // Devices of one stage in this process.
+    unsigned int nstage_dev = nlocal / model->nstage;
+    auto batches = micro_batches(nreq, req_lens, model->nstage);
+    auto mb_outputs = std::vector<InferOutputs>();
+    for (auto const &mb : batches) {
+        if (outputs != nullptr) {
+            auto row = all_tokens ? mb.tok_begin : mb.req_begin;
+            mb_outputs.push_back(offset_outputs(*outputs, model->meta, row));
+        }
+    }
+    auto threads = std::vector<std::thread>(nlocal);
+    for (unsigned int local = 0; local < nlocal; local++) {
+        threads[local] = std::thread([=, &batches, &mb_outputs] {
+            // Stage s runs micro-batch m while stage s + 1 runs m - 1.
+            for (size_t m = 0; m < batches.size(); m++) {
+                auto const &mb = batches[m];
+                infer_device(model->meta, model->dev[local],
+                             model->rank + local % nstage_dev, model->nrank,
+                             local, nlocal, mb.ntok, tokens + mb.tok_begin,
+                             mb.nreq, req_lens + mb.req_begin,
+                             req_pos + mb.req_begin, kv_caches + mb.req_begin,
+                             ans + (all_tokens ? mb.tok_begin : mb.req_begin),
+                             temperature, topk, topp, all_tokens,
+                             outputs != nullptr ? &mb_outputs[m] : nullptr);
+            }
+        });
+    }
+    for (unsigned int local = 0; local < nlocal; local++) {
+        threads[local].join();
+    }
+}
+
+// Requests of one forward pass under a token budget; req indexes the
+// caller's batch.
+struct PrefillStep {
+    std::vector<unsigned int> req, tokens, lens, pos;
+    std::vector<KVCache *> caches;
+};
+
+// Next forward pass of at most max_tokens tokens, taking each request from
+// done[req] on and advancing done. Decode requests go first so they never
+// wait behind a long prompt; prompts then fill the rest of the budget in
+// order.
+PrefillStep next_prefill_step(unsigned int const *tokens, unsigned int nreq,
+                              unsigned int const *req_lens,
+                              unsigned int const *req_pos,
+                              struct KVCache **kv_caches,
+                              std::vector<size_t> const &offsets,
+                              std::vector<unsigned int> &done,
+                              unsigned int max_tokens) {
+    PrefillStep step;
+    auto budget = max_tokens;
+    auto take = [&](unsigned int req, unsigned int len) {
+        auto begin = tokens + offsets[req] + done[req];
+        step.req.push_back(req);
+        step.tokens.insert(step.tokens.end(), begin, begin + len);
+        step.lens.push_back(len);
+        step.pos.push_back(req_pos[req] + done[req]);
+        step.caches.push_back(kv_caches[req]);
+        done[req] += len;
+        budget -= len;
+    };
+    for (unsigned int req = 0; req < nreq && budget > 0; req++) {
+        if (req_lens[req] == 1 && done[req] == 0) {
+            take(req, 1);
+        }
+    }
+    for (unsigned int req = 0; req < nreq && budget > 0; req++) {
+        if (done[req] < req_lens[req]) {
+            take(req, std::min(budget, req_lens[req] - done[req]));
+        }
+    }
+    return step;
+}
+
+// Runs one pass and reports the answers of requests it finished.
+void run_prefill_step(struct Model const *model, PrefillStep &step,
+                      unsigned int const *req_lens,
+                      unsigned int const *req_pos, unsigned int *ans,
+                      float temperature, unsigned int topk, float topp) {
+    auto step_ans = std::vector<unsigned int>(step.req.size());
+    infer_step(model, step.tokens.data(), step.req.size(), step.lens.data(),
+               step.pos.data(), step.caches.data(), step_ans.data(),
+               temperature, topk, topp);
+    // A request's answer is the one sampled after its last token.
+    for (unsigned int i = 0; i < step.req.size(); i++) {
+        auto req = step.req[i];
+        if (step.pos[i] + step.lens[i] == req_pos[req] + req_lens[req]) {
+            ans[req] = step_ans[i];
+        }
+    }
+}
+
+std::vector<size_t> request_offsets(unsigned int nreq,
+                                    unsigned int const *req_lens) {
+    auto offsets = std::vector<size_t>(nreq);
+    size_t offset = 0;
+    for (unsigned int req = 0; req < nreq; req++) {
+        offsets[req] = offset;
+        offset += req_lens[req];
+    }
+    return offsets;
 }
 
 __C void infer(struct Model const *model, unsigned int ntok,
@@ -464,27 +1444,165 @@ __C void infer(struct Model const *model, unsigned int ntok,
                unsigned int const *req_lens, unsigned int const *req_pos,
                struct KVCache **kv_caches, unsigned int *ans, float temperature,
                unsigned int topk, float topp) {
-    auto ndev = model->dev.size();
-    auto threads = std::vector<std::thread>(ndev);
-    for (unsigned int idev = 0; idev < ndev; idev++) {
-        threads[idev] =
-            std::thread(infer_device, model->meta, model->dev[idev], idev, ndev,
-                        ntok, tokens, nreq, req_lens, req_pos, kv_caches, ans,
-                        temperature, topk, topp);
+    auto max_tokens = model->prefill_chunk;
+    if (max_tokens == 0 || ntok <= max_tokens) {
+        infer_step(model, tokens, nreq, req_lens, req_pos, kv_caches, ans,
+                   temperature, topk, topp);
+        return;
     }
-    for (unsigned int idev = 0; idev < ndev; idev++) {
-        threads[idev].join();
+    auto offsets = request_offsets(nreq, req_lens);
+    auto done = std::vector<unsigned int>(nreq, 0);
+    for (size_t remaining = ntok; remaining > 0;) {
+        auto step = next_prefill_step(tokens, nreq, req_lens, req_pos,
+                                      kv_caches, offsets, done, max_tokens);
+        remaining -= step.tokens.size();
+        run_prefill_step(model, step, req_lens, req_pos, ans, temperature,
+                         topk, topp);
     }
 }
 
+__C void infer_pass(struct Model const *model, unsigned int ntok,
+                    unsigned int const *tokens, unsigned int nreq,
+                    unsigned int const *req_lens, unsigned int const *req_pos,
+                    struct KVCache **kv_caches, unsigned int *ans,
+                    unsigned int *req_done, float temperature,
+                    unsigned int topk, float topp) {
+    auto max_tokens = model->prefill_chunk;
+    if (max_tokens == 0 || ntok <= max_tokens) {
+        infer_step(model, tokens, nreq, req_lens, req_pos, kv_caches, ans,
+                   temperature, topk, topp);
+        std::copy(req_lens, req_lens + nreq, req_done);
+        return;
+    }
+    auto done = std::vector<unsigned int>(nreq, 0);
+    auto step = next_prefill_step(tokens, nreq, req_lens, req_pos, kv_caches,
+                                  request_offsets(nreq, req_lens), done,
+                                  max_tokens);
+    run_prefill_step(model, step, req_lens, req_pos, ans, temperature, topk,
+                     topp);
+    std::copy(done.begin(), done.end(), req_done);
+}
+
+__C void infer_ex(struct Model const *model, unsigned int ntok,
+                  unsigned int const *tokens, unsigned int nreq,
+                  unsigned int const *req_lens, unsigned int const *req_pos,
+                  struct KVCache **kv_caches, InferOutputs const *outputs,
+                  unsigned int *ans, float temperature, unsigned int topk,
+                  float topp) {
+    // Without outputs this process still takes the same path as the ranks
+    // that asked for some.
+    auto none = InferOutputs{INFER_OUTPUT_LAST, nullptr, 0, nullptr, nullptr,
+                             nullptr};
+    if (outputs == nullptr) {
+        outputs = &none;
+    }
+    if (outputs->rows == INFER_OUTPUT_LAST) {
+        infer_step(model, tokens, nreq, req_lens, req_pos, kv_caches, ans,
+                   temperature, topk, topp, false, outputs);
+        return;
+    }
+    // ans still holds one sample per request: the one after its last token.
+    auto samples = std::vector<unsigned int>(ntok);
+    infer_step(model, tokens, nreq, req_lens, req_pos, kv_caches,
+               samples.data(), temperature, topk, topp, true, outputs);
+    size_t end = 0;
+    for (unsigned int req = 0; req < nreq; req++) {
+        end += req_lens[req];
+        ans[req] = samples[end - 1];
+    }
+}
+
+__C void infer_speculative(struct Model *model, struct Model const *draft,
+                           unsigned int nreq, unsigned int const *tokens,
+                           unsigned int const *req_pos,
+                           struct KVCache **kv_caches,
+                           struct KVCache **draft_kv_caches, unsigned int k,
+                           unsigned int *ans, unsigned int *ans_lens,
+                           float temperature, unsigned int topk, float topp) {
+    ASSERT_EQ(model->meta.dvoc, draft->meta.dvoc);
+    ASSERT(k > 0);
+    // The draft proposes k tokens per request, one decode step at a time.
+    auto proposals = std::vector<unsigned int>(nreq * k);
+    auto ones = std::vector<unsigned int>(nreq, 1);
+    auto step_tokens = std::vector<unsigned int>(tokens, tokens + nreq);
+    auto step_pos = std::vector<unsigned int>(req_pos, req_pos + nreq);
+    auto step_ans = std::vector<unsigned int>(nreq);
+    for (unsigned int i = 0; i < k; i++) {
+        infer_step(draft, step_tokens.data(), nreq, ones.data(),
+                   step_pos.data(), draft_kv_caches, step_ans.data(),
+                   temperature, topk, topp);
+        for (unsigned int req = 0; req < nreq; req++) {
+            proposals[req * k + i] = step_tokens[req] = step_ans[req];
+            step_pos[req]++;
+        }
+    }
+    // The target samples after the last token and after every proposal in
+    // one pass. Each of its samples is drawn from the target given the
+    // tokens before it, so keeping them up to the first disagreement
+    // leaves the output distribution that of the target alone.
+    auto verify_tokens = std::vector<unsigned int>(nreq * (k + 1));
+    auto verify_lens = std::vector<unsigned int>(nreq, k + 1);
+    auto samples = std::vector<unsigned int>(nreq * (k + 1));
+    for (unsigned int req = 0; req < nreq; req++) {
+        verify_tokens[req * (k + 1)] = tokens[req];
+        std::copy_n(&proposals[req * k], k, &verify_tokens[req * (k + 1) + 1]);
+    }
+    infer_step(model, verify_tokens.data(), nreq, verify_lens.data(), req_pos,
+               kv_caches, samples.data(), temperature, topk, topp, true);
+    // Requests that accepted every proposal still need the last one in the
+    // draft cache, which only holds the tokens it was fed.
+    auto catch_up = std::vector<unsigned int>(), catch_up_pos = catch_up;
+    auto catch_up_caches = std::vector<KVCache *>();
+    uint64_t accepted = 0;
+    for (unsigned int req = 0; req < nreq; req++) {
+        unsigned int n = 0;
+        while (n < k && proposals[req * k + n] == samples[req * (k + 1) + n]) {
+            n++;
+        }
+        std::copy_n(&samples[req * (k + 1)], n + 1, &ans[req * (k + 1)]);
+        ans_lens[req] = n + 1;
+        accepted += n;
+        if (n == k) {
+            catch_up.push_back(proposals[req * k + k - 1]);
+            catch_up_pos.push_back(req_pos[req] + k);
+            catch_up_caches.push_back(draft_kv_caches[req]);
+        }
+    }
+    if (!catch_up.empty()) {
+        auto discard = std::vector<unsigned int>(catch_up.size());
+        infer_step(draft, catch_up.data(), catch_up.size(), ones.data(),
+                   catch_up_pos.data(), catch_up_caches.data(), discard.data(),
+                   temperature, topk, topp);
+    }
+    model->spec_rounds += nreq;
+    model->spec_proposed += nreq * k;
+    model->spec_accepted += accepted;
+}
+
+__C void get_speculative_stats(struct Model const *model,
+                               SpeculativeStats *stats) {
+    stats->rounds = model->spec_rounds;
+    stats->proposed = model->spec_proposed;
+    stats->accepted = model->spec_accepted;
+}
+
+__C void get_memory_stats(struct Model const *model, unsigned int idev,
+                          MemoryStats *stats) {
+    ASSERT(idev < model->dev.size());
+    *stats = model->dev[idev].memory->stats();
+}
+
 __C void destroy_model(struct Model *model) {
     auto ndev = model->dev.size();
+    set_infer_mode(model, INFER_MODE_DEFAULT);
+    set_comm_overlap(model, 1);
     for (unsigned int i = 0; i < ndev; i++) {
         infiniopDestroyHandle(model->dev[i].handle);
         infinirtStreamDestroy(model->dev[i].stream_compute);
         infinirtStreamDestroy(model->dev[i].stream_data);
         infinirtStreamDestroy(model->dev[i].stream_cache);
         infinicclCommDestroy(model->dev[i].comm);
+        infinicclCommDestroy(model->dev[i].comm_pipe);
     }
     delete model;
 }
@@ -21,14 +21,40 @@ inline std::shared_ptr<Tensor> get_out_norm(
                           device_id);
 }
 
+struct VocabShard {
+    size_t begin, len;
+};
+
+// Rows of the output embedding held by device `idev`. Every shard but the
+// last has ceil(dvoc / ndev) rows, so rank 0 always holds the largest one.
+inline VocabShard vocab_shard(size_t dvoc, size_t idev, size_t ndev) {
+    size_t shard = (dvoc + ndev - 1) / ndev;
+    size_t begin = std::min(dvoc, idev * shard);
+    return {begin, std::min(dvoc, begin + shard) - begin};
+}
+
+struct LayerRange {
+    size_t begin, len;
+};
+
+// Layers held by pipeline stage `stage`. Earlier stages get the smaller
+// share, since the last one also runs the output head.
+inline LayerRange stage_layers(size_t nlayer, size_t stage, size_t nstage) {
+    size_t begin = nlayer * stage / nstage;
+    return {begin, nlayer * (stage + 1) / nstage - begin};
+}
+
 inline std::shared_ptr<Tensor> get_out_embd(
     LlamaMeta const *meta,
     LlamaWeights const *w,
+    size_t idev, size_t ndev,
     DeviceType device, unsigned int device_id)
 {
-    auto shape = std::vector<index_t>({meta->dvoc, meta->d});
-    return Tensor::weight((char *)w->output_embd, meta->dt_logits, shape,
-                          device, device_id)
+    auto shard = vocab_shard(meta->dvoc, idev, ndev);
+    size_t offset = shard.begin * meta->d * dt_size(meta->dt_logits);
+    auto shape = std::vector<index_t>({shard.len, meta->d});
+    return Tensor::weight((char *)w->output_embd + offset, meta->dt_logits,
+                          shape, device, device_id)
         ->permute({1, 0});
 }
 
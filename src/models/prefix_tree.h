@@ -0,0 +1,191 @@
+#ifndef INFER_MODELS_PREFIX_TREE_H
+#define INFER_MODELS_PREFIX_TREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Radix tree over token sequences for cross-request prefix caching. Each
+// edge holds a run of tokens and the Block storing their positions; a split
+// leaves both halves as windows into the same block. Blocks are counted
+// against a capacity in tokens, and least recently used leaves are evicted
+// to stay within it. Not thread-safe.
+template <typename Block>
+class PrefixTree {
+  public:
+    // Positions [pos, pos + len) of a cached prefix, stored in block from
+    // offset on. Valid until the next insert.
+    struct Span {
+        Block const *block;
+        size_t offset, pos, len;
+    };
+
+    explicit PrefixTree(size_t capacity) : _capacity(capacity) {}
+
+    // Longest cached prefix of tokens, in position order. Marks it used.
+    std::vector<Span> match(unsigned int const *tokens, size_t ntok) {
+        auto spans = std::vector<Span>();
+        auto node = &_root;
+        size_t pos = 0;
+        _clock++;
+        while (pos < ntok) {
+            auto it = node->children.find(tokens[pos]);
+            if (it == node->children.end()) {
+                break;
+            }
+            auto child = it->second.get();
+            auto common = common_length(child, tokens + pos, ntok - pos);
+            child->last_used = _clock;
+            spans.push_back(
+                Span{&child->block->block, child->offset, pos, common});
+            pos += common;
+            if (common < child->tokens.size()) {
+                break;
+            }
+            node = child;
+        }
+        return spans;
+    }
+
+    // Caches tokens. Positions not cached yet are taken from
+    // make(pos, len), which returns a Block holding [pos, pos + len). Only
+    // as many new tokens as fit in the capacity next to the cached prefix
+    // they extend are taken, so an oversized sequence is truncated instead
+    // of evicting everything, itself included. Returns the number of newly
+    // cached tokens.
+    template <typename F>
+    size_t insert(unsigned int const *tokens, size_t ntok, F make) {
+        auto node = &_root;
+        size_t pos = 0;
+        _clock++;
+        while (pos < ntok) {
+            auto it = node->children.find(tokens[pos]);
+            if (it == node->children.end()) {
+                break;
+            }
+            auto child = it->second.get();
+            auto common = common_length(child, tokens + pos, ntok - pos);
+            if (common < child->tokens.size()) {
+                child = split(node, child, common);
+            }
+            child->last_used = _clock;
+            pos += common;
+            node = child;
+        }
+        // The prefix stays resident while the new leaf hangs below it.
+        size_t pinned = 0;
+        auto seen = std::vector<Shared const *>();
+        for (auto n = node; n != &_root; n = n->parent) {
+            if (std::find(seen.begin(), seen.end(), n->block.get()) ==
+                seen.end()) {
+                seen.push_back(n->block.get());
+                pinned += n->block->len;
+            }
+        }
+        size_t added =
+            std::min(ntok - pos, _capacity > pinned ? _capacity - pinned : 0);
+        if (added > 0) {
+            auto leaf = std::make_unique<Node>();
+            leaf->tokens.assign(tokens + pos, tokens + pos + added);
+            leaf->block =
+                std::make_shared<Shared>(Shared{make(pos, added), added});
+            leaf->offset = 0;
+            leaf->parent = node;
+            leaf->last_used = _clock;
+            node->children[tokens[pos]] = std::move(leaf);
+            _resident += added;
+        }
+        evict(_capacity);
+        return added;
+    }
+
+    // Evicts least recently used leaves until at most capacity tokens are
+    // resident.
+    void evict(size_t capacity) {
+        while (_resident > capacity) {
+            auto leaf = lru_leaf(&_root);
+            if (leaf == nullptr) {
+                break;
+            }
+            if (leaf->block.use_count() == 1) {
+                _resident -= leaf->block->len;
+                _evicted += leaf->block->len;
+            }
+            leaf->parent->children.erase(leaf->tokens[0]);
+        }
+    }
+
+    // Tokens held by live blocks, including parts whose nodes are evicted
+    // while another window into the block remains.
+    size_t resident() const { return _resident; }
+    // Tokens freed by eviction so far.
+    size_t evicted() const { return _evicted; }
+
+  private:
+    struct Shared {
+        Block block;
+        size_t len;
+    };
+
+    struct Node {
+        std::vector<unsigned int> tokens;
+        std::shared_ptr<Shared> block;
+        size_t offset = 0;
+        Node *parent = nullptr;
+        // Keyed by the first token of the child's edge.
+        std::map<unsigned int, std::unique_ptr<Node>> children;
+        uint64_t last_used = 0;
+    };
+
+    static size_t common_length(Node const *node, unsigned int const *tokens,
+                                size_t ntok) {
+        size_t n = 0;
+        while (n < node->tokens.size() && n < ntok &&
+               node->tokens[n] == tokens[n]) {
+            n++;
+        }
+        return n;
+    }
+
+    // Splits child's edge after len tokens and returns the new upper node.
+    Node *split(Node *parent, Node *child, size_t len) {
+        auto upper = std::make_unique<Node>();
+        upper->tokens.assign(child->tokens.begin(),
+                             child->tokens.begin() + len);
+        upper->block = child->block;
+        upper->offset = child->offset;
+        upper->parent = parent;
+        upper->last_used = child->last_used;
+        child->tokens.erase(child->tokens.begin(), child->tokens.begin() + len);
+        child->offset += len;
+        child->parent = upper.get();
+        auto first = upper->tokens[0];
+        auto owned = std::move(parent->children[first]);
+        upper->children[child->tokens[0]] = std::move(owned);
+        auto result = upper.get();
+        parent->children[first] = std::move(upper);
+        return result;
+    }
+
+    Node *lru_leaf(Node *node) {
+        Node *best = nullptr;
+        for (auto &entry : node->children) {
+            auto child = entry.second.get();
+            auto leaf = child->children.empty() ? child : lru_leaf(child);
+            if (leaf != nullptr &&
+                (best == nullptr || leaf->last_used < best->last_used)) {
+                best = leaf;
+            }
+        }
+        return best;
+    }
+
+    Node _root;
+    size_t _capacity;
+    size_t _resident = 0, _evicted = 0;
+    uint64_t _clock = 0;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "sample_candidates.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+// Descending by logit; the lower id wins ties so every shard split of the
+// vocabulary picks the same token.
+bool before(SampleCandidate const &a, SampleCandidate const &b) {
+    return a.logit > b.logit || (a.logit == b.logit && a.id < b.id);
+}
+
+char *record_at(void *records, unsigned int k, size_t index) {
+    return static_cast<char *>(records) + index * candidate_record_size(k);
+}
+
+char const *record_at(void const *records, unsigned int k, size_t index) {
+    return static_cast<char const *>(records) +
+           index * candidate_record_size(k);
+}
+} // namespace
+
+void shard_candidates(InfiniDataType_t dtype, void const *logits, size_t nrow,
+                      size_t len, size_t begin, unsigned int k,
+                      float temperature, void *records, size_t max_threads) {
+    ASSERT(dtype == INFINI_F16 || dtype == INFINI_F32);
+    parallel_for(nrow, max_threads, [&](size_t row_begin, size_t row_end) {
+        auto row = std::vector<SampleCandidate>(len);
+        for (size_t r = row_begin; r < row_end; r++) {
+            for (size_t i = 0; i < len; i++) {
+                auto x = dtype == INFINI_F16
+                             ? f16_to_f32(static_cast<uint16_t const *>(
+                                   logits)[r * len + i])
+                             : static_cast<float const *>(logits)[r * len + i];
+                row[i] = SampleCandidate{x, uint32_t(begin + i)};
+            }
+            auto header = CandidateHeader{-INFINITY, 0.f};
+            if (len > 0) {
+                auto n = std::min<size_t>(k, len);
+                std::nth_element(row.begin(), row.begin() + (n - 1), row.end(),
+                                 before);
+                std::sort(row.begin(), row.begin() + n, before);
+                header.max = row[0].logit;
+                header.sum = 1.f;
+                if (temperature > 0) {
+                    double sum = 0;
+                    for (auto const &c : row) {
+                        sum += std::exp(double(c.logit - header.max) /
+                                        temperature);
+                    }
+                    header.sum = float(sum);
+                }
+            }
+            auto record = record_at(records, k, r);
+            std::memcpy(record, &header, sizeof(header));
+            auto top = reinterpret_cast<SampleCandidate *>(record +
+                                                           sizeof(header));
+            for (unsigned int i = 0; i < k; i++) {
+                top[i] = i < len ? row[i] : SampleCandidate{-INFINITY, 0};
+            }
+        }
+    });
+}
+
+void sample_candidates(void const *records, size_t nshard, size_t nrow,
+                       unsigned int k, float temperature, float topp,
+                       float const *random_vals, uint64_t *result) {
+    auto merged = std::vector<SampleCandidate>();
+    for (size_t r = 0; r < nrow; r++) {
+        merged.clear();
+        float max = -INFINITY;
+        auto headers = std::vector<CandidateHeader>(nshard);
+        for (size_t s = 0; s < nshard; s++) {
+            auto record = record_at(records, k, s * nrow + r);
+            std::memcpy(&headers[s], record, sizeof(CandidateHeader));
+            max = std::max(max, headers[s].max);
+            auto top = reinterpret_cast<SampleCandidate const *>(
+                record + sizeof(CandidateHeader));
+            for (unsigned int i = 0; i < k; i++) {
+                if (top[i].logit != -INFINITY) {
+                    merged.push_back(top[i]);
+                }
+            }
+        }
+        ASSERT(!merged.empty());
+        auto n = std::min<size_t>(k, merged.size());
+        std::partial_sort(merged.begin(), merged.begin() + n, merged.end(),
+                          before);
+        if (temperature <= 0 || n == 1) {
+            result[r] = merged[0].id;
+            continue;
+        }
+        // Softmax denominator over the whole vocabulary, rebased to the
+        // global max.
+        double total = 0;
+        for (auto const &h : headers) {
+            if (h.sum > 0) {
+                total += h.sum * std::exp(double(h.max - max) / temperature);
+            }
+        }
+        auto cumulative = std::vector<double>(n);
+        double acc = 0;
+        for (size_t i = 0; i < n; i++) {
+            acc +=
+                std::exp(double(merged[i].logit - max) / temperature) / total;
+            cumulative[i] = acc;
+        }
+        auto threshold = random_vals[r] * std::min<double>(topp, acc);
+        size_t pick = 0;
+        while (pick + 1 < n && cumulative[pick] < threshold) {
+            pick++;
+        }
+        result[r] = merged[pick].id;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef INFER_OPS_SAMPLE_CANDIDATES_H
+#define INFER_OPS_SAMPLE_CANDIDATES_H
+
+#include "../tensor.h"
+
+// Top-k sampling over a vocabulary split into shards, without gathering the
+// logits. Each shard reduces every output row to a fixed-size record: the
+// softmax statistics of its slice and its k largest logits. Records of all
+// shards, exchanged in rank order, hold everything a top-k / top-p draw over
+// the whole vocabulary needs.
+struct CandidateHeader {
+    // Largest logit of the shard, and the sum of exp((x - max) / temperature)
+    // over it; -inf and 0 for an empty shard.
+    float max, sum;
+};
+
+struct SampleCandidate {
+    float logit;
+    uint32_t id; // Vocabulary id; slots past a short shard hold -inf logits
+};
+
+// Bytes of one row's record: a header followed by k candidates.
+inline size_t candidate_record_size(unsigned int k) {
+    return sizeof(CandidateHeader) + k * sizeof(SampleCandidate);
+}
+
+// Records of nrow rows of shard logits ([nrow, len], F16 or F32), whose
+// first column is vocabulary id `begin`. Rows are split across up to
+// max_threads threads. temperature <= 0 leaves the sums at 1.
+void shard_candidates(InfiniDataType_t dtype, void const *logits, size_t nrow,
+                      size_t len, size_t begin, unsigned int k,
+                      float temperature, void *records, size_t max_threads);
+
+// Draws one token per row from the records of nshard shards, laid out
+// [nshard, nrow] as an all-gather leaves them. The k largest logits overall
+// are kept; with p_i their probabilities under a softmax at temperature
+// over the whole vocabulary, sorted descending, candidate i is picked
+// where its cumulative probability first reaches
+// random_vals[row] * min(topp, p_0 + ... + p_{k-1}).
+// temperature <= 0 or k == 1 picks the largest logit, lowest id on ties.
+void sample_candidates(void const *records, size_t nshard, size_t nrow,
+                       unsigned int k, float temperature, float topp,
+                       float const *random_vals, uint64_t *result);
+
+#endif
@@ -0,0 +1,46 @@
+#include "top_logprobs.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void top_logprobs(InfiniDataType_t dtype, void const *logits, size_t nrow,
+                  size_t dvoc, unsigned int n, unsigned int *ids,
+                  float *logprobs, size_t max_threads) {
+    ASSERT(dtype == INFINI_F16 || dtype == INFINI_F32);
+    ASSERT(n <= dvoc);
+    if (n == 0) {
+        return;
+    }
+    parallel_for(nrow, max_threads, [&](size_t row_begin, size_t row_end) {
+        auto row = std::vector<float>(dvoc);
+        auto order = std::vector<unsigned int>(dvoc);
+        // The lower id wins ties, so the order does not depend on the split.
+        auto before = [&](unsigned int a, unsigned int b) {
+            return row[a] > row[b] || (row[a] == row[b] && a < b);
+        };
+        for (size_t r = row_begin; r < row_end; r++) {
+            for (size_t i = 0; i < dvoc; i++) {
+                row[i] = dtype == INFINI_F16
+                             ? f16_to_f32(static_cast<uint16_t const *>(
+                                   logits)[r * dvoc + i])
+                             : static_cast<float const *>(logits)[r * dvoc + i];
+            }
+            float max = *std::max_element(row.begin(), row.end());
+            double sum = 0;
+            for (auto x : row) {
+                sum += std::exp(double(x - max));
+            }
+            float log_sum = max + float(std::log(sum));
+            for (unsigned int i = 0; i < dvoc; i++) {
+                order[i] = i;
+            }
+            std::nth_element(order.begin(), order.begin() + (n - 1),
+                             order.end(), before);
+            std::sort(order.begin(), order.begin() + n, before);
+            for (unsigned int i = 0; i < n; i++) {
+                ids[r * n + i] = order[i];
+                logprobs[r * n + i] = row[order[i]] - log_sum;
+            }
+        }
+    });
+}
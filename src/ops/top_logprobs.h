@@ -0,0 +1,14 @@
+#ifndef INFER_OPS_TOP_LOGPROBS_H
+#define INFER_OPS_TOP_LOGPROBS_H
+
+#include "../tensor.h"
+
+// Host-side log-softmax top-k. Each of the nrow rows of logits (F16 or F32,
+// dvoc elements each) is normalized in float; its n largest log-probs and
+// their token ids go to row r of ids / logprobs ([nrow, n]), largest first.
+// n must not exceed dvoc. Rows are split across up to max_threads threads.
+void top_logprobs(InfiniDataType_t dtype, void const *logits, size_t nrow,
+                  size_t dvoc, unsigned int n, unsigned int *ids,
+                  float *logprobs, size_t max_threads);
+
+#endif
@@ -0,0 +1,115 @@
+#include "varlen_attention.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+inline float load(float const *p, size_t i) { return p[i]; }
+inline float load(uint16_t const *p, size_t i) { return f16_to_f32(p[i]); }
+inline void store(float *p, size_t i, float x) { p[i] = x; }
+inline void store(uint16_t *p, size_t i, float x) { p[i] = f32_to_f16(x); }
+
+// Copies each request's new keys and values behind its cached ones. Runs
+// before any query so no head reads a row while another writes it.
+template <typename T>
+void append_kv(VarlenAttentionDesc const &desc, void const *k, void const *v,
+               unsigned int nreq, size_t const *cu_seqlens,
+               size_t const *past_lens, void *const *k_caches,
+               void *const *v_caches, size_t max_threads) {
+    auto row_bytes = desc.dh * sizeof(T);
+    parallel_for(nreq * desc.nkvh, max_threads, [&](size_t begin, size_t end) {
+        for (size_t item = begin; item < end; item++) {
+            auto req = item / desc.nkvh, head = item % desc.nkvh;
+            auto offset =
+                head * desc.cache_head_stride + past_lens[req] * desc.dh;
+            auto k_dst = static_cast<T *>(k_caches[req]) + offset;
+            auto v_dst = static_cast<T *>(v_caches[req]) + offset;
+            for (size_t row = cu_seqlens[req]; row < cu_seqlens[req + 1];
+                 row++) {
+                auto src = row * desc.kv_stride + head * desc.dh;
+                std::memcpy(k_dst, static_cast<T const *>(k) + src, row_bytes);
+                std::memcpy(v_dst, static_cast<T const *>(v) + src, row_bytes);
+                k_dst += desc.dh;
+                v_dst += desc.dh;
+            }
+        }
+    });
+}
+
+template <typename T>
+void attend(VarlenAttentionDesc const &desc, void *o, void const *q,
+            unsigned int nreq, size_t const *cu_seqlens,
+            size_t const *past_lens, void *const *k_caches,
+            void *const *v_caches, size_t max_threads) {
+    auto dh = desc.dh;
+    auto group = desc.nh / desc.nkvh;
+    auto scale = 1.f / std::sqrt(float(dh));
+    parallel_for(nreq * desc.nh, max_threads, [&](size_t begin, size_t end) {
+        auto query = std::vector<float>(dh), acc = std::vector<float>(dh);
+        auto scores = std::vector<float>();
+        for (size_t item = begin; item < end; item++) {
+            auto req = item / desc.nh, head = item % desc.nh;
+            auto cache_offset = head / group * desc.cache_head_stride;
+            auto k_cache = static_cast<T const *>(k_caches[req]) + cache_offset;
+            auto v_cache = static_cast<T const *>(v_caches[req]) + cache_offset;
+            for (size_t row = cu_seqlens[req]; row < cu_seqlens[req + 1];
+                 row++) {
+                auto q_row = static_cast<T const *>(q) + row * desc.q_stride +
+                             head * dh;
+                for (size_t x = 0; x < dh; x++) {
+                    query[x] = load(q_row, x) * scale;
+                }
+                // Causal: positions up to this token's own.
+                auto total = past_lens[req] + (row - cu_seqlens[req]) + 1;
+                scores.resize(total);
+                float max = -INFINITY;
+                for (size_t j = 0; j < total; j++) {
+                    float dot = 0;
+                    for (size_t x = 0; x < dh; x++) {
+                        dot += query[x] * load(k_cache, j * dh + x);
+                    }
+                    scores[j] = dot;
+                    max = std::max(max, dot);
+                }
+                float sum = 0;
+                std::fill(acc.begin(), acc.end(), 0.f);
+                for (size_t j = 0; j < total; j++) {
+                    float w = std::exp(scores[j] - max);
+                    sum += w;
+                    for (size_t x = 0; x < dh; x++) {
+                        acc[x] += w * load(v_cache, j * dh + x);
+                    }
+                }
+                auto o_row = static_cast<T *>(o) + row * desc.o_stride +
+                             head * dh;
+                for (size_t x = 0; x < dh; x++) {
+                    store(o_row, x, acc[x] / sum);
+                }
+            }
+        }
+    });
+}
+} // namespace
+
+void varlen_attention(VarlenAttentionDesc const &desc, void *o, void const *q,
+                      void const *k, void const *v, unsigned int nreq,
+                      size_t const *cu_seqlens, size_t const *past_lens,
+                      void *const *k_caches, void *const *v_caches,
+                      size_t max_threads) {
+    ASSERT(desc.nkvh > 0 && desc.nh % desc.nkvh == 0);
+    switch (desc.dtype) {
+    case INFINI_F16:
+        append_kv<uint16_t>(desc, k, v, nreq, cu_seqlens, past_lens, k_caches,
+                            v_caches, max_threads);
+        attend<uint16_t>(desc, o, q, nreq, cu_seqlens, past_lens, k_caches,
+                         v_caches, max_threads);
+        break;
+    case INFINI_F32:
+        append_kv<float>(desc, k, v, nreq, cu_seqlens, past_lens, k_caches,
+                         v_caches, max_threads);
+        attend<float>(desc, o, q, nreq, cu_seqlens, past_lens, k_caches,
+                      v_caches, max_threads);
+        break;
+    default:
+        PANIC("Unsupported attention data type");
+    }
+}
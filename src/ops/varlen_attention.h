@@ -0,0 +1,29 @@
+#ifndef INFER_OPS_VARLEN_ATTENTION_H
+#define INFER_OPS_VARLEN_ATTENTION_H
+
+#include "../tensor.h"
+
+// Layout of a packed batch for varlen_attention. q, k, v and o hold one row
+// per token, all requests back to back; strides are in elements.
+struct VarlenAttentionDesc {
+    InfiniDataType_t dtype; // F16 or F32, shared by activations and caches
+    size_t nh, nkvh, dh;
+    stride_t q_stride, kv_stride, o_stride;
+    // Each cache is [nkvh, max_len, dh]; elements between heads.
+    stride_t cache_head_stride;
+};
+
+// Host-side causal attention over a whole batch in one call. Request r owns
+// token rows [cu_seqlens[r], cu_seqlens[r + 1]) and continues the sequence
+// held in k_caches[r] / v_caches[r] at past_lens[r]. Its new keys and values
+// are appended to the caches first; each query then attends to every cached
+// position up to its own. Query heads share key heads in groups of
+// nh / nkvh. Work is split across (request, head) pairs on up to
+// max_threads threads.
+void varlen_attention(VarlenAttentionDesc const &desc, void *o, void const *q,
+                      void const *k, void const *v, unsigned int nreq,
+                      size_t const *cu_seqlens, size_t const *past_lens,
+                      void *const *k_caches, void *const *v_caches,
+                      size_t max_threads);
+
+#endif
@@ -1,7 +1,10 @@
 #include "infinirt_ascend.h"
+#include "../backend.h"
 #include <acl/acl.h>
+#include <algorithm>
 #include <iostream>
 #include <mutex>
+#include <set>
 
 #define ACL_CALL(x)                                                            \
     do {                                                                       \
@@ -42,6 +45,30 @@ infinirtStatus_t synchronizeAscendDevice(uint32_t deviceId) {
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t canAccessPeerAscend(int *canAccessPeer, uint32_t deviceId,
+                                    uint32_t peerDeviceId) {
+    int32_t can_access = 0;
+    ACL_CALL(aclrtDeviceCanAccessPeer(&can_access, deviceId, peerDeviceId));
+    *canAccessPeer = can_access;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+// ACL rejects enabling a pair twice, so enabled pairs are remembered.
+std::mutex peer_access_mutex;
+std::set<std::pair<uint32_t, uint32_t>> peer_access_enabled;
+
+infinirtStatus_t enablePeerAccessAscend(uint32_t deviceId,
+                                        uint32_t peerDeviceId) {
+    std::lock_guard<std::mutex> lock(peer_access_mutex);
+    if (peer_access_enabled.count({deviceId, peerDeviceId})) {
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    SWITCH_DEVICE(deviceId);
+    ACL_CALL(aclrtDeviceEnablePeerAccess(peerDeviceId, 0));
+    peer_access_enabled.insert({deviceId, peerDeviceId});
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t createAscendStream(infinirtStream_t *pStream,
                                     uint32_t deviceId) {
     SWITCH_DEVICE(deviceId);
@@ -55,6 +82,33 @@ infinirtStatus_t createAscendStream(infinirtStream_t *pStream,
     return INFINIRT_STATUS_SUCCESS;
 }
 
+// ACL priorities run from 0 (highest) to 7; default streams use 0.
+constexpr int ACL_LEAST_STREAM_PRIORITY = 7;
+
+infinirtStatus_t createAscendStreamWithPriority(infinirtStream_t *pStream,
+                                                uint32_t deviceId,
+                                                int priority) {
+    SWITCH_DEVICE(deviceId);
+    priority = std::min(std::max(priority, 0), ACL_LEAST_STREAM_PRIORITY);
+    aclrtStream acl_stream;
+    ACL_CALL(aclrtCreateStreamWithConfig(&acl_stream, (uint32_t)priority,
+                                         ACL_STREAM_FAST_LAUNCH));
+    infinirtStream_t stream = new infinirtStream();
+    stream->device = DEVICE_ASCEND;
+    stream->device_id = deviceId;
+    stream->stream = acl_stream;
+    *pStream = stream;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t getAscendStreamPriorityRange(uint32_t deviceId,
+                                              int *leastPriority,
+                                              int *greatestPriority) {
+    *leastPriority = ACL_LEAST_STREAM_PRIORITY;
+    *greatestPriority = 0;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t destoryAscendStream(infinirtStream_t stream) {
     SWITCH_DEVICE(stream->device_id);
     ACL_CALL(aclrtDestroyStream(stream->stream));
@@ -68,13 +122,31 @@ infinirtStatus_t synchronizeAscendStream(infinirtStream_t stream) {
     return INFINIRT_STATUS_SUCCESS;
 }
 
-infinirtStatus_t createAscendEvent(infinirtEvent_t *pEvent, uint32_t deviceId) {
+infinirtStatus_t launchAscendHostFunc(infinirtStream_t stream,
+                                      void (*fn)(void *), void *userData) {
+    /// @todo aclrtLaunchCallback needs a subscribed report thread; block on
+    /// the stream instead so the callback still observes all prior work.
+    infinirtStatus_t status = synchronizeAscendStream(stream);
+    if (status != INFINIRT_STATUS_SUCCESS) {
+        return status;
+    }
+    fn(userData);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t createAscendEvent(infinirtEvent_t *pEvent, uint32_t deviceId,
+                                   uint32_t flags) {
     SWITCH_DEVICE(deviceId);
     aclrtEvent acl_event;
-    ACL_CALL(aclrtCreateEvent(&acl_event));
+    if (flags & INFINIRT_EVENT_ENABLE_TIMING) {
+        ACL_CALL(aclrtCreateEventWithFlag(&acl_event, ACL_EVENT_TIME_LINE));
+    } else {
+        ACL_CALL(aclrtCreateEvent(&acl_event));
+    }
     infinirtEvent_t event = new infinirtEvent();
     event->device = DEVICE_ASCEND;
     event->device_id = deviceId;
+    event->flags = flags;
     event->event = acl_event;
     *pEvent = event;
     return INFINIRT_STATUS_SUCCESS;
@@ -117,6 +189,16 @@ infinirtStatus_t synchronizeAscendEvent(infinirtEvent_t event) {
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t elapsedAscendEvent(infinirtEvent_t start,
+                                    infinirtEvent_t end, float *ms) {
+    if (queryAscendEvent(start) != INFINIRT_STATUS_SUCCESS ||
+        queryAscendEvent(end) != INFINIRT_STATUS_SUCCESS) {
+        return INFINIRT_STATUS_NOT_READY;
+    }
+    ACL_CALL(aclrtEventElapsedTime(ms, start->event, end->event));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t mallocAscend(void **pMemory, uint32_t deviceId, size_t size) {
     SWITCH_DEVICE(deviceId);
     ACL_CALL(aclrtMalloc(pMemory, size, ACL_MEM_MALLOC_HUGE_FIRST));
@@ -153,6 +235,20 @@ infinirtStatus_t freeHostAscend(void *ptr, uint32_t deviceId){
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t registerHostAscend(void *ptr, uint32_t deviceId,
+                                    size_t size) {
+    SWITCH_DEVICE(deviceId);
+    void *dev_ptr;
+    ACL_CALL(aclrtHostRegister(ptr, size, ACL_HOST_REGISTER_MAPPED, &dev_ptr));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t unregisterHostAscend(void *ptr, uint32_t deviceId) {
+    SWITCH_DEVICE(deviceId);
+    ACL_CALL(aclrtHostUnregister(ptr));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyHost2Ascend(void *dst, uint32_t deviceId,
                                    const void *src, size_t size) {
     SWITCH_DEVICE(deviceId);
@@ -175,12 +271,43 @@ infinirtStatus_t memcpyAscend2Host(void *dst, const void *src,
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t memcpyAscend2HostAsync(void *dst, const void *src,
+                                        uint32_t deviceId, size_t size,
+                                        infinirtStream_t stream) {
+    SWITCH_DEVICE(deviceId);
+    ACL_CALL(aclrtMemcpyAsync(dst, size, src, size, ACL_MEMCPY_DEVICE_TO_HOST,
+                              stream->stream));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyAscend(void *dst, const void *src, uint32_t deviceId, size_t size){
     SWITCH_DEVICE(deviceId);
     ACL_CALL(aclrtMemcpy(dst, size, src, size, ACL_MEMCPY_DEVICE_TO_DEVICE));
     return INFINIRT_STATUS_SUCCESS;
 }
 
+// Once peer access is enabled a device-to-device copy may span devices; it
+// is issued from the destination device.
+infinirtStatus_t memcpyPeerAscend(void *dst, uint32_t dstDeviceId,
+                                  const void *src, uint32_t srcDeviceId,
+                                  size_t size) {
+    SWITCH_DEVICE(dstDeviceId);
+    ACL_CALL(aclrtMemcpy(dst, size, src, size, ACL_MEMCPY_DEVICE_TO_DEVICE));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyPeerAscendAsync(void *dst, uint32_t dstDeviceId,
+                                       const void *src, uint32_t srcDeviceId,
+                                       size_t size, infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpyPeerAscend(dst, dstDeviceId, src, srcDeviceId, size);
+    }
+    SWITCH_DEVICE(stream->device_id);
+    ACL_CALL(aclrtMemcpyAsync(dst, size, src, size, ACL_MEMCPY_DEVICE_TO_DEVICE,
+                              stream->stream));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyAscendAsync(void *dst, const void *src,
                                    uint32_t deviceId, size_t size,
                                    infinirtStream_t stream) {
@@ -189,3 +316,51 @@ infinirtStatus_t memcpyAscendAsync(void *dst, const void *src,
                               stream->stream));
     return INFINIRT_STATUS_SUCCESS;
 }
+
+const infinirtBackend *getAscendBackend() {
+    static const infinirtBackend backend = [] {
+        infinirtBackend table{};
+        table.abiVersion = INFINIRT_BACKEND_ABI_VERSION;
+        table.init = initAscend;
+        table.deviceSynchronize = synchronizeAscendDevice;
+        table.canAccessPeer = canAccessPeerAscend;
+        table.enablePeerAccess = enablePeerAccessAscend;
+        table.streamCreate = createAscendStream;
+        table.streamCreateWithPriority = createAscendStreamWithPriority;
+        table.streamPriorityRange = getAscendStreamPriorityRange;
+        table.streamDestroy = destoryAscendStream;
+        table.streamSynchronize = synchronizeAscendStream;
+        table.launchHostFunc = launchAscendHostFunc;
+        table.eventCreate = createAscendEvent;
+        table.eventDestroy = destoryAscendEvent;
+        table.streamWaitEvent = waitAscendEvent;
+        table.eventRecord = recordAscendEvent;
+        table.eventQuery = queryAscendEvent;
+        table.eventSynchronize = synchronizeAscendEvent;
+        table.eventElapsedTime = elapsedAscendEvent;
+        table.mallocDevice = mallocAscend;
+        table.mallocDeviceAsync = mallocAscendAsync;
+        table.mallocHost = mallocHostAscend;
+        table.freeDevice = freeAscend;
+        table.freeDeviceAsync = freeAscendAsync;
+        table.freeHost = freeHostAscend;
+        table.hostRegister = registerHostAscend;
+        table.hostUnregister = unregisterHostAscend;
+        table.memcpyH2D = memcpyHost2Ascend;
+        table.memcpyH2DAsync = memcpyHost2AscendAsync;
+        table.memcpyD2H = memcpyAscend2Host;
+        table.memcpyD2HAsync = memcpyAscend2HostAsync;
+        table.memcpyD2D = memcpyAscend;
+        table.memcpyD2DAsync = memcpyAscendAsync;
+        table.memcpyPeer = memcpyPeerAscend;
+        table.memcpyPeerAsync = memcpyPeerAscendAsync;
+        return table;
+    }();
+    return &backend;
+}
+
+#ifdef INFINIRT_BACKEND_PLUGIN
+__C __export const infinirtBackend *infinirtGetBackend() {
+    return getAscendBackend();
+}
+#endif
@@ -11,17 +11,23 @@
 infinirtStatus_t initAscend() IMPL_WITH_ASCEND
 
 infinirtStatus_t synchronizeAscendDevice(uint32_t deviceId) IMPL_WITH_ASCEND
+infinirtStatus_t canAccessPeerAscend(int *canAccessPeer, uint32_t deviceId, uint32_t peerDeviceId) IMPL_WITH_ASCEND
+infinirtStatus_t enablePeerAccessAscend(uint32_t deviceId, uint32_t peerDeviceId) IMPL_WITH_ASCEND
 
 infinirtStatus_t createAscendStream(infinirtStream_t *pStream, uint32_t deviceId) IMPL_WITH_ASCEND
+infinirtStatus_t createAscendStreamWithPriority(infinirtStream_t *pStream, uint32_t deviceId, int priority) IMPL_WITH_ASCEND
+infinirtStatus_t getAscendStreamPriorityRange(uint32_t deviceId, int *leastPriority, int *greatestPriority) IMPL_WITH_ASCEND
 infinirtStatus_t destoryAscendStream(infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t synchronizeAscendStream(infinirtStream_t stream) IMPL_WITH_ASCEND
+infinirtStatus_t launchAscendHostFunc(infinirtStream_t stream, void (*fn)(void *), void *userData) IMPL_WITH_ASCEND
 
-infinirtStatus_t createAscendEvent(infinirtEvent_t *pEvent, uint32_t deviceId) IMPL_WITH_ASCEND
+infinirtStatus_t createAscendEvent(infinirtEvent_t *pEvent, uint32_t deviceId, uint32_t flags) IMPL_WITH_ASCEND
 infinirtStatus_t destoryAscendEvent(infinirtEvent_t event) IMPL_WITH_ASCEND
 infinirtStatus_t waitAscendEvent(infinirtEvent_t event, infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t recordAscendEvent(infinirtEvent_t event, infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t queryAscendEvent(infinirtEvent_t event) IMPL_WITH_ASCEND
 infinirtStatus_t synchronizeAscendEvent(infinirtEvent_t event) IMPL_WITH_ASCEND
+infinirtStatus_t elapsedAscendEvent(infinirtEvent_t start, infinirtEvent_t end, float *ms) IMPL_WITH_ASCEND
 
 infinirtStatus_t mallocAscend(void **pMemory, uint32_t deviceId, size_t size) IMPL_WITH_ASCEND
 infinirtStatus_t mallocAscendAsync(void **pMemory, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_ASCEND
@@ -29,10 +35,15 @@ infinirtStatus_t mallocHostAscend(void **pMemory, uint32_t deviceId, size_t size
 infinirtStatus_t freeAscend(void *ptr, uint32_t deviceId) IMPL_WITH_ASCEND
 infinirtStatus_t freeAscendAsync(void *ptr, uint32_t deviceId, infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t freeHostAscend(void *ptr, uint32_t deviceId) IMPL_WITH_ASCEND
+infinirtStatus_t registerHostAscend(void *ptr, uint32_t deviceId, size_t size) IMPL_WITH_ASCEND
+infinirtStatus_t unregisterHostAscend(void *ptr, uint32_t deviceId) IMPL_WITH_ASCEND
 infinirtStatus_t memcpyHost2Ascend(void *dst, uint32_t deviceId, const void *src, size_t size) IMPL_WITH_ASCEND
 infinirtStatus_t memcpyHost2AscendAsync(void *dst, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t memcpyAscend2Host(void *dst, const void *src, uint32_t deviceId, size_t size) IMPL_WITH_ASCEND
+infinirtStatus_t memcpyAscend2HostAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_ASCEND
 infinirtStatus_t memcpyAscend(void *dst, const void *src, uint32_t deviceId, size_t size) IMPL_WITH_ASCEND
 infinirtStatus_t memcpyAscendAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_ASCEND
+infinirtStatus_t memcpyPeerAscend(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size) IMPL_WITH_ASCEND
+infinirtStatus_t memcpyPeerAscendAsync(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size, infinirtStream_t stream) IMPL_WITH_ASCEND
 
 #endif
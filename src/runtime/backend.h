@@ -0,0 +1,93 @@
+#ifndef INFINIRT_BACKEND_H
+#define INFINIRT_BACKEND_H
+#include "runtime.h"
+
+// Entry points of one device backend. infinirt dispatches every call through
+// the table registered for the call's DeviceType. Entries left null report
+// INFINIRT_STATUS_DEVICE_NOT_SUPPORTED, except the memory pool group, which
+// falls back to the generic caching pool while memPoolCreate is null. A
+// backend setting memPoolCreate must fill the whole group; plugins that do
+// not are rejected at load.
+//
+// Backends are either built in or loaded from a shared library exporting
+// infinirtGetBackend (see INFINIRT_BACKEND_PLUGIN). The runtime retags the
+// streams, events and pools a backend creates with the device of its slot,
+// so a backend must not rely on their device field. Bump the ABI version
+// whenever the table layout changes.
+#define INFINIRT_BACKEND_ABI_VERSION 2
+
+struct infinirtBackend {
+    uint32_t abiVersion;
+
+    // Device
+    infinirtStatus_t (*init)();
+    infinirtStatus_t (*deviceSynchronize)(uint32_t deviceId);
+    infinirtStatus_t (*canAccessPeer)(int *canAccessPeer, uint32_t deviceId, uint32_t peerDeviceId);
+    infinirtStatus_t (*enablePeerAccess)(uint32_t deviceId, uint32_t peerDeviceId);
+
+    // Stream
+    infinirtStatus_t (*streamCreate)(infinirtStream_t *pStream, uint32_t deviceId);
+    // Optional; without them every stream has the default priority.
+    infinirtStatus_t (*streamCreateWithPriority)(infinirtStream_t *pStream, uint32_t deviceId, int priority);
+    infinirtStatus_t (*streamPriorityRange)(uint32_t deviceId, int *leastPriority, int *greatestPriority);
+    infinirtStatus_t (*streamDestroy)(infinirtStream_t stream);
+    infinirtStatus_t (*streamSynchronize)(infinirtStream_t stream);
+    infinirtStatus_t (*launchHostFunc)(infinirtStream_t stream, void (*fn)(void *), void *userData);
+
+    // Event
+    infinirtStatus_t (*eventCreate)(infinirtEvent_t *pEvent, uint32_t deviceId, uint32_t flags);
+    infinirtStatus_t (*eventDestroy)(infinirtEvent_t event);
+    infinirtStatus_t (*streamWaitEvent)(infinirtEvent_t event, infinirtStream_t stream);
+    infinirtStatus_t (*eventRecord)(infinirtEvent_t event, infinirtStream_t stream);
+    infinirtStatus_t (*eventQuery)(infinirtEvent_t event);
+    infinirtStatus_t (*eventSynchronize)(infinirtEvent_t event);
+    infinirtStatus_t (*eventElapsedTime)(infinirtEvent_t start, infinirtEvent_t end, float *ms);
+
+    // Memory
+    infinirtStatus_t (*mallocDevice)(void **pMemory, uint32_t deviceId, size_t size);
+    infinirtStatus_t (*mallocDeviceAsync)(void **pMemory, uint32_t deviceId, size_t size, infinirtStream_t stream);
+    infinirtStatus_t (*mallocHost)(void **pMemory, uint32_t deviceId, size_t size);
+    infinirtStatus_t (*freeDevice)(void *ptr, uint32_t deviceId);
+    infinirtStatus_t (*freeDeviceAsync)(void *ptr, uint32_t deviceId, infinirtStream_t stream);
+    infinirtStatus_t (*freeHost)(void *ptr, uint32_t deviceId);
+    infinirtStatus_t (*hostRegister)(void *ptr, uint32_t deviceId, size_t size);
+    infinirtStatus_t (*hostUnregister)(void *ptr, uint32_t deviceId);
+    infinirtStatus_t (*memcpyH2D)(void *dst, uint32_t deviceId, const void *src, size_t size);
+    infinirtStatus_t (*memcpyH2DAsync)(void *dst, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream);
+    infinirtStatus_t (*memcpyD2H)(void *dst, const void *src, uint32_t deviceId, size_t size);
+    infinirtStatus_t (*memcpyD2HAsync)(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream);
+    infinirtStatus_t (*memcpyD2D)(void *dst, const void *src, uint32_t deviceId, size_t size);
+    infinirtStatus_t (*memcpyD2DAsync)(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream);
+    infinirtStatus_t (*memcpyPeer)(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size);
+    infinirtStatus_t (*memcpyPeerAsync)(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size, infinirtStream_t stream);
+
+    // Memory pool (optional)
+    infinirtStatus_t (*memPoolCreate)(infinirtMemPool_t *pPool, uint32_t deviceId, const infinirtMemPoolConfig_t *config);
+    infinirtStatus_t (*memPoolDestroy)(infinirtMemPool_t pool);
+    infinirtStatus_t (*mallocFromPool)(void **pMemory, size_t size, infinirtMemPool_t pool, infinirtStream_t stream);
+    infinirtStatus_t (*freeToPool)(void *ptr, infinirtMemPool_t pool, infinirtStream_t stream);
+    infinirtStatus_t (*memPoolTrim)(infinirtMemPool_t pool, size_t minBytesToKeep);
+    infinirtStatus_t (*memPoolGetStats)(infinirtMemPool_t pool, infinirtMemPoolStats_t *stats);
+};
+
+// Symbol a backend plugin exports.
+#define INFINIRT_BACKEND_ENTRY "infinirtGetBackend"
+typedef const infinirtBackend *(*infinirtGetBackendFn)();
+
+// Built-in backends, defined next to their implementations.
+const infinirtBackend *getCpuBackend();
+const infinirtBackend *getSimBackend();
+const infinirtBackend *getCudaBackend();
+const infinirtBackend *getAscendBackend();
+
+// Table of the backend for `device`, or null when none is registered.
+const infinirtBackend *getBackend(DeviceType device);
+
+// Name used in plugin file names: libinfinirt_<name>.so.
+const char *getDeviceName(DeviceType device);
+
+// dlopens the plugin for `device` from INFINIRT_BACKEND_PATH, the directory of
+// the runtime library or the loader search path; returns null when it does not
+// exist.
+void *openBackendLibrary(DeviceType device);
+#endif
@@ -0,0 +1,196 @@
+#include "infinirt_cpu.h"
+#include "../backend.h"
+#include "../host_stream.h"
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+
+namespace {
+struct HostRange {
+    size_t size;
+    bool locked;
+};
+// Registered host ranges keyed by start address.
+std::mutex host_ranges_mutex;
+std::map<uintptr_t, HostRange> host_ranges;
+
+inline void implicitSynchronize(uint32_t deviceId) {
+    implicitHostSynchronize(DEVICE_CPU, deviceId);
+}
+} // namespace
+
+infinirtStatus_t synchronizeCpuDevice(uint32_t deviceId) {
+    return synchronizeHostDevice(DEVICE_CPU, deviceId);
+}
+
+// All CPU "devices" share the host address space.
+infinirtStatus_t canAccessPeerCpu(int *canAccessPeer, uint32_t deviceId,
+                                  uint32_t peerDeviceId) {
+    *canAccessPeer = 1;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t enablePeerAccessCpu(uint32_t deviceId,
+                                     uint32_t peerDeviceId) {
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t createCpuStream(infinirtStream_t *pStream, uint32_t deviceId) {
+    return createHostStream(pStream, DEVICE_CPU, deviceId);
+}
+
+infinirtStatus_t createCpuEvent(infinirtEvent_t *pEvent, uint32_t deviceId,
+                                uint32_t flags) {
+    return createHostEvent(pEvent, DEVICE_CPU, deviceId, flags);
+}
+
+infinirtStatus_t mallocCpu(void **pMemory, uint32_t deviceId, size_t size) {
+    *pMemory = std::malloc(size);
+    if (*pMemory == nullptr && size != 0) {
+        return INFINIRT_STATUS_EXECUTION_FAILED;
+    }
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+// Host allocation does not touch any stream.
+infinirtStatus_t mallocCpuAsync(void **pMemory, uint32_t deviceId, size_t size,
+                                infinirtStream_t stream) {
+    return mallocCpu(pMemory, deviceId, size);
+}
+
+infinirtStatus_t freeCpu(void *ptr, uint32_t deviceId) {
+    implicitSynchronize(deviceId);
+    std::free(ptr);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeCpuAsync(void *ptr, uint32_t deviceId,
+                              infinirtStream_t stream) {
+    enqueueHostTask(stream,[ptr] { std::free(ptr); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t registerHostCpu(void *ptr, uint32_t deviceId, size_t size) {
+    if (ptr == nullptr || size == 0) {
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    }
+    auto begin = reinterpret_cast<uintptr_t>(ptr);
+    std::lock_guard<std::mutex> lock(host_ranges_mutex);
+    auto next = host_ranges.lower_bound(begin);
+    if (next != host_ranges.end() && next->first < begin + size) {
+        return INFINIRT_STATUS_ALREADY_REGISTERED;
+    }
+    if (next != host_ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second.size > begin) {
+            return INFINIRT_STATUS_ALREADY_REGISTERED;
+        }
+    }
+    // Pinning only keeps the pages resident here, so a process over its
+    // RLIMIT_MEMLOCK still gets a working, unpinned registration.
+    bool locked = mlock(ptr, size) == 0;
+    host_ranges[begin] = {size, locked};
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t unregisterHostCpu(void *ptr, uint32_t deviceId) {
+    std::lock_guard<std::mutex> lock(host_ranges_mutex);
+    auto it = host_ranges.find(reinterpret_cast<uintptr_t>(ptr));
+    if (it == host_ranges.end()) {
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    }
+    if (it->second.locked) {
+        munlock(ptr, it->second.size);
+    }
+    host_ranges.erase(it);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyCpu(void *dst, const void *src, uint32_t deviceId,
+                           size_t size) {
+    implicitSynchronize(deviceId);
+    std::memcpy(dst, src, size);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyHost2Cpu(void *dst, uint32_t deviceId, const void *src,
+                                size_t size) {
+    return memcpyCpu(dst, src, deviceId, size);
+}
+
+infinirtStatus_t memcpyHost2CpuAsync(void *dst, uint32_t deviceId,
+                                     const void *src, size_t size,
+                                     infinirtStream_t stream) {
+    return memcpyCpuAsync(dst, src, deviceId, size, stream);
+}
+
+infinirtStatus_t memcpyCpuAsync(void *dst, const void *src, uint32_t deviceId,
+                                size_t size, infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpyCpu(dst, src, deviceId, size);
+    }
+    enqueueHostTask(stream,
+        [dst, src, size] { std::memcpy(dst, src, size); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyPeerCpu(void *dst, uint32_t dstDeviceId,
+                               const void *src, uint32_t srcDeviceId,
+                               size_t size) {
+    implicitSynchronize(srcDeviceId);
+    if (dstDeviceId != srcDeviceId) {
+        implicitSynchronize(dstDeviceId);
+    }
+    std::memcpy(dst, src, size);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyPeerCpuAsync(void *dst, uint32_t dstDeviceId,
+                                    const void *src, uint32_t srcDeviceId,
+                                    size_t size, infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpyPeerCpu(dst, dstDeviceId, src, srcDeviceId, size);
+    }
+    return memcpyCpuAsync(dst, src, stream->device_id, size, stream);
+}
+
+const infinirtBackend *getCpuBackend() {
+    static const infinirtBackend backend = [] {
+        infinirtBackend table{};
+        table.abiVersion = INFINIRT_BACKEND_ABI_VERSION;
+        table.deviceSynchronize = synchronizeCpuDevice;
+        table.canAccessPeer = canAccessPeerCpu;
+        table.enablePeerAccess = enablePeerAccessCpu;
+        table.streamCreate = createCpuStream;
+        table.streamDestroy = destroyHostStream;
+        table.streamSynchronize = synchronizeHostStream;
+        table.launchHostFunc = launchHostStreamFunc;
+        table.eventCreate = createCpuEvent;
+        table.eventDestroy = destroyHostEvent;
+        table.streamWaitEvent = waitHostEvent;
+        table.eventRecord = recordHostEvent;
+        table.eventQuery = queryHostEvent;
+        table.eventSynchronize = synchronizeHostEvent;
+        table.eventElapsedTime = elapsedHostEvent;
+        table.mallocDevice = mallocCpu;
+        table.mallocDeviceAsync = mallocCpuAsync;
+        table.mallocHost = mallocCpu;
+        table.freeDevice = freeCpu;
+        table.freeDeviceAsync = freeCpuAsync;
+        table.freeHost = freeCpu;
+        table.hostRegister = registerHostCpu;
+        table.hostUnregister = unregisterHostCpu;
+        table.memcpyH2D = memcpyHost2Cpu;
+        table.memcpyH2DAsync = memcpyHost2CpuAsync;
+        table.memcpyD2H = memcpyCpu;
+        table.memcpyD2HAsync = memcpyCpuAsync;
+        table.memcpyD2D = memcpyCpu;
+        table.memcpyD2DAsync = memcpyCpuAsync;
+        table.memcpyPeer = memcpyPeerCpu;
+        table.memcpyPeerAsync = memcpyPeerCpuAsync;
+        return table;
+    }();
+    return &backend;
+}
@@ -0,0 +1,28 @@
+#ifndef INFINIRT_CPU_H
+#define INFINIRT_CPU_H
+#include "../runtime.h"
+
+// The CPU backend is always built. Streams and events are the host-thread
+// implementation in host_stream.h.
+
+infinirtStatus_t synchronizeCpuDevice(uint32_t deviceId);
+infinirtStatus_t canAccessPeerCpu(int *canAccessPeer, uint32_t deviceId, uint32_t peerDeviceId);
+infinirtStatus_t enablePeerAccessCpu(uint32_t deviceId, uint32_t peerDeviceId);
+
+infinirtStatus_t createCpuStream(infinirtStream_t *pStream, uint32_t deviceId);
+
+infinirtStatus_t createCpuEvent(infinirtEvent_t *pEvent, uint32_t deviceId, uint32_t flags);
+
+infinirtStatus_t mallocCpu(void **pMemory, uint32_t deviceId, size_t size);
+infinirtStatus_t mallocCpuAsync(void **pMemory, uint32_t deviceId, size_t size, infinirtStream_t stream);
+infinirtStatus_t freeCpu(void *ptr, uint32_t deviceId);
+infinirtStatus_t freeCpuAsync(void *ptr, uint32_t deviceId, infinirtStream_t stream);
+infinirtStatus_t registerHostCpu(void *ptr, uint32_t deviceId, size_t size);
+infinirtStatus_t unregisterHostCpu(void *ptr, uint32_t deviceId);
+infinirtStatus_t memcpyHost2Cpu(void *dst, uint32_t deviceId, const void *src, size_t size);
+infinirtStatus_t memcpyHost2CpuAsync(void *dst, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream);
+infinirtStatus_t memcpyCpu(void *dst, const void *src, uint32_t deviceId, size_t size);
+infinirtStatus_t memcpyCpuAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream);
+infinirtStatus_t memcpyPeerCpu(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size);
+infinirtStatus_t memcpyPeerCpuAsync(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size, infinirtStream_t stream);
+#endif
@@ -1,4 +1,5 @@
 #include "infinirt_cuda.h"
+#include "../backend.h"
 #include "cuda_runtime.h"
 #include <iostream>
 
@@ -35,6 +36,25 @@ infinirtStatus_t synchronizeCudaDevice(uint32_t deviceId){
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t canAccessPeerCuda(int *canAccessPeer, uint32_t deviceId,
+                                  uint32_t peerDeviceId) {
+    CUDA_CALL(cudaDeviceCanAccessPeer(canAccessPeer, deviceId, peerDeviceId));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t enablePeerAccessCuda(uint32_t deviceId,
+                                      uint32_t peerDeviceId) {
+    SWITCH_DEVICE(deviceId);
+    cudaError_t err = cudaDeviceEnablePeerAccess(peerDeviceId, 0);
+    if (err == cudaErrorPeerAccessAlreadyEnabled) {
+        // Clear the sticky error so later calls do not report it.
+        cudaGetLastError();
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    CUDA_CALL(err);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t createCudaStream(infinirtStream_t *pStream,
                                   uint32_t deviceId) {
     SWITCH_DEVICE(deviceId);
@@ -47,6 +67,31 @@ infinirtStatus_t createCudaStream(infinirtStream_t *pStream,
     *pStream = stream;
     return INFINIRT_STATUS_SUCCESS;
 }
+
+// CUDA clamps out-of-range priorities itself.
+infinirtStatus_t createCudaStreamWithPriority(infinirtStream_t *pStream,
+                                              uint32_t deviceId,
+                                              int priority) {
+    SWITCH_DEVICE(deviceId);
+    cudaStream_t cuda_stream;
+    CUDA_CALL(cudaStreamCreateWithPriority(&cuda_stream, cudaStreamDefault,
+                                           priority));
+    infinirtStream_t stream = new infinirtStream();
+    stream->device = DEVICE_NVIDIA;
+    stream->device_id = deviceId;
+    stream->stream = cuda_stream;
+    *pStream = stream;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t getCudaStreamPriorityRange(uint32_t deviceId,
+                                            int *leastPriority,
+                                            int *greatestPriority) {
+    SWITCH_DEVICE(deviceId);
+    CUDA_CALL(cudaDeviceGetStreamPriorityRange(leastPriority, greatestPriority));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t destoryCudaStream(infinirtStream_t stream) {
     SWITCH_DEVICE(stream->device_id);
     CUDA_CALL(cudaStreamDestroy(getCudaStream(stream)));
@@ -59,13 +104,26 @@ infinirtStatus_t synchronizeCudaStream(infinirtStream_t stream){
     return INFINIRT_STATUS_SUCCESS;
 }
 
-infinirtStatus_t createCudaEvent(infinirtEvent_t *pEvent, uint32_t deviceId) {
+infinirtStatus_t launchCudaHostFunc(infinirtStream_t stream, void (*fn)(void *),
+                                    void *userData) {
+    SWITCH_DEVICE(stream->device_id);
+    CUDA_CALL(cudaLaunchHostFunc(getCudaStream(stream), fn, userData));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t createCudaEvent(infinirtEvent_t *pEvent, uint32_t deviceId,
+                                 uint32_t flags) {
     SWITCH_DEVICE(deviceId);
     cudaEvent_t cuda_event;
-    CUDA_CALL(cudaEventCreate(&cuda_event));
+    // Timestamps cost extra work on every record, so only pay when asked.
+    CUDA_CALL(cudaEventCreateWithFlags(
+        &cuda_event, (flags & INFINIRT_EVENT_ENABLE_TIMING)
+                         ? cudaEventDefault
+                         : cudaEventDisableTiming));
     infinirtEvent_t event = new infinirtEvent();
     event->device = DEVICE_NVIDIA;
     event->device_id = deviceId;
+    event->flags = flags;
     event->event = cuda_event;
     *pEvent = event;
     return INFINIRT_STATUS_SUCCESS;
@@ -107,6 +165,19 @@ infinirtStatus_t synchronizeCudaEvent(infinirtEvent_t event) {
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t elapsedCudaEvent(infinirtEvent_t start,
+                                  infinirtEvent_t end, float *ms) {
+    SWITCH_DEVICE(start->device_id);
+    cudaError_t err =
+        cudaEventElapsedTime(ms, static_cast<cudaEvent_t>(start->event),
+                             static_cast<cudaEvent_t>(end->event));
+    if (err == cudaErrorNotReady) {
+        return INFINIRT_STATUS_NOT_READY;
+    }
+    CUDA_CALL(err);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t mallocCuda(void **pMemory, uint32_t deviceId, size_t size) {
     SWITCH_DEVICE(deviceId);
     void *cuda_ptr;
@@ -152,6 +223,24 @@ infinirtStatus_t freeHostCuda(void *ptr, uint32_t deviceId) {
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t registerHostCuda(void *ptr, uint32_t deviceId, size_t size) {
+    SWITCH_DEVICE(deviceId);
+    // Portable, so one registration serves copies to every device.
+    cudaError_t err = cudaHostRegister(ptr, size, cudaHostRegisterPortable);
+    if (err == cudaErrorHostMemoryAlreadyRegistered) {
+        cudaGetLastError();
+        return INFINIRT_STATUS_ALREADY_REGISTERED;
+    }
+    CUDA_CALL(err);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t unregisterHostCuda(void *ptr, uint32_t deviceId) {
+    SWITCH_DEVICE(deviceId);
+    CUDA_CALL(cudaHostUnregister(ptr));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyHost2Cuda(void *dst, uint32_t deviceId, const void *src,
                                  size_t size) {
     SWITCH_DEVICE(deviceId);
@@ -175,6 +264,15 @@ infinirtStatus_t memcpyCuda2Host(void *dst, const void *src, uint32_t deviceId,
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t memcpyCuda2HostAsync(void *dst, const void *src,
+                                      uint32_t deviceId, size_t size,
+                                      infinirtStream_t stream) {
+    SWITCH_DEVICE(deviceId);
+    CUDA_CALL(cudaMemcpyAsync(dst, src, size, cudaMemcpyDeviceToHost,
+                              getCudaStream(stream)));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyCuda(void *dst, const void *src, uint32_t deviceId,
                             size_t size) {
     SWITCH_DEVICE(deviceId);
@@ -182,6 +280,24 @@ infinirtStatus_t memcpyCuda(void *dst, const void *src, uint32_t deviceId,
     return INFINIRT_STATUS_SUCCESS;
 }
 
+infinirtStatus_t memcpyPeerCuda(void *dst, uint32_t dstDeviceId,
+                                const void *src, uint32_t srcDeviceId,
+                                size_t size) {
+    CUDA_CALL(cudaMemcpyPeer(dst, dstDeviceId, src, srcDeviceId, size));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyPeerCudaAsync(void *dst, uint32_t dstDeviceId,
+                                     const void *src, uint32_t srcDeviceId,
+                                     size_t size, infinirtStream_t stream) {
+    if (stream != nullptr) {
+        SWITCH_DEVICE(stream->device_id);
+    }
+    CUDA_CALL(cudaMemcpyPeerAsync(dst, dstDeviceId, src, srcDeviceId, size,
+                                  getCudaStream(stream)));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
 infinirtStatus_t memcpyCudaAsync(void *dst, const void *src, uint32_t deviceId,
                                  size_t size, infinirtStream_t stream) {
     SWITCH_DEVICE(deviceId);
@@ -189,3 +305,129 @@ infinirtStatus_t memcpyCudaAsync(void *dst, const void *src, uint32_t deviceId,
                               getCudaStream(stream)));
     return INFINIRT_STATUS_SUCCESS;
 }
+
+inline cudaMemPool_t getCudaMemPool(infinirtMemPool_t pool) {
+    return static_cast<cudaMemPool_t>(pool->pool);
+}
+
+infinirtStatus_t createCudaMemPool(infinirtMemPool_t *pPool, uint32_t deviceId,
+                                   const infinirtMemPoolConfig_t *config) {
+    SWITCH_DEVICE(deviceId);
+    cudaMemPoolProps props = {};
+    props.allocType = cudaMemAllocationTypePinned;
+    props.location.type = cudaMemLocationTypeDevice;
+    props.location.id = deviceId;
+    cudaMemPool_t cuda_pool;
+    CUDA_CALL(cudaMemPoolCreate(&cuda_pool, &props));
+    uint64_t threshold =
+        config != nullptr ? config->releaseThreshold : UINT64_MAX;
+    CUDA_CALL(cudaMemPoolSetAttribute(
+        cuda_pool, cudaMemPoolAttrReleaseThreshold, &threshold));
+    infinirtMemPool_t pool = new infinirtMemPool();
+    pool->device = DEVICE_NVIDIA;
+    pool->device_id = deviceId;
+    pool->pool = cuda_pool;
+    *pPool = pool;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t destroyCudaMemPool(infinirtMemPool_t pool) {
+    SWITCH_DEVICE(pool->device_id);
+    CUDA_CALL(cudaMemPoolDestroy(getCudaMemPool(pool)));
+    delete pool;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t mallocCudaMemPool(void **pMemory, size_t size,
+                                   infinirtMemPool_t pool,
+                                   infinirtStream_t stream) {
+    SWITCH_DEVICE(pool->device_id);
+    CUDA_CALL(cudaMallocFromPoolAsync(pMemory, size, getCudaMemPool(pool),
+                                      getCudaStream(stream)));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeCudaMemPool(void *ptr, infinirtMemPool_t pool,
+                                 infinirtStream_t stream) {
+    SWITCH_DEVICE(pool->device_id);
+    CUDA_CALL(cudaFreeAsync(ptr, getCudaStream(stream)));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t trimCudaMemPool(infinirtMemPool_t pool,
+                                 size_t minBytesToKeep) {
+    CUDA_CALL(cudaMemPoolTrimTo(getCudaMemPool(pool), minBytesToKeep));
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t getCudaMemPoolStats(infinirtMemPool_t pool,
+                                     infinirtMemPoolStats_t *stats) {
+    auto cuda_pool = getCudaMemPool(pool);
+    uint64_t value;
+    CUDA_CALL(cudaMemPoolGetAttribute(
+        cuda_pool, cudaMemPoolAttrReservedMemCurrent, &value));
+    stats->reservedCurrent = value;
+    CUDA_CALL(cudaMemPoolGetAttribute(cuda_pool, cudaMemPoolAttrReservedMemHigh,
+                                      &value));
+    stats->reservedPeak = value;
+    CUDA_CALL(cudaMemPoolGetAttribute(cuda_pool, cudaMemPoolAttrUsedMemCurrent,
+                                      &value));
+    stats->usedCurrent = value;
+    CUDA_CALL(
+        cudaMemPoolGetAttribute(cuda_pool, cudaMemPoolAttrUsedMemHigh, &value));
+    stats->usedPeak = value;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+const infinirtBackend *getCudaBackend() {
+    static const infinirtBackend backend = [] {
+        infinirtBackend table{};
+        table.abiVersion = INFINIRT_BACKEND_ABI_VERSION;
+        table.deviceSynchronize = synchronizeCudaDevice;
+        table.canAccessPeer = canAccessPeerCuda;
+        table.enablePeerAccess = enablePeerAccessCuda;
+        table.streamCreate = createCudaStream;
+        table.streamCreateWithPriority = createCudaStreamWithPriority;
+        table.streamPriorityRange = getCudaStreamPriorityRange;
+        table.streamDestroy = destoryCudaStream;
+        table.streamSynchronize = synchronizeCudaStream;
+        table.launchHostFunc = launchCudaHostFunc;
+        table.eventCreate = createCudaEvent;
+        table.eventDestroy = destoryCudaEvent;
+        table.streamWaitEvent = waitCudaEvent;
+        table.eventRecord = recordCudaEvent;
+        table.eventQuery = queryCudaEvent;
+        table.eventSynchronize = synchronizeCudaEvent;
+        table.eventElapsedTime = elapsedCudaEvent;
+        table.mallocDevice = mallocCuda;
+        table.mallocDeviceAsync = mallocCudaAsync;
+        table.mallocHost = mallocHostCuda;
+        table.freeDevice = freeCuda;
+        table.freeDeviceAsync = freeCudaAsync;
+        table.freeHost = freeHostCuda;
+        table.hostRegister = registerHostCuda;
+        table.hostUnregister = unregisterHostCuda;
+        table.memcpyH2D = memcpyHost2Cuda;
+        table.memcpyH2DAsync = memcpyHost2CudaAsync;
+        table.memcpyD2H = memcpyCuda2Host;
+        table.memcpyD2HAsync = memcpyCuda2HostAsync;
+        table.memcpyD2D = memcpyCuda;
+        table.memcpyD2DAsync = memcpyCudaAsync;
+        table.memcpyPeer = memcpyPeerCuda;
+        table.memcpyPeerAsync = memcpyPeerCudaAsync;
+        table.memPoolCreate = createCudaMemPool;
+        table.memPoolDestroy = destroyCudaMemPool;
+        table.mallocFromPool = mallocCudaMemPool;
+        table.freeToPool = freeCudaMemPool;
+        table.memPoolTrim = trimCudaMemPool;
+        table.memPoolGetStats = getCudaMemPoolStats;
+        return table;
+    }();
+    return &backend;
+}
+
+#ifdef INFINIRT_BACKEND_PLUGIN
+__C __export const infinirtBackend *infinirtGetBackend() {
+    return getCudaBackend();
+}
+#endif
@@ -9,17 +9,23 @@
 #endif
 
 infinirtStatus_t synchronizeCudaDevice(uint32_t deviceId) IMPL_WITH_CUDA
+infinirtStatus_t canAccessPeerCuda(int *canAccessPeer, uint32_t deviceId, uint32_t peerDeviceId) IMPL_WITH_CUDA
+infinirtStatus_t enablePeerAccessCuda(uint32_t deviceId, uint32_t peerDeviceId) IMPL_WITH_CUDA
 
 infinirtStatus_t createCudaStream(infinirtStream_t *pStream, uint32_t deviceId) IMPL_WITH_CUDA
+infinirtStatus_t createCudaStreamWithPriority(infinirtStream_t *pStream, uint32_t deviceId, int priority) IMPL_WITH_CUDA
+infinirtStatus_t getCudaStreamPriorityRange(uint32_t deviceId, int *leastPriority, int *greatestPriority) IMPL_WITH_CUDA
 infinirtStatus_t destoryCudaStream(infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t synchronizeCudaStream(infinirtStream_t stream) IMPL_WITH_CUDA
+infinirtStatus_t launchCudaHostFunc(infinirtStream_t stream, void (*fn)(void *), void *userData) IMPL_WITH_CUDA
 
-infinirtStatus_t createCudaEvent(infinirtEvent_t *pEvent, uint32_t deviceId) IMPL_WITH_CUDA
+infinirtStatus_t createCudaEvent(infinirtEvent_t *pEvent, uint32_t deviceId, uint32_t flags) IMPL_WITH_CUDA
 infinirtStatus_t destoryCudaEvent(infinirtEvent_t event) IMPL_WITH_CUDA
 infinirtStatus_t waitCudaEvent(infinirtEvent_t event, infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t recordCudaEvent(infinirtEvent_t event, infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t queryCudaEvent(infinirtEvent_t event) IMPL_WITH_CUDA
 infinirtStatus_t synchronizeCudaEvent(infinirtEvent_t event) IMPL_WITH_CUDA
+infinirtStatus_t elapsedCudaEvent(infinirtEvent_t start, infinirtEvent_t end, float *ms) IMPL_WITH_CUDA
 
 infinirtStatus_t mallocCuda(void **pMemory, uint32_t deviceId, size_t size) IMPL_WITH_CUDA
 infinirtStatus_t mallocCudaAsync(void **pMemory, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_CUDA
@@ -27,9 +33,21 @@ infinirtStatus_t mallocHostCuda(void **pMemory, uint32_t deviceId, size_t size)
 infinirtStatus_t freeCuda(void *ptr, uint32_t deviceId) IMPL_WITH_CUDA
 infinirtStatus_t freeCudaAsync(void *ptr, uint32_t deviceId, infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t freeHostCuda(void *ptr, uint32_t deviceId) IMPL_WITH_CUDA
+infinirtStatus_t registerHostCuda(void *ptr, uint32_t deviceId, size_t size) IMPL_WITH_CUDA
+infinirtStatus_t unregisterHostCuda(void *ptr, uint32_t deviceId) IMPL_WITH_CUDA
 infinirtStatus_t memcpyHost2Cuda(void *dst, uint32_t deviceId, const void *src, size_t size) IMPL_WITH_CUDA
 infinirtStatus_t memcpyHost2CudaAsync(void *dst, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t memcpyCuda2Host(void *dst, const void *src, uint32_t deviceId, size_t size) IMPL_WITH_CUDA
+infinirtStatus_t memcpyCuda2HostAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_CUDA
 infinirtStatus_t memcpyCuda(void *dst, const void *src, uint32_t deviceId, size_t size) IMPL_WITH_CUDA
 infinirtStatus_t memcpyCudaAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream) IMPL_WITH_CUDA
+infinirtStatus_t memcpyPeerCuda(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size) IMPL_WITH_CUDA
+infinirtStatus_t memcpyPeerCudaAsync(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size, infinirtStream_t stream) IMPL_WITH_CUDA
+
+infinirtStatus_t createCudaMemPool(infinirtMemPool_t *pPool, uint32_t deviceId, const infinirtMemPoolConfig_t *config) IMPL_WITH_CUDA
+infinirtStatus_t destroyCudaMemPool(infinirtMemPool_t pool) IMPL_WITH_CUDA
+infinirtStatus_t mallocCudaMemPool(void **pMemory, size_t size, infinirtMemPool_t pool, infinirtStream_t stream) IMPL_WITH_CUDA
+infinirtStatus_t freeCudaMemPool(void *ptr, infinirtMemPool_t pool, infinirtStream_t stream) IMPL_WITH_CUDA
+infinirtStatus_t trimCudaMemPool(infinirtMemPool_t pool, size_t minBytesToKeep) IMPL_WITH_CUDA
+infinirtStatus_t getCudaMemPoolStats(infinirtMemPool_t pool, infinirtMemPoolStats_t *stats) IMPL_WITH_CUDA
 #endif
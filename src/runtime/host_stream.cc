@@ -0,0 +1,300 @@
+#include "host_stream.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+// Set on stream worker threads. Host functions run there and must not wait
+// for their own stream, so implicit device synchronization is skipped.
+thread_local bool on_stream_worker = false;
+
+class HostStream {
+  public:
+    HostStream(DeviceType device, uint32_t deviceId)
+        : device(device), device_id(deviceId), _stop(false), _busy(false),
+          _worker(&HostStream::run, this) {}
+
+    ~HostStream() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _worker.join();
+    }
+
+    void enqueue(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back(std::move(task));
+        }
+        _cv.notify_all();
+    }
+
+    void synchronize() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle.wait(lock, [this] { return _tasks.empty() && !_busy; });
+    }
+
+    // The registry key. infinirtStream::device may be retagged by the
+    // runtime when the backend is loaded into another device's slot.
+    const DeviceType device;
+    const uint32_t device_id;
+
+  private:
+    void run() {
+        on_stream_worker = true;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+            if (_tasks.empty()) {
+                break;
+            }
+            auto task = std::move(_tasks.front());
+            _tasks.pop_front();
+            _busy = true;
+            lock.unlock();
+            task();
+            // Release captured state before reporting idle.
+            task = nullptr;
+            lock.lock();
+            _busy = false;
+            if (_tasks.empty()) {
+                _idle.notify_all();
+            }
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cv, _idle;
+    std::deque<std::function<void()>> _tasks;
+    bool _stop, _busy;
+    std::thread _worker;
+};
+
+// An event completes when the stream it was last recorded on reaches the
+// record. Records are numbered so that waits and queries always refer to
+// the most recent record at the time of the call. Timing events stamp the
+// moment the stream actually reaches the record, not when it was queued.
+struct HostEvent {
+    // Device whose streams a record without a stream waits for.
+    DeviceType device;
+    uint32_t device_id;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t recorded = 0;
+    uint64_t completed = 0;
+    bool timing = false;
+    std::chrono::steady_clock::time_point stamp;
+
+    uint64_t record() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return ++recorded;
+    }
+
+    void complete(uint64_t ticket) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ticket > completed && timing) {
+                stamp = std::chrono::steady_clock::now();
+            }
+            completed = std::max(completed, ticket);
+        }
+        cv.notify_all();
+    }
+
+    uint64_t latest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recorded;
+    }
+
+    bool reached(uint64_t ticket) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed >= ticket;
+    }
+
+    void wait(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return completed >= ticket; });
+    }
+};
+
+std::mutex registry_mutex;
+std::map<std::pair<DeviceType, uint32_t>,
+         std::vector<std::shared_ptr<HostStream>>>
+    registry;
+
+inline HostStream *getHostStream(infinirtStream_t stream) {
+    return static_cast<HostStream *>(stream->stream);
+}
+
+// Events are shared with the tasks that complete them, so destroying an
+// event with a record still in flight is safe.
+inline std::shared_ptr<HostEvent> &getHostEvent(infinirtEvent_t event) {
+    return *static_cast<std::shared_ptr<HostEvent> *>(event->event);
+}
+} // namespace
+
+infinirtStatus_t synchronizeHostDevice(DeviceType device, uint32_t deviceId) {
+    std::vector<std::shared_ptr<HostStream>> streams;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto it = registry.find({device, deviceId});
+        if (it != registry.end()) {
+            streams = it->second;
+        }
+    }
+    for (auto &stream : streams) {
+        stream->synchronize();
+    }
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+void implicitHostSynchronize(DeviceType device, uint32_t deviceId) {
+    if (!on_stream_worker) {
+        synchronizeHostDevice(device, deviceId);
+    }
+}
+
+infinirtStatus_t createHostStream(infinirtStream_t *pStream, DeviceType device,
+                                  uint32_t deviceId) {
+    auto host_stream = std::make_shared<HostStream>(device, deviceId);
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry[{device, deviceId}].push_back(host_stream);
+    }
+    infinirtStream_t stream = new infinirtStream();
+    stream->device = device;
+    stream->device_id = deviceId;
+    stream->stream = host_stream.get();
+    *pStream = stream;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t destroyHostStream(infinirtStream_t stream) {
+    std::shared_ptr<HostStream> host_stream;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto &streams = registry[{getHostStream(stream)->device,
+                                  getHostStream(stream)->device_id}];
+        auto it = std::find_if(streams.begin(), streams.end(),
+                               [&](const std::shared_ptr<HostStream> &s) {
+                                   return s.get() == getHostStream(stream);
+                               });
+        if (it == streams.end()) {
+            return INFINIRT_STATUS_INVALID_ARGUMENT;
+        }
+        host_stream = *it;
+        streams.erase(it);
+    }
+    // Dropping the last reference drains the queue and joins the worker.
+    host_stream.reset();
+    delete stream;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t synchronizeHostStream(infinirtStream_t stream) {
+    getHostStream(stream)->synchronize();
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t launchHostStreamFunc(infinirtStream_t stream,
+                                      void (*fn)(void *), void *userData) {
+    if (stream == nullptr) {
+        fn(userData);
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    getHostStream(stream)->enqueue([fn, userData] { fn(userData); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+void enqueueHostTask(infinirtStream_t stream, std::function<void()> task) {
+    getHostStream(stream)->enqueue(std::move(task));
+}
+
+infinirtStatus_t createHostEvent(infinirtEvent_t *pEvent, DeviceType device,
+                                 uint32_t deviceId, uint32_t flags) {
+    auto host_event = std::make_shared<HostEvent>();
+    host_event->device = device;
+    host_event->device_id = deviceId;
+    host_event->timing = (flags & INFINIRT_EVENT_ENABLE_TIMING) != 0;
+    infinirtEvent_t event = new infinirtEvent();
+    event->device = device;
+    event->device_id = deviceId;
+    event->flags = flags;
+    event->event = new std::shared_ptr<HostEvent>(std::move(host_event));
+    *pEvent = event;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t destroyHostEvent(infinirtEvent_t event) {
+    delete static_cast<std::shared_ptr<HostEvent> *>(event->event);
+    delete event;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t waitHostEvent(infinirtEvent_t event, infinirtStream_t stream) {
+    auto host_event = getHostEvent(event);
+    auto ticket = host_event->latest();
+    if (stream == nullptr) {
+        host_event->wait(ticket);
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    getHostStream(stream)->enqueue(
+        [host_event, ticket] { host_event->wait(ticket); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t recordHostEvent(infinirtEvent_t event,
+                                 infinirtStream_t stream) {
+    auto host_event = getHostEvent(event);
+    auto ticket = host_event->record();
+    if (stream == nullptr) {
+        implicitHostSynchronize(host_event->device, host_event->device_id);
+        host_event->complete(ticket);
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    getHostStream(stream)->enqueue(
+        [host_event, ticket] { host_event->complete(ticket); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t queryHostEvent(infinirtEvent_t event) {
+    auto &host_event = getHostEvent(event);
+    if (host_event->reached(host_event->latest())) {
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    return INFINIRT_STATUS_NOT_READY;
+}
+
+infinirtStatus_t synchronizeHostEvent(infinirtEvent_t event) {
+    auto &host_event = getHostEvent(event);
+    host_event->wait(host_event->latest());
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t elapsedHostEvent(infinirtEvent_t start, infinirtEvent_t end,
+                                  float *ms) {
+    std::chrono::steady_clock::time_point stamps[2];
+    std::shared_ptr<HostEvent> events[2] = {getHostEvent(start),
+                                            getHostEvent(end)};
+    for (int i = 0; i < 2; i++) {
+        std::lock_guard<std::mutex> lock(events[i]->mutex);
+        if (events[i]->recorded == 0) {
+            return INFINIRT_STATUS_INVALID_ARGUMENT;
+        }
+        if (events[i]->completed < events[i]->recorded) {
+            return INFINIRT_STATUS_NOT_READY;
+        }
+        stamps[i] = events[i]->stamp;
+    }
+    *ms = std::chrono::duration<float, std::milli>(stamps[1] - stamps[0]).count();
+    return INFINIRT_STATUS_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#ifndef INFINIRT_HOST_STREAM_H
+#define INFINIRT_HOST_STREAM_H
+#include "runtime.h"
+#include <functional>
+
+// Streams and events for backends whose device work runs on host threads
+// (CPU and the simulated accelerator). Each stream owns a worker thread that
+// runs its tasks in submission order; synchronous calls behave like the
+// legacy default stream and first wait for every stream of the device.
+
+infinirtStatus_t synchronizeHostDevice(DeviceType device, uint32_t deviceId);
+// Device synchronization for synchronous calls. Skipped on stream workers,
+// where host functions must not wait for their own stream.
+void implicitHostSynchronize(DeviceType device, uint32_t deviceId);
+
+infinirtStatus_t createHostStream(infinirtStream_t *pStream, DeviceType device, uint32_t deviceId);
+infinirtStatus_t destroyHostStream(infinirtStream_t stream);
+infinirtStatus_t synchronizeHostStream(infinirtStream_t stream);
+infinirtStatus_t launchHostStreamFunc(infinirtStream_t stream, void (*fn)(void *), void *userData);
+// Queues `task` behind the stream's pending work.
+void enqueueHostTask(infinirtStream_t stream, std::function<void()> task);
+
+infinirtStatus_t createHostEvent(infinirtEvent_t *pEvent, DeviceType device, uint32_t deviceId, uint32_t flags);
+infinirtStatus_t destroyHostEvent(infinirtEvent_t event);
+infinirtStatus_t waitHostEvent(infinirtEvent_t event, infinirtStream_t stream);
+infinirtStatus_t recordHostEvent(infinirtEvent_t event, infinirtStream_t stream);
+infinirtStatus_t queryHostEvent(infinirtEvent_t event);
+infinirtStatus_t synchronizeHostEvent(infinirtEvent_t event);
+infinirtStatus_t elapsedHostEvent(infinirtEvent_t start, infinirtEvent_t end, float *ms);
+#endif
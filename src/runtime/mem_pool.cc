@@ -0,0 +1,198 @@
+#include "mem_pool.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+
+#define RETURN_IF_FAILED(EXPR)                                                 \
+    do {                                                                       \
+        infinirtStatus_t status = (EXPR);                                      \
+        if (status != INFINIRT_STATUS_SUCCESS) {                               \
+            return status;                                                     \
+        }                                                                      \
+    } while (0)
+
+namespace {
+constexpr size_t POOL_ALIGN = 512;
+// A cached block is only handed out for requests of at least half its size.
+constexpr size_t MAX_BLOCK_WASTE = 2;
+
+struct Block {
+    void *ptr;
+    size_t size;
+    // Recorded on `stream` when the block is freed; created on first use.
+    infinirtEvent_t event;
+    // Stream that last freed the block, null when it is already idle.
+    infinirtStream_t stream;
+};
+
+struct CachingMemPool {
+    DeviceType device;
+    uint32_t device_id;
+    size_t release_threshold;
+    std::mutex mutex;
+    std::multimap<size_t, Block> cached; // keyed by size
+    std::unordered_map<void *, Block> live;
+    size_t cached_bytes = 0;
+    infinirtMemPoolStats_t stats{};
+};
+
+inline CachingMemPool *getCachingMemPool(infinirtMemPool_t pool) {
+    return static_cast<CachingMemPool *>(pool->pool);
+}
+
+infinirtStatus_t releaseBlock(CachingMemPool *pool, Block &block) {
+    if (block.stream != nullptr) {
+        RETURN_IF_FAILED(infinirtEventSynchronize(block.event));
+    }
+    RETURN_IF_FAILED(infinirtFree(block.ptr, pool->device, pool->device_id));
+    if (block.event != nullptr) {
+        RETURN_IF_FAILED(infinirtEventDestroy(block.event));
+    }
+    pool->stats.reservedCurrent -= block.size;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+// Caller holds the pool mutex. Largest blocks go first.
+infinirtStatus_t releaseCached(CachingMemPool *pool, size_t minBytesToKeep) {
+    while (pool->stats.reservedCurrent > minBytesToKeep &&
+           !pool->cached.empty()) {
+        auto it = std::prev(pool->cached.end());
+        Block block = it->second;
+        pool->cached.erase(it);
+        pool->cached_bytes -= block.size;
+        RETURN_IF_FAILED(releaseBlock(pool, block));
+    }
+    return INFINIRT_STATUS_SUCCESS;
+}
+} // namespace
+
+infinirtStatus_t createCachingMemPool(infinirtMemPool_t *pPool,
+                                      DeviceType device, uint32_t deviceId,
+                                      const infinirtMemPoolConfig_t *config) {
+    auto caching_pool = new CachingMemPool();
+    caching_pool->device = device;
+    caching_pool->device_id = deviceId;
+    caching_pool->release_threshold =
+        config != nullptr ? config->releaseThreshold : SIZE_MAX;
+    infinirtMemPool_t pool = new infinirtMemPool();
+    pool->device = device;
+    pool->device_id = deviceId;
+    pool->pool = caching_pool;
+    *pPool = pool;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t destroyCachingMemPool(infinirtMemPool_t pool) {
+    auto caching_pool = getCachingMemPool(pool);
+    {
+        std::lock_guard<std::mutex> lock(caching_pool->mutex);
+        RETURN_IF_FAILED(releaseCached(caching_pool, 0));
+        // Blocks never returned to the pool are released with it.
+        for (auto &entry : caching_pool->live) {
+            RETURN_IF_FAILED(releaseBlock(caching_pool, entry.second));
+        }
+    }
+    delete caching_pool;
+    delete pool;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t mallocCachingMemPool(void **pMemory, size_t size,
+                                      infinirtMemPool_t pool,
+                                      infinirtStream_t stream) {
+    auto caching_pool = getCachingMemPool(pool);
+    size_t rounded =
+        std::max(POOL_ALIGN, (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN);
+    std::lock_guard<std::mutex> lock(caching_pool->mutex);
+    Block block{nullptr, rounded, nullptr, nullptr};
+    auto it = caching_pool->cached.lower_bound(rounded);
+    if (it != caching_pool->cached.end() &&
+        it->first <= rounded * MAX_BLOCK_WASTE) {
+        auto &cached = it->second;
+        // Work on the freeing stream is already ordered before `stream`.
+        if (cached.stream != nullptr && cached.stream != stream) {
+            if (stream == nullptr) {
+                RETURN_IF_FAILED(infinirtEventSynchronize(cached.event));
+            } else {
+                RETURN_IF_FAILED(infinirtStreamWaitEvent(cached.event, stream));
+            }
+        }
+        block = cached;
+        block.stream = nullptr;
+        caching_pool->cached.erase(it);
+        caching_pool->cached_bytes -= block.size;
+    } else {
+        auto status = infinirtMalloc(&block.ptr, caching_pool->device,
+                                     caching_pool->device_id, rounded);
+        if (status != INFINIRT_STATUS_SUCCESS) {
+            // Out of memory is likely; give the cache back and retry once.
+            RETURN_IF_FAILED(releaseCached(caching_pool, 0));
+            RETURN_IF_FAILED(infinirtMalloc(&block.ptr, caching_pool->device,
+                                            caching_pool->device_id, rounded));
+        }
+        auto &stats = caching_pool->stats;
+        stats.reservedCurrent += rounded;
+        stats.reservedPeak = std::max(stats.reservedPeak, stats.reservedCurrent);
+    }
+    auto &stats = caching_pool->stats;
+    stats.usedCurrent += block.size;
+    stats.usedPeak = std::max(stats.usedPeak, stats.usedCurrent);
+    caching_pool->live[block.ptr] = block;
+    *pMemory = block.ptr;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeCachingMemPool(void *ptr, infinirtMemPool_t pool,
+                                    infinirtStream_t stream) {
+    auto caching_pool = getCachingMemPool(pool);
+    std::lock_guard<std::mutex> lock(caching_pool->mutex);
+    auto it = caching_pool->live.find(ptr);
+    if (it == caching_pool->live.end()) {
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    }
+    auto &block = it->second;
+    if (stream != nullptr) {
+        if (block.event == nullptr) {
+            RETURN_IF_FAILED(infinirtEventCreate(
+                &block.event, caching_pool->device, caching_pool->device_id));
+        }
+        RETURN_IF_FAILED(infinirtEventRecord(block.event, stream));
+    }
+    block.stream = stream;
+    Block freed = block;
+    caching_pool->live.erase(it);
+    caching_pool->stats.usedCurrent -= freed.size;
+
+    if (caching_pool->cached_bytes + freed.size >
+        caching_pool->release_threshold) {
+        // Over the threshold: hand the block back in stream order instead of
+        // caching it.
+        RETURN_IF_FAILED(infinirtFreeAsync(freed.ptr, caching_pool->device,
+                                           caching_pool->device_id, stream));
+        if (freed.event != nullptr) {
+            RETURN_IF_FAILED(infinirtEventDestroy(freed.event));
+        }
+        caching_pool->stats.reservedCurrent -= freed.size;
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    caching_pool->cached.emplace(freed.size, freed);
+    caching_pool->cached_bytes += freed.size;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t trimCachingMemPool(infinirtMemPool_t pool,
+                                    size_t minBytesToKeep) {
+    auto caching_pool = getCachingMemPool(pool);
+    std::lock_guard<std::mutex> lock(caching_pool->mutex);
+    return releaseCached(caching_pool, minBytesToKeep);
+}
+
+infinirtStatus_t getCachingMemPoolStats(infinirtMemPool_t pool,
+                                        infinirtMemPoolStats_t *stats) {
+    auto caching_pool = getCachingMemPool(pool);
+    std::lock_guard<std::mutex> lock(caching_pool->mutex);
+    *stats = caching_pool->stats;
+    return INFINIRT_STATUS_SUCCESS;
+}
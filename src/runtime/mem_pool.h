@@ -0,0 +1,16 @@
+#ifndef INFINIRT_MEM_POOL_H
+#define INFINIRT_MEM_POOL_H
+#include "runtime.h"
+
+// Stream-ordered caching pool built on the plain infinirt allocator, for
+// backends without a native pool. A freed block records an event on the
+// freeing stream; reusing it from another stream makes that stream wait on
+// the event, so no host synchronization is needed on the hot path.
+
+infinirtStatus_t createCachingMemPool(infinirtMemPool_t *pPool, DeviceType device, uint32_t deviceId, const infinirtMemPoolConfig_t *config);
+infinirtStatus_t destroyCachingMemPool(infinirtMemPool_t pool);
+infinirtStatus_t mallocCachingMemPool(void **pMemory, size_t size, infinirtMemPool_t pool, infinirtStream_t stream);
+infinirtStatus_t freeCachingMemPool(void *ptr, infinirtMemPool_t pool, infinirtStream_t stream);
+infinirtStatus_t trimCachingMemPool(infinirtMemPool_t pool, size_t minBytesToKeep);
+infinirtStatus_t getCachingMemPoolStats(infinirtMemPool_t pool, infinirtMemPoolStats_t *stats);
+#endif
@@ -1,92 +1,232 @@
 #include "runtime.h"
-#include "ascend/infinirt_ascend.h"
-#include "cuda/infinirt_cuda.h"
-#include <cstdlib>
-#include <string.h>
+#include "backend.h"
+#include "mem_pool.h"
+#include <atomic>
+#include <dlfcn.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
 
-__C __export infinirtStatus_t infinirtInit(DeviceType device){
-    switch (device){
-        case DEVICE_CPU:
-            return INFINIRT_STATUS_SUCCESS;
-        case DEVICE_NVIDIA:
-            return INFINIRT_STATUS_SUCCESS;
-        case DEVICE_ASCEND:
-            return initAscend();
-        default:
-            return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
+namespace {
+constexpr size_t MAX_DEVICE_TYPES = 16;
+
+// One slot per DeviceType. Built-in backends are present from the start;
+// plugins fill empty slots at infinirtInit or infinirtLoadBackend.
+struct BackendRegistry {
+    std::atomic<const infinirtBackend *> tables[MAX_DEVICE_TYPES];
+    std::mutex mutex;
+
+    BackendRegistry() {
+        for (auto &table : tables) {
+            table.store(nullptr, std::memory_order_relaxed);
+        }
+        tables[DEVICE_CPU].store(getCpuBackend(), std::memory_order_relaxed);
+        tables[DEVICE_SIM].store(getSimBackend(), std::memory_order_relaxed);
+#if defined(ENABLE_NV_GPU) && !defined(ENABLE_RUNTIME_PLUGINS)
+        tables[DEVICE_NVIDIA].store(getCudaBackend(),
+                                    std::memory_order_relaxed);
+#endif
+#if defined(ENABLE_ASCEND_NPU) && !defined(ENABLE_RUNTIME_PLUGINS)
+        tables[DEVICE_ASCEND].store(getAscendBackend(),
+                                    std::memory_order_relaxed);
+#endif
     }
+};
+
+BackendRegistry &registry() {
+    static BackendRegistry instance;
+    return instance;
 }
 
-// Device
-__C infinirtStatus_t infinirtDeviceSynchronize(DeviceType device, uint32_t deviceId){
-    switch (device)
-    {
+// The pool group is all or nothing: once memPoolCreate is set, every pool call
+// goes to the backend instead of the caching pool.
+bool hasCompletePoolGroup(const infinirtBackend *table) {
+    if (table->memPoolCreate == nullptr)
+        return true;
+    return table->memPoolDestroy != nullptr &&
+           table->mallocFromPool != nullptr && table->freeToPool != nullptr &&
+           table->memPoolTrim != nullptr && table->memPoolGetStats != nullptr;
+}
+
+infinirtStatus_t registerBackend(DeviceType device, void *library) {
+    auto entry = reinterpret_cast<infinirtGetBackendFn>(
+        dlsym(library, INFINIRT_BACKEND_ENTRY));
+    if (entry == nullptr)
+        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
+    auto table = entry();
+    if (table == nullptr || table->abiVersion != INFINIRT_BACKEND_ABI_VERSION ||
+        !hasCompletePoolGroup(table))
+        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
+    // The library stays loaded for the life of the process.
+    auto &slot = registry().tables[device];
+    const infinirtBackend *expected = nullptr;
+    if (!slot.compare_exchange_strong(expected, table,
+                                      std::memory_order_acq_rel) &&
+        expected != table)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    return INFINIRT_STATUS_SUCCESS;
+}
+} // namespace
+
+#define DISPATCH(DEVICE, FN, ...)                                              \
+    do {                                                                       \
+        auto backend = getBackend(DEVICE);                                     \
+        if (backend == nullptr || backend->FN == nullptr)                      \
+            return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;                       \
+        return backend->FN(__VA_ARGS__);                                       \
+    } while (0)
+
+// Objects are tagged with the slot they were created through, so calls on
+// them reach the same table even when a plugin was loaded into the slot of
+// another device than the one it was built for.
+#define DISPATCH_CREATE(DEVICE, OBJECT, FN, ...)                               \
+    do {                                                                       \
+        auto backend = getBackend(DEVICE);                                     \
+        if (backend == nullptr || backend->FN == nullptr)                      \
+            return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;                       \
+        auto status = backend->FN(__VA_ARGS__);                                \
+        if (status == INFINIRT_STATUS_SUCCESS)                                 \
+            (*OBJECT)->device = DEVICE;                                        \
+        return status;                                                         \
+    } while (0)
+
+const infinirtBackend *getBackend(DeviceType device) {
+    if ((size_t)device >= MAX_DEVICE_TYPES)
+        return nullptr;
+    return registry().tables[device].load(std::memory_order_acquire);
+}
+
+const char *getDeviceName(DeviceType device) {
+    switch (device) {
     case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
+        return "cpu";
     case DEVICE_NVIDIA:
-        return synchronizeCudaDevice(deviceId);
+        return "nvidia";
+    case DEVICE_CAMBRICON:
+        return "cambricon";
     case DEVICE_ASCEND:
-        return synchronizeAscendDevice(deviceId);
+        return "ascend";
+    case DEVICE_SIM:
+        return "sim";
     default:
+        return nullptr;
+    }
+}
+
+void *openBackendLibrary(DeviceType device) {
+    auto name = getDeviceName(device);
+    if (name == nullptr)
+        return nullptr;
+    auto file = std::string("libinfinirt_") + name + ".so";
+    if (auto dir = getenv("INFINIRT_BACKEND_PATH")) {
+        auto library = dlopen((std::string(dir) + "/" + file).c_str(),
+                              RTLD_NOW | RTLD_LOCAL);
+        if (library != nullptr)
+            return library;
+    }
+    // Plugins are installed next to the runtime.
+    Dl_info self;
+    if (dladdr(reinterpret_cast<void *>(&openBackendLibrary), &self) != 0 &&
+        self.dli_fname != nullptr) {
+        auto path = std::string(self.dli_fname);
+        auto slash = path.rfind('/');
+        if (slash != std::string::npos) {
+            auto library = dlopen((path.substr(0, slash + 1) + file).c_str(),
+                                  RTLD_NOW | RTLD_LOCAL);
+            if (library != nullptr)
+                return library;
+        }
+    }
+    return dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+}
+
+__C infinirtStatus_t infinirtLoadBackend(DeviceType device, const char *path) {
+    if ((size_t)device >= MAX_DEVICE_TYPES)
         return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    void *library = path != nullptr ? dlopen(path, RTLD_NOW | RTLD_LOCAL)
+                                    : openBackendLibrary(device);
+    if (library == nullptr)
+        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
+    return registerBackend(device, library);
+}
+
+__C __export infinirtStatus_t infinirtInit(DeviceType device){
+    if (getBackend(device) == nullptr) {
+        auto status = infinirtLoadBackend(device, nullptr);
+        if (status != INFINIRT_STATUS_SUCCESS)
+            return status;
     }
+    auto backend = getBackend(device);
+    if (backend->init == nullptr)
+        return INFINIRT_STATUS_SUCCESS;
+    return backend->init();
+}
+
+// Device
+__C infinirtStatus_t infinirtDeviceSynchronize(DeviceType device, uint32_t deviceId){
+    DISPATCH(device, deviceSynchronize, deviceId);
+}
+
+__C infinirtStatus_t infinirtDeviceCanAccessPeer(int *canAccessPeer,
+                                                 DeviceType device,
+                                                 uint32_t deviceId,
+                                                 uint32_t peerDeviceId) {
+    if (canAccessPeer == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(device, canAccessPeer, canAccessPeer, deviceId, peerDeviceId);
+}
+
+__C infinirtStatus_t infinirtDeviceEnablePeerAccess(DeviceType device,
+                                                    uint32_t deviceId,
+                                                    uint32_t peerDeviceId) {
+    if (deviceId == peerDeviceId)
+        return INFINIRT_STATUS_SUCCESS;
+    DISPATCH(device, enablePeerAccess, deviceId, peerDeviceId);
 }
 
 // Stream
 __C infinirtStatus_t infinirtStreamCreate(infinirtStream_t *pStream, DeviceType device, uint32_t deviceId)
 {
-    switch (device)
-    {
-    case DEVICE_CPU:
-    {
-        auto stream = new infinirtStream();
-        stream->device = DEVICE_CPU;
-        stream->device_id = 0;
-        stream->stream = nullptr;
-        (*pStream) = stream;
+    DISPATCH_CREATE(device, pStream, streamCreate, pStream, deviceId);
+}
+
+__C infinirtStatus_t infinirtStreamCreateWithPriority(infinirtStream_t *pStream,
+                                                      DeviceType device,
+                                                      uint32_t deviceId,
+                                                      int priority) {
+    auto backend = getBackend(device);
+    if (backend != nullptr && backend->streamCreateWithPriority == nullptr)
+        DISPATCH_CREATE(device, pStream, streamCreate, pStream, deviceId);
+    DISPATCH_CREATE(device, pStream, streamCreateWithPriority, pStream,
+                    deviceId, priority);
+}
+
+__C infinirtStatus_t infinirtDeviceGetStreamPriorityRange(
+    DeviceType device, uint32_t deviceId, int *leastPriority,
+    int *greatestPriority) {
+    if (leastPriority == nullptr || greatestPriority == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    auto backend = getBackend(device);
+    if (backend != nullptr && backend->streamPriorityRange == nullptr) {
+        *leastPriority = 0;
+        *greatestPriority = 0;
         return INFINIRT_STATUS_SUCCESS;
     }
-        
-    case DEVICE_NVIDIA:
-        return createCudaStream(pStream, deviceId);
-    case DEVICE_ASCEND:
-        return createAscendStream(pStream, deviceId);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, streamPriorityRange, deviceId, leastPriority,
+             greatestPriority);
 }
 __C infinirtStatus_t infinirtStreamDestroy(infinirtStream_t stream)
 {
     if (stream == nullptr)
         return INFINIRT_STATUS_SUCCESS;
-    switch (stream->device)
-    {
-    case DEVICE_CPU:
-        delete stream;
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return destoryCudaStream(stream);
-    case DEVICE_ASCEND:
-        return destoryAscendStream(stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(stream->device, streamDestroy, stream);
 }
 
 __C infinirtStatus_t infinirtStreamSynchronize(infinirtStream_t stream){
     if (stream == nullptr)
         return INFINIRT_STATUS_SUCCESS;
-    switch (stream->device)
-    {
-    case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return synchronizeCudaStream(stream);
-    case DEVICE_ASCEND:
-        return synchronizeAscendStream(stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(stream->device, streamSynchronize, stream);
 }
 
 __C infinirtStatus_t infinirtGetRawStream(void **ptr, infinirtStream_t stream) {
@@ -110,28 +250,31 @@ __C infinirtStatus_t infinirtGetStreamDeviceInfo(DeviceType *deviceType,
     return INFINIRT_STATUS_SUCCESS;
 }
 
+__C infinirtStatus_t infinirtLaunchHostFunc(infinirtStream_t stream,
+                                            void (*fn)(void *),
+                                            void *userData) {
+    if (fn == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (stream == nullptr) {
+        fn(userData);
+        return INFINIRT_STATUS_SUCCESS;
+    }
+    DISPATCH(stream->device, launchHostFunc, stream, fn, userData);
+}
+
 // Event
 __C infinirtStatus_t infinirtEventCreate(infinirtEvent_t *pEvent, DeviceType device, uint32_t deviceId)
 {
-    switch (device)
-    {
-    case DEVICE_CPU:
-    {
-        auto event = new infinirtEvent();
-        event->device = DEVICE_CPU;
-        event->device_id = 0;
-        event->event = nullptr;
-        (*pEvent) = event;
-        return INFINIRT_STATUS_SUCCESS;
-    }
-        
-    case DEVICE_NVIDIA:
-        return createCudaEvent(pEvent, deviceId);
-    case DEVICE_ASCEND:
-        return createAscendEvent(pEvent, deviceId);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    return infinirtEventCreateWithFlags(pEvent, device, deviceId,
+                                        INFINIRT_EVENT_DEFAULT);
+}
+__C infinirtStatus_t infinirtEventCreateWithFlags(infinirtEvent_t *pEvent,
+                                                  DeviceType device,
+                                                  uint32_t deviceId,
+                                                  uint32_t flags) {
+    if (pEvent == nullptr || (flags & ~INFINIRT_EVENT_ENABLE_TIMING) != 0)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH_CREATE(device, pEvent, eventCreate, pEvent, deviceId, flags);
 }
 __C infinirtStatus_t infinirtEventRecord(infinirtEvent_t event,
                                          infinirtStream_t stream) {
@@ -139,61 +282,23 @@ __C infinirtStatus_t infinirtEventRecord(infinirtEvent_t event,
         return INFINIRT_STATUS_INVALID_ARGUMENT;
     if (stream != nullptr && event->device != stream->device)
         return INFINIRT_STATUS_DEVICE_MISMATCH;
-    switch (event->device) {
-    case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return recordCudaEvent(event, stream);
-    case DEVICE_ASCEND:
-        return recordAscendEvent(event, stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(event->device, eventRecord, event, stream);
 }
 __C infinirtStatus_t infinirtEventQuery(infinirtEvent_t event) {
     if (event == nullptr)
         return INFINIRT_STATUS_INVALID_ARGUMENT;
-    switch (event->device) {
-    case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return queryCudaEvent(event);
-    case DEVICE_ASCEND:
-        return queryAscendEvent(event);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(event->device, eventQuery, event);
 }
 __C infinirtStatus_t infinirtEventSynchronize(infinirtEvent_t event) {
     if (event == nullptr)
         return INFINIRT_STATUS_INVALID_ARGUMENT;
-    switch (event->device) {
-    case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return synchronizeCudaEvent(event);
-    case DEVICE_ASCEND:
-        return synchronizeAscendEvent(event);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(event->device, eventSynchronize, event);
 }
 __C infinirtStatus_t infinirtEventDestroy(infinirtEvent_t event)
 {
     if (event == nullptr)
         return INFINIRT_STATUS_SUCCESS;
-    switch (event->device)
-    {
-    case DEVICE_CPU:
-        delete event;
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return destoryCudaEvent(event);
-    case DEVICE_ASCEND:
-        return destoryAscendEvent(event);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(event->device, eventDestroy, event);
 }
 __C infinirtStatus_t infinirtStreamWaitEvent(infinirtEvent_t event, infinirtStream_t stream)
 {
@@ -202,34 +307,25 @@ __C infinirtStatus_t infinirtStreamWaitEvent(infinirtEvent_t event, infinirtStre
     if (stream != nullptr && (event->device != stream->device ||
                               stream->device_id != event->device_id))
         return INFINIRT_STATUS_DEVICE_MISMATCH;
-    switch (event->device)
-    {
-    case DEVICE_CPU:
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return waitCudaEvent(event, stream);
-    case DEVICE_ASCEND:
-        return waitAscendEvent(event, stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(event->device, streamWaitEvent, event, stream);
+}
+
+__C infinirtStatus_t infinirtEventElapsedTime(infinirtEvent_t start,
+                                              infinirtEvent_t end, float *ms) {
+    if (ms == nullptr || start == nullptr || end == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (start->device != end->device || start->device_id != end->device_id)
+        return INFINIRT_STATUS_DEVICE_MISMATCH;
+    if (!(start->flags & INFINIRT_EVENT_ENABLE_TIMING) ||
+        !(end->flags & INFINIRT_EVENT_ENABLE_TIMING))
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(start->device, eventElapsedTime, start, end, ms);
 }
 
 // Memory
 __C infinirtStatus_t infinirtMalloc(void **pMemory, DeviceType device,
                                     uint32_t deviceId, size_t size) {
-    switch (device)
-    {
-    case DEVICE_CPU:
-        *pMemory = std::malloc(size);
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return mallocCuda(pMemory, deviceId, size);
-    case DEVICE_ASCEND:
-        return mallocAscend(pMemory, deviceId, size);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, mallocDevice, pMemory, deviceId, size);
 }
 
 __C infinirtStatus_t infinirtMallocAsync(void **pMemory, DeviceType device,
@@ -238,50 +334,21 @@ __C infinirtStatus_t infinirtMallocAsync(void **pMemory, DeviceType device,
     if (stream != nullptr &&
         (device != stream->device || deviceId != stream->device_id))
         return INFINIRT_STATUS_DEVICE_MISMATCH;
-    switch (device)
-    {
-    case DEVICE_CPU:
-        return infinirtMalloc(pMemory, device, deviceId, size);
-    case DEVICE_NVIDIA:
-        return mallocCudaAsync(pMemory, deviceId, size, stream);
-    case DEVICE_ASCEND:
-        return mallocAscendAsync(pMemory, deviceId, size, stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, mallocDeviceAsync, pMemory, deviceId, size, stream);
 }
 
 __C __export infinirtStatus_t infinirtMallocHost(void **pMemory,
                                                  DeviceType device,
                                                  uint32_t deviceId,
                                                  size_t size) {
-    switch (device) {
-    case DEVICE_CPU:
-        return infinirtMalloc(pMemory, device, deviceId, size);
-    case DEVICE_NVIDIA:
-        return mallocHostCuda(pMemory, deviceId, size);
-    case DEVICE_ASCEND:
-        return mallocHostAscend(pMemory, deviceId, size);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, mallocHost, pMemory, deviceId, size);
 }
 
 __C infinirtStatus_t infinirtFree(void *ptr, DeviceType device,
                                   uint32_t deviceId) {
     if (ptr == nullptr)
         return INFINIRT_STATUS_SUCCESS;
-    switch (device) {
-    case DEVICE_CPU:
-        std::free(ptr);
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return freeCuda(ptr, deviceId);
-    case DEVICE_ASCEND:
-        return freeAscend(ptr, deviceId);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, freeDevice, ptr, deviceId);
 }
 
 __C infinirtStatus_t infinirtFreeAsync(void *ptr, DeviceType device,
@@ -294,32 +361,28 @@ __C infinirtStatus_t infinirtFreeAsync(void *ptr, DeviceType device,
     } else if (device != stream->device || deviceId != stream->device_id) {
         return INFINIRT_STATUS_DEVICE_MISMATCH;
     }
-    switch (device) {
-    case DEVICE_CPU:
-        return infinirtFree(ptr, device, deviceId);
-    case DEVICE_NVIDIA:
-        return freeCudaAsync(ptr, deviceId, stream);
-    case DEVICE_ASCEND:
-        return freeAscendAsync(ptr, deviceId, stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, freeDeviceAsync, ptr, deviceId, stream);
 }
 
 __C __export infinirtStatus_t infinirtFreeHost(void *ptr, DeviceType device,
                                                uint32_t deviceId) {
     if (ptr == nullptr)
         return INFINIRT_STATUS_SUCCESS;
-    switch (device) {
-    case DEVICE_CPU:
-        return infinirtFree(ptr, device, deviceId);
-    case DEVICE_NVIDIA:
-        return freeHostCuda(ptr, deviceId);
-    case DEVICE_ASCEND:
-        return freeHostAscend(ptr, deviceId);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, freeHost, ptr, deviceId);
+}
+
+__C infinirtStatus_t infinirtHostRegister(void *ptr, DeviceType device,
+                                          uint32_t deviceId, size_t size) {
+    if (ptr == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(device, hostRegister, ptr, deviceId, size);
+}
+
+__C infinirtStatus_t infinirtHostUnregister(void *ptr, DeviceType device,
+                                            uint32_t deviceId) {
+    if (ptr == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(device, hostUnregister, ptr, deviceId);
 }
 
 __C infinirtStatus_t infinirtMemcpyH2D(void *dst, DeviceType device,
@@ -327,18 +390,7 @@ __C infinirtStatus_t infinirtMemcpyH2D(void *dst, DeviceType device,
                                             size_t size) {
     if (dst == nullptr || src == nullptr)
         return INFINIRT_STATUS_INVALID_ARGUMENT;
-
-    switch (device) {
-    case DEVICE_CPU:
-        memcpy(dst, src, size);
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return memcpyHost2Cuda(dst, deviceId, src, size);
-    case DEVICE_ASCEND:
-        return memcpyHost2Ascend(dst, deviceId, src, size);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, memcpyH2D, dst, deviceId, src, size);
 }
 
 __C infinirtStatus_t infinirtMemcpyH2DAsync(void *dst, DeviceType device,
@@ -350,17 +402,7 @@ __C infinirtStatus_t infinirtMemcpyH2DAsync(void *dst, DeviceType device,
     if (stream != nullptr &&
         (device != stream->device || deviceId != stream->device_id))
         return INFINIRT_STATUS_DEVICE_MISMATCH;
-
-    switch (device) {
-    case DEVICE_CPU:
-        return infinirtMemcpyH2D(dst, device, deviceId, src, size);
-    case DEVICE_NVIDIA:
-        return memcpyHost2CudaAsync(dst, deviceId, src, size, stream);
-    case DEVICE_ASCEND:
-        return memcpyHost2AscendAsync(dst, deviceId, src, size, stream);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, memcpyH2DAsync, dst, deviceId, src, size, stream);
 }
 
 __C infinirtStatus_t infinirtMemcpyD2H(void *dst, const void *src,
@@ -368,18 +410,19 @@ __C infinirtStatus_t infinirtMemcpyD2H(void *dst, const void *src,
                                        size_t size) {
     if (src == nullptr || dst == nullptr)
         return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(device, memcpyD2H, dst, src, deviceId, size);
+}
 
-    switch (device) {
-    case DEVICE_CPU:
-        memcpy(dst, src, size);
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return memcpyCuda2Host(dst, src, deviceId, size);
-    case DEVICE_ASCEND:
-        return memcpyAscend2Host(dst, src, deviceId, size);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+__C infinirtStatus_t infinirtMemcpyD2HAsync(void *dst, const void *src,
+                                            DeviceType device,
+                                            uint32_t deviceId, size_t size,
+                                            infinirtStream_t stream) {
+    if (src == nullptr || dst == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (stream != nullptr &&
+        (device != stream->device || deviceId != stream->device_id))
+        return INFINIRT_STATUS_DEVICE_MISMATCH;
+    DISPATCH(device, memcpyD2HAsync, dst, src, deviceId, size, stream);
 }
 
 __C __export infinirtStatus_t infinirtMemcpy(void *dst, const void *src,
@@ -389,17 +432,7 @@ __C __export infinirtStatus_t infinirtMemcpy(void *dst, const void *src,
         return INFINIRT_STATUS_SUCCESS;
     if (dst == nullptr || src == nullptr)
         return INFINIRT_STATUS_INVALID_ARGUMENT;
-    switch (device) {
-    case DEVICE_CPU:
-        memcpy(dst, src, size);
-        return INFINIRT_STATUS_SUCCESS;
-    case DEVICE_NVIDIA:
-        return memcpyCuda(dst, src, deviceId, size);
-    case DEVICE_ASCEND:
-        return memcpyAscend(dst, src, deviceId, size);
-    default:
-        return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    DISPATCH(device, memcpyD2D, dst, src, deviceId, size);
 }
 
 __C __export infinirtStatus_t infinirtMemcpyAsync(void *dst, const void *src,
@@ -414,15 +447,102 @@ __C __export infinirtStatus_t infinirtMemcpyAsync(void *dst, const void *src,
     if (stream != nullptr &&
         (device != stream->device || deviceId != stream->device_id))
         return INFINIRT_STATUS_DEVICE_MISMATCH;
+    DISPATCH(device, memcpyD2DAsync, dst, src, deviceId, size, stream);
+}
 
-    switch (device) {
-    case DEVICE_CPU:
-        return infinirtMemcpy(dst, src, device, deviceId, size);
-    case DEVICE_NVIDIA:
-        return memcpyCudaAsync(dst, src, deviceId, size, stream);
-    case DEVICE_ASCEND:
-        return memcpyAscendAsync(dst, src, deviceId, size, stream);
-    default:
+__C infinirtStatus_t infinirtMemcpyPeer(void *dst, uint32_t dstDeviceId,
+                                        const void *src, uint32_t srcDeviceId,
+                                        DeviceType device, size_t size) {
+    if (dst == nullptr || src == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH(device, memcpyPeer, dst, dstDeviceId, src, srcDeviceId, size);
+}
+
+__C infinirtStatus_t infinirtMemcpyPeerAsync(void *dst, uint32_t dstDeviceId,
+                                             const void *src,
+                                             uint32_t srcDeviceId,
+                                             DeviceType device, size_t size,
+                                             infinirtStream_t stream) {
+    if (dst == nullptr || src == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (stream != nullptr &&
+        (device != stream->device || (stream->device_id != dstDeviceId &&
+                                      stream->device_id != srcDeviceId)))
+        return INFINIRT_STATUS_DEVICE_MISMATCH;
+    DISPATCH(device, memcpyPeerAsync, dst, dstDeviceId, src, srcDeviceId, size,
+             stream);
+}
+
+// Memory pool
+// Backends without a native stream-ordered pool get the caching pool.
+#define DISPATCH_POOL(DEVICE, FN, FALLBACK, ...)                               \
+    do {                                                                       \
+        auto backend = getBackend(DEVICE);                                     \
+        if (backend == nullptr)                                                \
+            return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;                       \
+        if (backend->memPoolCreate == nullptr)                                 \
+            return FALLBACK(__VA_ARGS__);                                      \
+        if (backend->FN == nullptr)                                            \
+            return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;                       \
+        return backend->FN(__VA_ARGS__);                                       \
+    } while (0)
+
+__C infinirtStatus_t infinirtMemPoolCreate(infinirtMemPool_t *pPool,
+                                           DeviceType device, uint32_t deviceId,
+                                           const infinirtMemPoolConfig_t *config) {
+    if (pPool == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    auto backend = getBackend(device);
+    if (backend == nullptr)
         return INFINIRT_STATUS_DEVICE_NOT_SUPPORTED;
-    }
+    if (backend->memPoolCreate == nullptr)
+        return createCachingMemPool(pPool, device, deviceId, config);
+    DISPATCH_CREATE(device, pPool, memPoolCreate, pPool, deviceId, config);
+}
+
+__C infinirtStatus_t infinirtMemPoolDestroy(infinirtMemPool_t pool) {
+    if (pool == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH_POOL(pool->device, memPoolDestroy, destroyCachingMemPool, pool);
+}
+
+__C infinirtStatus_t infinirtMallocFromPoolAsync(void **pMemory, size_t size,
+                                                 infinirtMemPool_t pool,
+                                                 infinirtStream_t stream) {
+    if (pMemory == nullptr || pool == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (stream != nullptr && (pool->device != stream->device ||
+                              pool->device_id != stream->device_id))
+        return INFINIRT_STATUS_DEVICE_MISMATCH;
+    DISPATCH_POOL(pool->device, mallocFromPool, mallocCachingMemPool, pMemory,
+                  size, pool, stream);
+}
+
+__C infinirtStatus_t infinirtFreeToPoolAsync(void *ptr, infinirtMemPool_t pool,
+                                             infinirtStream_t stream) {
+    if (pool == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    if (ptr == nullptr)
+        return INFINIRT_STATUS_SUCCESS;
+    if (stream != nullptr && (pool->device != stream->device ||
+                              pool->device_id != stream->device_id))
+        return INFINIRT_STATUS_DEVICE_MISMATCH;
+    DISPATCH_POOL(pool->device, freeToPool, freeCachingMemPool, ptr, pool,
+                  stream);
+}
+
+__C infinirtStatus_t infinirtMemPoolTrim(infinirtMemPool_t pool,
+                                         size_t minBytesToKeep) {
+    if (pool == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH_POOL(pool->device, memPoolTrim, trimCachingMemPool, pool,
+                  minBytesToKeep);
+}
+
+__C infinirtStatus_t infinirtMemPoolGetStats(infinirtMemPool_t pool,
+                                             infinirtMemPoolStats_t *stats) {
+    if (pool == nullptr || stats == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    DISPATCH_POOL(pool->device, memPoolGetStats, getCachingMemPoolStats, pool,
+                  stats);
 }
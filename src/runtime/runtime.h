@@ -13,6 +13,13 @@ struct infinirtStream{
 struct infinirtEvent{
     DeviceType device;
     uint32_t device_id;
+    uint32_t flags;
     void* event;
 };
+
+struct infinirtMemPool{
+    DeviceType device;
+    uint32_t device_id;
+    void* pool;
+};
 #endif
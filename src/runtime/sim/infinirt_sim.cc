@@ -0,0 +1,318 @@
+#include "infinirt_sim.h"
+#include "../backend.h"
+#include "../cpu/infinirt_cpu.h"
+#include "../host_stream.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+double envNumber(const char *name, double fallback) {
+    auto value = getenv(name);
+    return value != nullptr ? atof(value) : fallback;
+}
+
+infinirtSimConfig_t defaultConfig() {
+    infinirtSimConfig_t config;
+    config.h2dBandwidth = envNumber("INFINIRT_SIM_H2D_GBPS", 0) * 1e9;
+    config.d2hBandwidth = envNumber("INFINIRT_SIM_D2H_GBPS", 0) * 1e9;
+    config.d2dBandwidth = envNumber("INFINIRT_SIM_D2D_GBPS", 0) * 1e9;
+    config.launchLatencyUs = (uint32_t)envNumber("INFINIRT_SIM_LAUNCH_US", 0);
+    config.memoryCapacity =
+        (size_t)(envNumber("INFINIRT_SIM_MEMORY_MB", 0) * (1 << 20));
+    return config;
+}
+
+std::mutex config_mutex;
+infinirtSimConfig_t &config() {
+    static infinirtSimConfig_t instance = defaultConfig();
+    return instance;
+}
+
+infinirtSimConfig_t currentConfig() {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return config();
+}
+
+enum class Link { H2D, D2H, D2D };
+
+// Time the device is busy with one operation moving `size` bytes. The cost
+// is taken when the operation is issued so a later config change does not
+// affect work already queued.
+std::chrono::microseconds cost(Link link, size_t size) {
+    auto conf = currentConfig();
+    double bandwidth = link == Link::H2D   ? conf.h2dBandwidth
+                       : link == Link::D2H ? conf.d2hBandwidth
+                                           : conf.d2dBandwidth;
+    double us = conf.launchLatencyUs;
+    if (bandwidth > 0) {
+        us += size / bandwidth * 1e6;
+    }
+    return std::chrono::microseconds((int64_t)us);
+}
+
+inline void occupy(std::chrono::microseconds duration) {
+    if (duration.count() > 0) {
+        std::this_thread::sleep_for(duration);
+    }
+}
+
+// Device allocations, for capacity accounting.
+struct Allocation {
+    uint32_t device_id;
+    size_t size;
+};
+std::mutex memory_mutex;
+std::unordered_map<void *, Allocation> allocations;
+std::map<uint32_t, size_t> used_bytes;
+
+infinirtStatus_t allocate(void **pMemory, uint32_t deviceId, size_t size) {
+    auto capacity = currentConfig().memoryCapacity;
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    auto &used = used_bytes[deviceId];
+    if (capacity != 0 && used + size > capacity) {
+        return INFINIRT_STATUS_OUT_OF_MEMORY;
+    }
+    *pMemory = std::malloc(size);
+    if (*pMemory == nullptr && size != 0) {
+        return INFINIRT_STATUS_OUT_OF_MEMORY;
+    }
+    used += size;
+    allocations[*pMemory] = {deviceId, size};
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+void release(void *ptr) {
+    {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        auto it = allocations.find(ptr);
+        if (it != allocations.end()) {
+            used_bytes[it->second.device_id] -= it->second.size;
+            allocations.erase(it);
+        }
+    }
+    std::free(ptr);
+}
+
+inline void implicitSynchronize(uint32_t deviceId) {
+    implicitHostSynchronize(DEVICE_SIM, deviceId);
+}
+
+infinirtStatus_t copySync(void *dst, const void *src, uint32_t deviceId,
+                          size_t size, Link link) {
+    implicitSynchronize(deviceId);
+    occupy(cost(link, size));
+    std::memcpy(dst, src, size);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t copyAsync(void *dst, const void *src, size_t size,
+                           Link link, infinirtStream_t stream) {
+    auto duration = cost(link, size);
+    enqueueHostTask(stream, [dst, src, size, duration] {
+        occupy(duration);
+        std::memcpy(dst, src, size);
+    });
+    return INFINIRT_STATUS_SUCCESS;
+}
+} // namespace
+
+__C infinirtStatus_t infinirtSimSetConfig(const infinirtSimConfig_t *config_) {
+    if (config_ == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    std::lock_guard<std::mutex> lock(config_mutex);
+    config() = *config_;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+__C infinirtStatus_t infinirtSimGetConfig(infinirtSimConfig_t *config_) {
+    if (config_ == nullptr)
+        return INFINIRT_STATUS_INVALID_ARGUMENT;
+    *config_ = currentConfig();
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t synchronizeSimDevice(uint32_t deviceId) {
+    return synchronizeHostDevice(DEVICE_SIM, deviceId);
+}
+
+// Simulated devices share the host address space.
+infinirtStatus_t canAccessPeerSim(int *canAccessPeer, uint32_t deviceId,
+                                  uint32_t peerDeviceId) {
+    *canAccessPeer = 1;
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t enablePeerAccessSim(uint32_t deviceId,
+                                     uint32_t peerDeviceId) {
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t createSimStream(infinirtStream_t *pStream, uint32_t deviceId) {
+    return createHostStream(pStream, DEVICE_SIM, deviceId);
+}
+
+// Host functions stand in for kernels, so they pay the launch latency.
+infinirtStatus_t launchSimHostFunc(infinirtStream_t stream, void (*fn)(void *),
+                                   void *userData) {
+    if (stream == nullptr) {
+        return launchHostStreamFunc(stream, fn, userData);
+    }
+    auto latency = std::chrono::microseconds(currentConfig().launchLatencyUs);
+    enqueueHostTask(stream, [fn, userData, latency] {
+        occupy(latency);
+        fn(userData);
+    });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t createSimEvent(infinirtEvent_t *pEvent, uint32_t deviceId,
+                                uint32_t flags) {
+    return createHostEvent(pEvent, DEVICE_SIM, deviceId, flags);
+}
+
+infinirtStatus_t mallocSim(void **pMemory, uint32_t deviceId, size_t size) {
+    return allocate(pMemory, deviceId, size);
+}
+
+// Capacity is charged when the allocation is issued and returned when the
+// stream reaches the free, like a stream-ordered allocator without a cache.
+infinirtStatus_t mallocSimAsync(void **pMemory, uint32_t deviceId, size_t size,
+                                infinirtStream_t stream) {
+    return allocate(pMemory, deviceId, size);
+}
+
+infinirtStatus_t mallocHostSim(void **pMemory, uint32_t deviceId, size_t size) {
+    *pMemory = std::malloc(size);
+    if (*pMemory == nullptr && size != 0) {
+        return INFINIRT_STATUS_OUT_OF_MEMORY;
+    }
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeSim(void *ptr, uint32_t deviceId) {
+    implicitSynchronize(deviceId);
+    release(ptr);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeSimAsync(void *ptr, uint32_t deviceId,
+                              infinirtStream_t stream) {
+    enqueueHostTask(stream, [ptr] { release(ptr); });
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t freeHostSim(void *ptr, uint32_t deviceId) {
+    implicitSynchronize(deviceId);
+    std::free(ptr);
+    return INFINIRT_STATUS_SUCCESS;
+}
+
+infinirtStatus_t memcpyHost2Sim(void *dst, uint32_t deviceId, const void *src,
+                                size_t size) {
+    return copySync(dst, src, deviceId, size, Link::H2D);
+}
+
+infinirtStatus_t memcpyHost2SimAsync(void *dst, uint32_t deviceId,
+                                     const void *src, size_t size,
+                                     infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpyHost2Sim(dst, deviceId, src, size);
+    }
+    return copyAsync(dst, src, size, Link::H2D, stream);
+}
+
+infinirtStatus_t memcpySim2Host(void *dst, const void *src, uint32_t deviceId,
+                                size_t size) {
+    return copySync(dst, src, deviceId, size, Link::D2H);
+}
+
+infinirtStatus_t memcpySim2HostAsync(void *dst, const void *src,
+                                     uint32_t deviceId, size_t size,
+                                     infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpySim2Host(dst, src, deviceId, size);
+    }
+    return copyAsync(dst, src, size, Link::D2H, stream);
+}
+
+infinirtStatus_t memcpySim(void *dst, const void *src, uint32_t deviceId,
+                           size_t size) {
+    return copySync(dst, src, deviceId, size, Link::D2D);
+}
+
+infinirtStatus_t memcpySimAsync(void *dst, const void *src, uint32_t deviceId,
+                                size_t size, infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpySim(dst, src, deviceId, size);
+    }
+    return copyAsync(dst, src, size, Link::D2D, stream);
+}
+
+infinirtStatus_t memcpyPeerSim(void *dst, uint32_t dstDeviceId,
+                               const void *src, uint32_t srcDeviceId,
+                               size_t size) {
+    if (dstDeviceId != srcDeviceId) {
+        implicitSynchronize(dstDeviceId);
+    }
+    return copySync(dst, src, srcDeviceId, size, Link::D2D);
+}
+
+infinirtStatus_t memcpyPeerSimAsync(void *dst, uint32_t dstDeviceId,
+                                    const void *src, uint32_t srcDeviceId,
+                                    size_t size, infinirtStream_t stream) {
+    if (stream == nullptr) {
+        return memcpyPeerSim(dst, dstDeviceId, src, srcDeviceId, size);
+    }
+    return copyAsync(dst, src, size, Link::D2D, stream);
+}
+
+const infinirtBackend *getSimBackend() {
+    static const infinirtBackend backend = [] {
+        infinirtBackend table{};
+        table.abiVersion = INFINIRT_BACKEND_ABI_VERSION;
+        table.deviceSynchronize = synchronizeSimDevice;
+        table.canAccessPeer = canAccessPeerSim;
+        table.enablePeerAccess = enablePeerAccessSim;
+        table.streamCreate = createSimStream;
+        table.streamDestroy = destroyHostStream;
+        table.streamSynchronize = synchronizeHostStream;
+        table.launchHostFunc = launchSimHostFunc;
+        table.eventCreate = createSimEvent;
+        table.eventDestroy = destroyHostEvent;
+        table.streamWaitEvent = waitHostEvent;
+        table.eventRecord = recordHostEvent;
+        table.eventQuery = queryHostEvent;
+        table.eventSynchronize = synchronizeHostEvent;
+        table.eventElapsedTime = elapsedHostEvent;
+        table.mallocDevice = mallocSim;
+        table.mallocDeviceAsync = mallocSimAsync;
+        table.mallocHost = mallocHostSim;
+        table.freeDevice = freeSim;
+        table.freeDeviceAsync = freeSimAsync;
+        table.freeHost = freeHostSim;
+        // Registration only bookkeeps and pins the range, as on CPU.
+        table.hostRegister = registerHostCpu;
+        table.hostUnregister = unregisterHostCpu;
+        table.memcpyH2D = memcpyHost2Sim;
+        table.memcpyH2DAsync = memcpyHost2SimAsync;
+        table.memcpyD2H = memcpySim2Host;
+        table.memcpyD2HAsync = memcpySim2HostAsync;
+        table.memcpyD2D = memcpySim;
+        table.memcpyD2DAsync = memcpySimAsync;
+        table.memcpyPeer = memcpyPeerSim;
+        table.memcpyPeerAsync = memcpyPeerSimAsync;
+        return table;
+    }();
+    return &backend;
+}
+
+#ifdef INFINIRT_BACKEND_PLUGIN
+__C __export const infinirtBackend *infinirtGetBackend() {
+    return getSimBackend();
+}
+#endif
@@ -0,0 +1,40 @@
+#ifndef INFINIRT_SIM_H
+#define INFINIRT_SIM_H
+#include "../runtime.h"
+
+// The simulated backend is always built. Streams and events are the
+// host-thread implementation in host_stream.h; copies and stream work are
+// delayed according to infinirtSimConfig_t, and allocations are charged
+// against the per-device capacity.
+//
+// Only work issued through infinirt is modeled. Operators run with the CPU
+// implementation, which ignores the stream: a kernel executes synchronously
+// on the calling thread, pays no launch latency and does not wait for, or
+// overlap with, copies still queued on its stream. Callers reading a buffer
+// an async copy fills, or writing one it reads, must synchronize first, as
+// on DEVICE_CPU.
+
+infinirtStatus_t synchronizeSimDevice(uint32_t deviceId);
+infinirtStatus_t canAccessPeerSim(int *canAccessPeer, uint32_t deviceId, uint32_t peerDeviceId);
+infinirtStatus_t enablePeerAccessSim(uint32_t deviceId, uint32_t peerDeviceId);
+
+infinirtStatus_t createSimStream(infinirtStream_t *pStream, uint32_t deviceId);
+infinirtStatus_t launchSimHostFunc(infinirtStream_t stream, void (*fn)(void *), void *userData);
+
+infinirtStatus_t createSimEvent(infinirtEvent_t *pEvent, uint32_t deviceId, uint32_t flags);
+
+infinirtStatus_t mallocSim(void **pMemory, uint32_t deviceId, size_t size);
+infinirtStatus_t mallocSimAsync(void **pMemory, uint32_t deviceId, size_t size, infinirtStream_t stream);
+infinirtStatus_t mallocHostSim(void **pMemory, uint32_t deviceId, size_t size);
+infinirtStatus_t freeSim(void *ptr, uint32_t deviceId);
+infinirtStatus_t freeSimAsync(void *ptr, uint32_t deviceId, infinirtStream_t stream);
+infinirtStatus_t freeHostSim(void *ptr, uint32_t deviceId);
+infinirtStatus_t memcpyHost2Sim(void *dst, uint32_t deviceId, const void *src, size_t size);
+infinirtStatus_t memcpyHost2SimAsync(void *dst, uint32_t deviceId, const void *src, size_t size, infinirtStream_t stream);
+infinirtStatus_t memcpySim2Host(void *dst, const void *src, uint32_t deviceId, size_t size);
+infinirtStatus_t memcpySim2HostAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream);
+infinirtStatus_t memcpySim(void *dst, const void *src, uint32_t deviceId, size_t size);
+infinirtStatus_t memcpySimAsync(void *dst, const void *src, uint32_t deviceId, size_t size, infinirtStream_t stream);
+infinirtStatus_t memcpyPeerSim(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size);
+infinirtStatus_t memcpyPeerSimAsync(void *dst, uint32_t dstDeviceId, const void *src, uint32_t srcDeviceId, size_t size, infinirtStream_t stream);
+#endif
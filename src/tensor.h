@@ -3,12 +3,85 @@
 
 #include "infini_infer.h"
 #include "utils.h"
+#include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string> 
 typedef uint64_t index_t;
 typedef int64_t stride_t;
 
+// Memory one model holds on one device, by category.
+class MemoryAccount
+{
+  public:
+    void charge(MemoryCategory category, size_t size);
+    void release(MemoryCategory category, size_t size);
+    MemoryStats stats();
+
+  private:
+    std::mutex _mutex;
+    MemoryStats _stats{};
+};
+
+struct MemoryTag
+{
+    // Null for storages created outside any MemoryScope.
+    std::shared_ptr<MemoryAccount> account;
+    MemoryCategory category;
+    // 0 for the model itself, otherwise the id of the owning KV or prefix
+    // cache.
+    uint64_t owner;
+};
+
+// Tags every storage created on this thread while it is alive. Scopes nest;
+// the innermost one wins.
+class MemoryScope
+{
+  public:
+    MemoryScope(std::shared_ptr<MemoryAccount> account, MemoryCategory category,
+                uint64_t owner = 0);
+    ~MemoryScope();
+
+  private:
+    MemoryTag _saved;
+};
+
+// Host ranges pinned by upload_from_host, kept registered until the last
+// reference goes away so a buffer copied to several devices is registered
+// once. Ranges that were already registered elsewhere are used but never
+// unregistered here.
+class HostPins
+{
+  public:
+    ~HostPins();
+    // Registers [src, src + size) unless a cached range covers it.
+    void pin(void *src, size_t size, DeviceType device, uint32_t device_id);
+
+  private:
+    struct Range
+    {
+        size_t size;
+        DeviceType device;
+        uint32_t device_id;
+        bool owned;
+    };
+    std::mutex _mutex;
+    std::map<uintptr_t, Range> _ranges;
+};
+
+// Caches the pins of every upload_from_host on this thread while it is alive.
+// Scopes nest; the innermost one wins.
+class HostPinScope
+{
+  public:
+    explicit HostPinScope(std::shared_ptr<HostPins> pins);
+    ~HostPinScope();
+
+  private:
+    std::shared_ptr<HostPins> _saved;
+};
+
 struct Storage
 {
     void *memory;
@@ -16,9 +89,20 @@ struct Storage
     DeviceType device;
     uint32_t deviceId;
     infinirtEvent_t event;
+    // Stream of a stream-ordered allocation, which is also released on it.
+    // Work on other streams must be ordered before that stream by the owner,
+    // and the stream must outlive the storage.
+    infinirtStream_t stream;
+    // Base and length of a file mapping backing `memory`, released with
+    // munmap instead of infinirtFree. Null for ordinary allocations.
+    void *mapping;
+    size_t mapping_size;
+    // Charged to `tag.account` for the lifetime of the storage.
+    MemoryTag tag;
 
     static std::shared_ptr<Storage> create(size_t size, DeviceType device, uint32_t device_id);
     static std::shared_ptr<Storage> createAsync(size_t size, DeviceType device, uint32_t device_id, infinirtStream_t stream = nullptr);
+    static std::shared_ptr<Storage> createMapped(void *mapping, size_t mapping_size, size_t offset, size_t size);
     ~Storage();
 };
 
@@ -63,6 +147,9 @@ public:
   static std::shared_ptr<Tensor> weight(void *data, InfiniDataType_t dtype,
                                         const std::vector<index_t> &shape,
                                         DeviceType device, uint32_t device_id);
+  // Reads a snapshot written by save(). CPU tensors map the file directly.
+  static std::shared_ptr<Tensor> load(const std::string &filename,
+                                      DeviceType device, uint32_t device_id);
   std::shared_ptr<Tensor> slice(size_t dim, size_t start, size_t len);
   std::shared_ptr<Tensor const> slice(size_t dim, size_t start,
                                       size_t len) const;
@@ -90,12 +177,33 @@ public:
   uint32_t device_id() const;
   bool is_contigous() const;
 
+  // Writes the view's elements, row-major, into a self-describing snapshot.
+  void save(const std::string &filename) const;
   void debug(const std::string &filename) const;
   void debug() const;
 
   ~Tensor();
 };
 
+// Host-side strided copy between two views of the same shape. Strides are in
+// elements. Dimensions that are contiguous in both layouts are collapsed,
+// dense inner runs use memcpy and large copies are split across threads.
+void strided_copy(void *dst, const std::vector<stride_t> &dst_strides,
+                  void const *src, const std::vector<stride_t> &src_strides,
+                  const std::vector<index_t> &shape, size_t elem_size);
+
+// Synchronous upload from caller-owned pageable memory. Large ranges are
+// pinned in place when the backend allows it: through the current
+// HostPinScope if there is one, otherwise just for this copy.
+void upload_from_host(void *dst, DeviceType device, uint32_t device_id,
+                      void *src, size_t size);
+
+// Operators for these devices run on the calling thread on host-addressable
+// memory, so they wait for pending stream work on the host.
+inline bool runs_on_host(DeviceType device) {
+    return device == DEVICE_CPU || device == DEVICE_SIM;
+}
+
 inline size_t dt_size(InfiniDataType_t dtype) {
     switch (dtype) {
     case INFINI_F16:
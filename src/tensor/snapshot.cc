@@ -0,0 +1,187 @@
+#include "../tensor.h"
+#include "../utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot layout (little-endian):
+//   SnapshotHeader | shape: uint64_t[ndim] | padding | data
+// `data` holds the view's elements in row-major order and starts at
+// `data_offset`, aligned to SNAPSHOT_ALIGN so a mapped file can be used in
+// place as tensor storage.
+namespace {
+constexpr char SNAPSHOT_MAGIC[8] = {'I', 'N', 'F', 'T', 'E', 'N', 'S', 'R'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOT_ALIGN = 64;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t ndim;
+    uint32_t reserved;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+bool known_dtype(uint32_t dtype) {
+    return dtype == INFINI_F16 || dtype == INFINI_F32 || dtype == INFINI_U64;
+}
+} // namespace
+
+void Tensor::save(const std::string &filename) const {
+    RUN_INFINI(
+        infinirtDeviceSynchronize(this->device_type(), this->device_id()));
+    auto elem_size = dt_size(this->_dtype);
+    auto ndim = this->ndim();
+    auto empty = std::find(this->_shape.begin(), this->_shape.end(), 0) !=
+                 this->_shape.end();
+
+    std::vector<char> packed(empty ? 0 : this->_size);
+    // An empty view has no span and nothing to copy.
+    if (!empty) {
+        // Element span covered by the view: lo <= 0 <= hi, relative to its
+        // first element.
+        stride_t lo = 0, hi = 0;
+        for (size_t i = 0; i < ndim; i++) {
+            auto extent = (stride_t)(this->_shape[i] - 1) * this->_strides[i];
+            if (extent < 0)
+                lo += extent;
+            else
+                hi += extent;
+        }
+
+        // Only the span is brought to the host, not the whole storage; the
+        // first element sits -lo elements into it.
+        std::vector<char> staging;
+        char const *first;
+        if (this->device_type() == DEVICE_CPU) {
+            first = (char const *)this->_data;
+        } else {
+            auto first_offset = (size_t)(-lo) * elem_size;
+            staging.resize((size_t)(hi - lo + 1) * elem_size);
+            RUN_INFINI(infinirtMemcpyD2H(
+                staging.data(), (char const *)this->_data - first_offset,
+                this->device_type(), this->device_id(), staging.size()));
+            first = staging.data() + first_offset;
+        }
+        auto packed_strides = std::vector<stride_t>(ndim);
+        packed_strides[ndim - 1] = 1;
+        for (int i = ndim - 2; i >= 0; i--) {
+            packed_strides[i] = packed_strides[i + 1] * this->_shape[i + 1];
+        }
+        strided_copy(packed.data(), packed_strides, first, this->_strides,
+                     this->_shape, elem_size);
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.dtype = (uint32_t)this->_dtype;
+    header.ndim = (uint32_t)ndim;
+    auto meta_size = sizeof(SnapshotHeader) + ndim * sizeof(uint64_t);
+    header.data_offset =
+        (meta_size + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+    header.data_size = packed.size();
+
+    std::ofstream outFile(filename, std::ios::binary);
+    if (!outFile) {
+        std::cerr << "Error opening file for writing: " << filename << "\n";
+        return;
+    }
+    auto shape = std::vector<uint64_t>(this->_shape.begin(), this->_shape.end());
+    auto padding = std::vector<char>(header.data_offset - meta_size, 0);
+    outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    outFile.write(reinterpret_cast<const char *>(shape.data()),
+                  shape.size() * sizeof(uint64_t));
+    outFile.write(padding.data(), padding.size());
+    outFile.write(packed.data(), packed.size());
+    outFile.close();
+}
+
+std::shared_ptr<Tensor> Tensor::load(const std::string &filename,
+                                     DeviceType device, uint32_t device_id) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file for reading: " << filename << "\n";
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        std::cerr << "Not a tensor snapshot: " << filename << "\n";
+        close(fd);
+        return nullptr;
+    }
+    size_t file_size = st.st_size;
+    // Private mapping: the tensor may be written without touching the file.
+    void *mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << filename << "\n";
+        return nullptr;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    auto meta_size = sizeof(SnapshotHeader) + header.ndim * sizeof(uint64_t);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.version != SNAPSHOT_VERSION || header.ndim == 0 ||
+        !known_dtype(header.dtype) || meta_size > header.data_offset ||
+        header.data_offset > file_size ||
+        header.data_size > file_size - header.data_offset) {
+        std::cerr << "Not a tensor snapshot: " << filename << "\n";
+        munmap(mapping, file_size);
+        return nullptr;
+    }
+
+    std::shared_ptr<Tensor> tensor = std::make_shared<Tensor>();
+    tensor->_dtype = (InfiniDataType_t)header.dtype;
+    auto shape_ptr = (uint64_t const *)((char const *)mapping +
+                                        sizeof(SnapshotHeader));
+    tensor->_shape = std::vector<index_t>(shape_ptr, shape_ptr + header.ndim);
+    size_t size = dt_size(tensor->_dtype);
+    bool overflow = false;
+    for (auto dim : tensor->_shape) {
+        overflow = overflow || (dim != 0 && size > SIZE_MAX / dim);
+        size *= dim;
+    }
+    if (overflow || size != header.data_size) {
+        std::cerr << "Corrupt tensor snapshot: " << filename << "\n";
+        munmap(mapping, file_size);
+        return nullptr;
+    }
+    auto ndim = tensor->_shape.size();
+    auto strides = std::vector<stride_t>(ndim);
+    strides[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0; i--) {
+        strides[i] = strides[i + 1] * tensor->_shape[i + 1];
+    }
+    tensor->_strides = strides;
+
+    if (device == DEVICE_CPU) {
+        // Pages are faulted in on first touch instead of being copied up front.
+        tensor->storage = Storage::createMapped(mapping, file_size,
+                                                header.data_offset, size);
+    } else {
+        tensor->storage = Storage::create(size, device, device_id);
+        // The mapped pages are pinned in place, so the copy goes straight
+        // from the page cache without a bounce buffer.
+        if (size > 0) {
+            upload_from_host(tensor->storage->memory, device, device_id,
+                             (char *)mapping + header.data_offset, size);
+        }
+        munmap(mapping, file_size);
+    }
+    tensor->_data = tensor->storage->memory;
+    tensor->_size = size;
+    infiniopCreateTensorDescriptor(&tensor->_desc, ndim, tensor->_shape.data(),
+                                   strides.data(), dt_layout(tensor->_dtype));
+    return tensor;
+}
@@ -1,5 +1,117 @@
 #include "../tensor.h"
+#include <sys/mman.h>
 
+// Below this the registration costs more than the bounce buffer it saves.
+constexpr size_t PINNED_UPLOAD_BYTES = 1 << 24;
+
+namespace {
+thread_local MemoryTag current_tag{nullptr, MEMORY_CATEGORY_WEIGHT, 0};
+thread_local std::shared_ptr<HostPins> current_pins;
+
+void charge(Storage *storage)
+{
+    storage->tag = current_tag;
+    if (storage->tag.account)
+        storage->tag.account->charge(storage->tag.category, storage->size);
+}
+} // namespace
+
+void MemoryAccount::charge(MemoryCategory category, size_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.current[category] += size;
+    _stats.peak[category] = std::max(_stats.peak[category], _stats.current[category]);
+    _stats.total += size;
+    _stats.total_peak = std::max(_stats.total_peak, _stats.total);
+}
+
+void MemoryAccount::release(MemoryCategory category, size_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.current[category] -= size;
+    _stats.total -= size;
+}
+
+MemoryStats MemoryAccount::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void upload_from_host(void *dst, DeviceType device, uint32_t device_id,
+                      void *src, size_t size)
+{
+    if (device == DEVICE_CPU || size < PINNED_UPLOAD_BYTES)
+    {
+        RUN_INFINI(infinirtMemcpyH2D(dst, device, device_id, src, size));
+        return;
+    }
+    if (current_pins)
+    {
+        current_pins->pin(src, size, device, device_id);
+        RUN_INFINI(infinirtMemcpyH2D(dst, device, device_id, src, size));
+        return;
+    }
+    // A range the caller pinned already stays registered after the copy.
+    bool owned = infinirtHostRegister(src, device, device_id, size) ==
+                 INFINIRT_STATUS_SUCCESS;
+    RUN_INFINI(infinirtMemcpyH2D(dst, device, device_id, src, size));
+    if (owned)
+        RUN_INFINI(infinirtHostUnregister(src, device, device_id));
+}
+
+void HostPins::pin(void *src, size_t size, DeviceType device, uint32_t device_id)
+{
+    auto begin = reinterpret_cast<uintptr_t>(src);
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto next = _ranges.upper_bound(begin);
+    if (next != _ranges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second.size > begin)
+            // Covered, or a partial overlap the backend would refuse anyway.
+            return;
+    }
+    if (next != _ranges.end() && next->first < begin + size)
+        return;
+    // Failures are cached too, so they are not retried on every upload.
+    bool owned = infinirtHostRegister(src, device, device_id, size) ==
+                 INFINIRT_STATUS_SUCCESS;
+    _ranges[begin] = Range{size, device, device_id, owned};
+}
+
+HostPins::~HostPins()
+{
+    for (auto &[begin, range] : _ranges)
+    {
+        if (range.owned)
+            RUN_INFINI(infinirtHostUnregister(reinterpret_cast<void *>(begin),
+                                              range.device, range.device_id));
+    }
+}
+
+HostPinScope::HostPinScope(std::shared_ptr<HostPins> pins)
+    : _saved(current_pins)
+{
+    current_pins = std::move(pins);
+}
+
+HostPinScope::~HostPinScope()
+{
+    current_pins = std::move(_saved);
+}
+
+MemoryScope::MemoryScope(std::shared_ptr<MemoryAccount> account,
+                         MemoryCategory category, uint64_t owner)
+    : _saved(current_tag)
+{
+    current_tag = MemoryTag{std::move(account), category, owner};
+}
+
+MemoryScope::~MemoryScope()
+{
+    current_tag = std::move(_saved);
+}
 
 std::shared_ptr<Storage> Storage::create(size_t size, DeviceType device, uint32_t device_id)
 {
@@ -9,6 +121,10 @@ std::shared_ptr<Storage> Storage::create(size_t size, DeviceType device, uint32_
     storage->device = device;
     storage->deviceId = device_id;
     storage->event = nullptr;
+    storage->stream = nullptr;
+    storage->mapping = nullptr;
+    storage->mapping_size = 0;
+    charge(storage.get());
     return storage;
 }
 
@@ -24,11 +140,41 @@ std::shared_ptr<Storage> Storage::createAsync(size_t size, DeviceType device, ui
     storage->size = size;
     storage->device = device;
     storage->deviceId = device_id;
+    storage->stream = stream;
+    storage->mapping = nullptr;
+    storage->mapping_size = 0;
+    charge(storage.get());
+    return storage;
+}
+
+std::shared_ptr<Storage> Storage::createMapped(void *mapping, size_t mapping_size, size_t offset, size_t size)
+{
+    ASSERT(offset + size <= mapping_size);
+    auto storage = std::make_shared<Storage>();
+    storage->memory = (char *)mapping + offset;
+    storage->size = size;
+    storage->device = DEVICE_CPU;
+    storage->deviceId = 0;
+    storage->event = nullptr;
+    storage->stream = nullptr;
+    storage->mapping = mapping;
+    storage->mapping_size = mapping_size;
+    charge(storage.get());
     return storage;
 }
 
 Storage::~Storage()
 {
+    if (this->tag.account)
+        this->tag.account->release(this->tag.category, this->size);
+    if (this->stream)
+    {
+        // The free is queued behind the allocation, so neither blocks the
+        // host nor synchronizes the device.
+        RUN_INFINI(infinirtEventDestroy(this->event));
+        RUN_INFINI(infinirtFreeAsync(this->memory, this->device, this->deviceId, this->stream));
+        return;
+    }
     if (this->event)
     {
         if (infinirtEventQuery(this->event) == INFINIRT_STATUS_NOT_READY)
@@ -38,7 +184,9 @@ Storage::~Storage()
         RUN_INFINI(infinirtEventDestroy(this->event));
     }
     this->event = nullptr;
-    if (this->memory)
+    if (this->mapping)
+        munmap(this->mapping, this->mapping_size);
+    else if (this->memory)
         RUN_INFINI(infinirtFree(this->memory, this->device, this->deviceId));
 }
 
@@ -0,0 +1,155 @@
+#include "../tensor.h"
+#include "../utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// Copies below this many bytes are not worth a thread launch.
+constexpr size_t PARALLEL_COPY_BYTES = 1 << 20;
+constexpr size_t MAX_COPY_THREADS = 16;
+
+struct CopyDim {
+    index_t len;
+    stride_t dst_stride; // in bytes
+    stride_t src_stride; // in bytes
+};
+
+template <size_t N>
+inline void copy_elements(char *dst, char const *src, index_t len,
+                          stride_t dst_stride, stride_t src_stride) {
+    for (index_t i = 0; i < len; i++) {
+        std::memcpy(dst, src, N);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+void copy_inner(char *dst, char const *src, const CopyDim &inner,
+                size_t elem_size) {
+    switch (elem_size) {
+    case 2:
+        copy_elements<2>(dst, src, inner.len, inner.dst_stride,
+                         inner.src_stride);
+        break;
+    case 4:
+        copy_elements<4>(dst, src, inner.len, inner.dst_stride,
+                         inner.src_stride);
+        break;
+    case 8:
+        copy_elements<8>(dst, src, inner.len, inner.dst_stride,
+                         inner.src_stride);
+        break;
+    default:
+        for (index_t i = 0; i < inner.len; i++) {
+            std::memcpy(dst + (stride_t)i * inner.dst_stride,
+                        src + (stride_t)i * inner.src_stride,
+                        elem_size);
+        }
+    }
+}
+} // namespace
+
+void strided_copy(void *dst, const std::vector<stride_t> &dst_strides,
+                  void const *src, const std::vector<stride_t> &src_strides,
+                  const std::vector<index_t> &shape, size_t elem_size) {
+    ASSERT_EQ(dst_strides.size(), shape.size());
+    ASSERT_EQ(src_strides.size(), shape.size());
+    auto dims = std::vector<CopyDim>();
+    size_t total = elem_size;
+    for (size_t i = 0; i < shape.size(); i++) {
+        total *= shape[i];
+        if (shape[i] != 1) {
+            dims.push_back({shape[i], dst_strides[i] * (stride_t)elem_size,
+                            src_strides[i] * (stride_t)elem_size});
+        }
+    }
+    if (total == 0) {
+        return;
+    }
+    // Walk the destination in memory order so writes stay sequential.
+    std::stable_sort(dims.begin(), dims.end(),
+                     [](const CopyDim &a, const CopyDim &b) {
+                         return std::abs(a.dst_stride) > std::abs(b.dst_stride);
+                     });
+    // Merge each dimension into its inner neighbour when both layouts are
+    // contiguous across the boundary.
+    auto collapsed = std::vector<CopyDim>();
+    for (auto &dim : dims) {
+        if (!collapsed.empty()) {
+            auto &outer = collapsed.back();
+            if (outer.dst_stride == dim.dst_stride * (stride_t)dim.len &&
+                outer.src_stride == dim.src_stride * (stride_t)dim.len) {
+                outer.len *= dim.len;
+                outer.dst_stride = dim.dst_stride;
+                outer.src_stride = dim.src_stride;
+                continue;
+            }
+        }
+        collapsed.push_back(dim);
+    }
+
+    // The innermost run is a single memcpy when it is dense on both sides,
+    // otherwise an element loop.
+    size_t run_bytes = elem_size;
+    bool dense_inner = false;
+    if (!collapsed.empty() &&
+        collapsed.back().dst_stride == (stride_t)elem_size &&
+        collapsed.back().src_stride == (stride_t)elem_size) {
+        run_bytes *= collapsed.back().len;
+        collapsed.pop_back();
+        dense_inner = true;
+    }
+    CopyDim inner{1, (stride_t)elem_size, (stride_t)elem_size};
+    if (!dense_inner && !collapsed.empty()) {
+        inner = collapsed.back();
+        collapsed.pop_back();
+    }
+
+    auto max_threads = std::min(
+        MAX_COPY_THREADS, std::max<size_t>(1, total / PARALLEL_COPY_BYTES));
+    if (dense_inner && collapsed.empty()) {
+        // Fully contiguous on both sides: split the single run instead.
+        parallel_for(run_bytes, max_threads, [&](size_t begin, size_t end) {
+            std::memcpy((char *)dst + begin, (char const *)src + begin,
+                        end - begin);
+        });
+        return;
+    }
+
+    size_t outer = 1;
+    for (auto &dim : collapsed) {
+        outer *= dim.len;
+    }
+    auto worker = [&](size_t begin, size_t end) {
+        // Decompose the starting linear index into per-dimension counters.
+        auto idx = std::vector<index_t>(collapsed.size());
+        char *d = (char *)dst;
+        char const *s = (char const *)src;
+        size_t rem = begin;
+        for (size_t i = collapsed.size(); i-- > 0;) {
+            idx[i] = rem % collapsed[i].len;
+            rem /= collapsed[i].len;
+            d += (stride_t)idx[i] * collapsed[i].dst_stride;
+            s += (stride_t)idx[i] * collapsed[i].src_stride;
+        }
+        for (size_t n = begin; n < end; n++) {
+            if (dense_inner) {
+                std::memcpy(d, s, run_bytes);
+            } else {
+                copy_inner(d, s, inner, elem_size);
+            }
+            for (size_t i = collapsed.size(); i-- > 0;) {
+                d += collapsed[i].dst_stride;
+                s += collapsed[i].src_stride;
+                if (++idx[i] < collapsed[i].len) {
+                    break;
+                }
+                d -= (stride_t)collapsed[i].len * collapsed[i].dst_stride;
+                s -= (stride_t)collapsed[i].len * collapsed[i].src_stride;
+                idx[i] = 0;
+            }
+        }
+    };
+    parallel_for(outer, max_threads, worker);
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <numeric>
 #include <fstream>
+#include <functional>
 
 std::shared_ptr<TensorDesc>
 TensorDesc::create(InfiniDataType_t dtype, const std::vector<index_t> &shape,
@@ -90,8 +91,7 @@ std::shared_ptr<Tensor> Tensor::weight(void *data, InfiniDataType_t dtype,
     }
     tensor->_strides = strides;
     tensor->storage = Storage::create(size, device, deviceId);
-    RUN_INFINI(infinirtMemcpyH2D(tensor->storage->memory, device, deviceId,
-                                 data, size));
+    upload_from_host(tensor->storage->memory, device, deviceId, data, size);
     tensor->_data = tensor->storage->memory;
     tensor->_size = size;
     infiniopCreateTensorDescriptor(&tensor->_desc, ndim, tensor->_shape.data(),
@@ -103,7 +103,8 @@ void *Tensor::data_impl(index_t offset, infinirtStream_t stream) const {
     ASSERT(offset * dt_size(this->dtype()) < this->_size);
 
     if (this->storage->event != nullptr && infinirtEventQuery(this->storage->event) == INFINIRT_STATUS_NOT_READY) {
-        if (stream == nullptr) {
+        // CPU operators run on the calling thread, so they wait on the host.
+        if (stream == nullptr || runs_on_host(this->storage->device)) {
             infinirtEventSynchronize(this->storage->event);
         } else {
             infinirtStreamWaitEvent(this->storage->event, stream);
@@ -129,30 +130,54 @@ void const *Tensor::data(index_t offset, infinirtStream_t stream) const {
     return this->data_impl(offset, stream);
 }
 
+static void run_host_task(void *task) {
+    auto fn = static_cast<std::function<void()> *>(task);
+    (*fn)();
+    delete fn;
+}
+
 void Tensor::copy_from(std::shared_ptr<Tensor const> src,
                        infiniopHandle_t handle, infinirtStream_t stream) {
     ASSERT_EQ(this->shape(), src->shape());
     ASSERT_EQ(this->dtype(), src->dtype());
-    infiniopRearrangeDescriptor_t desc;
-    void* raw_stream;
-    if (stream != nullptr)
-        infinirtGetRawStream(&raw_stream, stream);
-    RUN_INFINI(infiniopCreateRearrangeDescriptor(
-        handle, &desc, this->desc()->get(), src->desc()->get()));
-    RUN_INFINI(infiniopRearrange(desc, this->data(stream), src->data(stream),
-                                 raw_stream));
-    RUN_INFINI(infiniopDestroyRearrangeDescriptor(desc));
-    if (stream != nullptr) {
-        if (this->storage->event == nullptr) {
-            RUN_INFINI(infinirtEventCreate(&this->storage->event,
-                                           this->storage->device,
-                                           this->storage->deviceId));
+    if (runs_on_host(this->device_type()) && runs_on_host(src->device_type())) {
+        auto dst_data = this->data(stream);
+        auto src_data = src->data(stream);
+        if (stream == nullptr) {
+            strided_copy(dst_data, this->strides(), src_data, src->strides(),
+                         this->shape(), dt_size(this->dtype()));
+            return;
         }
-        RUN_INFINI(infinirtEventRecord(this->storage->event, stream));
+        // Both views are kept alive until the stream reaches the copy.
+        auto dst = shared_from_this();
+        RUN_INFINI(infinirtLaunchHostFunc(
+            stream, run_host_task, new std::function<void()>([=] {
+                strided_copy(dst_data, dst->strides(), src_data,
+                             src->strides(), dst->shape(),
+                             dt_size(dst->dtype()));
+            })));
     } else {
-        RUN_INFINI(
-            infinirtDeviceSynchronize(this->device_type(), this->device_id()));
+        infiniopRearrangeDescriptor_t desc;
+        void *raw_stream = nullptr;
+        if (stream != nullptr)
+            infinirtGetRawStream(&raw_stream, stream);
+        RUN_INFINI(infiniopCreateRearrangeDescriptor(
+            handle, &desc, this->desc()->get(), src->desc()->get()));
+        RUN_INFINI(infiniopRearrange(desc, this->data(stream),
+                                     src->data(stream), raw_stream));
+        RUN_INFINI(infiniopDestroyRearrangeDescriptor(desc));
+        if (stream == nullptr) {
+            RUN_INFINI(infinirtDeviceSynchronize(this->device_type(),
+                                                 this->device_id()));
+            return;
+        }
     }
+    if (this->storage->event == nullptr) {
+        RUN_INFINI(infinirtEventCreate(&this->storage->event,
+                                       this->storage->device,
+                                       this->storage->deviceId));
+    }
+    RUN_INFINI(infinirtEventRecord(this->storage->event, stream));
 }
 
 bool Tensor::is_contigous() const {
@@ -213,28 +238,23 @@ void Tensor::debug(const std::string &filename) const {
     std::cout << "] dtype=" << this->dtype()
               << " device=" << this->device_type()
               << " device_id=" << this->device_id() << std::endl;
+    if (!filename.empty()) {
+        this->save(filename);
+        std::cout << "Data written to file: " << filename << "\n";
+        return;
+    }
+
     auto dtype = this->dtype();
     void const *cpu_data;
+    void *cpu_memory = nullptr;
     if (this->device_type() != DEVICE_CPU) {
-        void *cpu_memory = std::malloc(this->storage->size);
+        cpu_memory = std::malloc(this->storage->size);
         RUN_INFINI(infinirtMemcpyD2H(cpu_memory, this->storage->memory,
                                      this->device_type(), this->device_id(),
                                      this->storage->size));
         cpu_data = cpu_memory;
     } else {
-        cpu_data = this->data();
-    }
-
-    if (!filename.empty()){
-        std::ofstream outFile(filename, std::ios::binary);
-        if (!outFile) {
-            std::cerr << "Error opening file for writing: " << filename << "\n";
-            return;
-        }
-        outFile.write(reinterpret_cast<const char*>(cpu_data), this->storage->size);
-        outFile.close();
-        std::cout << "Data written to file: " << filename << "\n";
-        return;
+        cpu_data = this->storage->memory;
     }
 
     switch (dtype) {
@@ -253,6 +273,7 @@ void Tensor::debug(const std::string &filename) const {
     default:
         PANIC("Unsupported data type");
     }
+    std::free(cpu_memory);
 }
 
 void Tensor::debug() const { this->debug(""); }
@@ -3,6 +3,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 inline void assert_true(int expr, const char *msg, const char *file, int line)
 {
@@ -30,6 +34,28 @@ inline void assert_true(int expr, const char *msg, const char *file, int line)
         }                                                                      \
     } while (0)
 
+// Splits [0, n) into at most `max_threads` contiguous ranges and runs
+// `f(begin, end)` on each, using the calling thread for the first range.
+template <typename F>
+inline void parallel_for(size_t n, size_t max_threads, F f) {
+    size_t nthreads = std::min<size_t>(
+        std::min<size_t>(max_threads, std::thread::hardware_concurrency()), n);
+    if (nthreads <= 1) {
+        if (n > 0)
+            f(size_t(0), n);
+        return;
+    }
+    auto threads = std::vector<std::thread>();
+    size_t chunk = (n + nthreads - 1) / nthreads;
+    for (size_t begin = chunk; begin < n; begin += chunk) {
+        threads.emplace_back(f, begin, std::min(n, begin + chunk));
+    }
+    f(size_t(0), std::min(n, chunk));
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
 inline float f16_to_f32(uint16_t h) {
     uint32_t sign = (h & 0x8000) << 16;  // Extract the sign bit
     int32_t exponent = (h >> 10) & 0x1F; // Extract the exponent
@@ -68,4 +94,90 @@ inline float f16_to_f32(uint16_t h) {
     }
 }
 
+// Rounds to nearest even; overflow saturates to infinity.
+inline uint16_t f32_to_f16(float val) {
+    uint32_t f32 = *(uint32_t *)&val;
+    uint16_t sign = (f32 >> 16) & 0x8000;           // Extract the sign bit
+    int32_t exponent = ((f32 >> 23) & 0xFF) - 127 + 15; // Rebias the exponent
+    uint32_t mantissa = f32 & 0x7FFFFF;             // Extract the mantissa
+
+    if (((f32 >> 23) & 0xFF) == 0xFF) { // Inf and NaN
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    }
+    if (exponent >= 31) { // Too large: infinity
+        return sign | 0x7C00;
+    }
+    if (exponent <= 0) { // Subnormal float16 or zero
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000; // Restore the implicit leading 1 bit
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+    // Normalized float16; a rounding carry may step into the exponent.
+    uint32_t half = (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+// FP8 E4M3 as used for activations (bias 7, no infinities, 0x7F is NaN).
+inline float f8e4m3_to_f32(uint8_t q) {
+    float sign = (q & 0x80) ? -1.f : 1.f;
+    int exponent = (q >> 3) & 0xF;
+    int mantissa = q & 0x7;
+    if (exponent == 0xF && mantissa == 0x7) {
+        return NAN;
+    }
+    if (exponent == 0) { // Subnormal: mantissa * 2^-9
+        return sign * std::ldexp(float(mantissa), -9);
+    }
+    return sign * std::ldexp(float(8 + mantissa), exponent - 10);
+}
+
+// Rounds to nearest even; overflow and infinities saturate to +-448.
+inline uint8_t f32_to_f8e4m3(float val) {
+    uint32_t f32 = *(uint32_t *)&val;
+    uint8_t sign = (f32 >> 24) & 0x80;
+    int32_t exponent = ((f32 >> 23) & 0xFF) - 127 + 7;
+    uint32_t mantissa = f32 & 0x7FFFFF;
+
+    if (((f32 >> 23) & 0xFF) == 0xFF) {
+        return sign | (mantissa != 0 ? 0x7F : 0x7E);
+    }
+    if (exponent > 15) {
+        return sign | 0x7E;
+    }
+    if (exponent <= 0) { // Subnormal fp8 or zero
+        if (exponent < -3) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = 21 - exponent;
+        uint32_t q = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (q & 1))) {
+            q++;
+        }
+        return sign | q;
+    }
+    uint32_t q = (exponent << 3) | (mantissa >> 20);
+    uint32_t rest = mantissa & 0xFFFFF;
+    if (rest > 0x80000 || (rest == 0x80000 && (q & 1))) {
+        q++;
+    }
+    // Rounding may reach the NaN encoding or overflow the exponent.
+    return sign | std::min<uint32_t>(q, 0x7E);
+}
+
 #endif
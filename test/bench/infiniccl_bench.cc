@@ -0,0 +1,404 @@
+// Collective benchmark in the style of nccl-tests. Sweeps message sizes for
+// each collective on every compiled backend and reports latency percentiles
+// with algorithmic and bus bandwidth.
+//
+//   infiniccl_bench [-b 8] [-e 64M] [-f 2] [-g 2] [-n 20] [-w 5]
+//                   [-o all|all_reduce|all_gather|reduce_scatter|broadcast|sendrecv]
+//                   [-d f32|f16] [-t all|cpu|sim|nvidia|ascend]
+//                   [-z none|int8|fp8] [-r]
+//
+// Sizes are bytes of the whole buffer as in nccl-tests: the all-reduce or
+// broadcast buffer, the all-gather output, the reduce-scatter input, or one
+// point-to-point message. busbw scales algbw by the share of the buffer each
+// rank has to move, so it compares against link bandwidth for any rank count.
+// -z runs the all-reduce compressed; -r creates communicators one rank at a
+// time with infinicclCommInitRank, which selects the socket transport on the
+// host backends.
+#include "../../include/infiniccl.h"
+#include "../../include/infinirt.h"
+#include "../../src/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+enum class Op { AllReduce, AllGather, ReduceScatter, Broadcast, SendRecv };
+
+struct OpInfo {
+    Op op;
+    const char *name;
+};
+
+const OpInfo OPS[] = {
+    {Op::AllReduce, "all_reduce"},       {Op::AllGather, "all_gather"},
+    {Op::ReduceScatter, "reduce_scatter"}, {Op::Broadcast, "broadcast"},
+    {Op::SendRecv, "sendrecv"},
+};
+
+struct Backend {
+    DeviceType device;
+    const char *name;
+};
+
+const Backend BACKENDS[] = {
+    {DEVICE_CPU, "cpu"},
+    {DEVICE_SIM, "sim"},
+#ifdef ENABLE_NV_GPU
+    {DEVICE_NVIDIA, "nvidia"},
+#endif
+#ifdef ENABLE_ASCEND_NPU
+    {DEVICE_ASCEND, "ascend"},
+#endif
+};
+
+struct Options {
+    size_t min_bytes = 8, max_bytes = size_t(64) << 20;
+    double factor = 2;
+    unsigned int nranks = 2;
+    unsigned int iters = 20, warmup = 5;
+    std::vector<OpInfo> ops;
+    InfiniDataType_t dtype = INFINI_F32;
+    std::vector<Backend> backends;
+    infinicclCompression_t compression = INFINICCL_COMPRESSION_NONE;
+    bool by_rank = false;
+};
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b minbytes] [-e maxbytes] [-f factor] [-g ranks]\n"
+            "          [-n iters] [-w warmup] [-o op] [-d f32|f16]\n"
+            "          [-t backend] [-z none|int8|fp8] [-r]\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+// Accepts K, M and G suffixes.
+size_t parseSize(const char *arg) {
+    char *end;
+    double value = strtod(arg, &end);
+    switch (*end) {
+    case 'G': case 'g': value *= 1 << 30; break;
+    case 'M': case 'm': value *= 1 << 20; break;
+    case 'K': case 'k': value *= 1 << 10; break;
+    default: break;
+    }
+    return size_t(value);
+}
+
+Options parseOptions(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "-r") {
+            opt.by_rank = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        std::string value = argv[++i];
+        if (flag == "-b") {
+            opt.min_bytes = parseSize(value.c_str());
+        } else if (flag == "-e") {
+            opt.max_bytes = parseSize(value.c_str());
+        } else if (flag == "-f") {
+            opt.factor = atof(value.c_str());
+        } else if (flag == "-g") {
+            opt.nranks = atoi(value.c_str());
+        } else if (flag == "-n") {
+            opt.iters = atoi(value.c_str());
+        } else if (flag == "-w") {
+            opt.warmup = atoi(value.c_str());
+        } else if (flag == "-o") {
+            for (auto &info : OPS) {
+                if (value == "all" || value == info.name) {
+                    opt.ops.push_back(info);
+                }
+            }
+        } else if (flag == "-d") {
+            opt.dtype = value == "f16" ? INFINI_F16 : INFINI_F32;
+        } else if (flag == "-t") {
+            for (auto &backend : BACKENDS) {
+                if (value == "all" || value == backend.name) {
+                    opt.backends.push_back(backend);
+                }
+            }
+        } else if (flag == "-z") {
+            opt.compression = value == "int8" ? INFINICCL_COMPRESSION_INT8
+                              : value == "fp8"
+                                  ? INFINICCL_COMPRESSION_FP8_E4M3
+                                  : INFINICCL_COMPRESSION_NONE;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (opt.ops.empty()) {
+        for (auto &info : OPS) {
+            opt.ops.push_back(info);
+        }
+    }
+    if (opt.backends.empty()) {
+        opt.backends.assign(std::begin(BACKENDS), std::end(BACKENDS));
+    }
+    if (opt.nranks == 0 || opt.iters == 0 || opt.factor <= 1 ||
+        opt.min_bytes == 0 || opt.min_bytes > opt.max_bytes) {
+        usage(argv[0]);
+    }
+    return opt;
+}
+
+class Barrier {
+public:
+    explicit Barrier(unsigned int count) : count(count) {}
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto current = generation;
+        if (++arrived == count) {
+            arrived = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != current; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    unsigned int count, arrived = 0;
+    uint64_t generation = 0;
+};
+
+// Elements per rank and the buffer size actually benchmarked for `bytes`.
+struct Shape {
+    size_t count, bytes;
+};
+
+Shape shapeOf(Op op, size_t bytes, size_t elem_size, unsigned int nranks) {
+    size_t parts = op == Op::AllGather || op == Op::ReduceScatter ? nranks : 1;
+    size_t count = std::max<size_t>(1, bytes / elem_size / parts);
+    return {count, count * elem_size * parts};
+}
+
+double busFactor(Op op, unsigned int nranks) {
+    switch (op) {
+    case Op::AllReduce:
+        return 2.0 * (nranks - 1) / nranks;
+    case Op::AllGather:
+    case Op::ReduceScatter:
+        return double(nranks - 1) / nranks;
+    default:
+        return 1.0;
+    }
+}
+
+// Point-to-point runs as a ring; even ranks send first so that blocking
+// sends always find their receiver.
+infinicclStatus_t runOp(Op op, Options const &opt, infinicclComm_t comm,
+                        unsigned int rank, void *send, void *recv,
+                        size_t count, infinirtStream_t stream) {
+    auto n = opt.nranks;
+    switch (op) {
+    case Op::AllReduce:
+        return infinicclAllReduceSumCompressed(comm, send, recv, count,
+                                               opt.dtype, opt.compression,
+                                               stream);
+    case Op::AllGather:
+        return infinicclAllGather(comm, send, recv, count, opt.dtype, stream);
+    case Op::ReduceScatter:
+        return infinicclReduceScatterSum(comm, send, recv, count, opt.dtype,
+                                         stream);
+    case Op::Broadcast:
+        return infinicclBroadcast(comm, send, recv, count, opt.dtype, 0,
+                                  stream);
+    case Op::SendRecv: {
+        unsigned int next = (rank + 1) % n, prev = (rank + n - 1) % n;
+        infinicclStatus_t status;
+        if (rank % 2 == 0) {
+            status = infinicclSend(comm, send, count, opt.dtype, next, stream);
+            if (status == INFINICCL_STATUS_SUCCESS) {
+                status = infinicclRecv(comm, recv, count, opt.dtype, prev,
+                                       stream);
+            }
+        } else {
+            status = infinicclRecv(comm, recv, count, opt.dtype, prev, stream);
+            if (status == INFINICCL_STATUS_SUCCESS) {
+                status = infinicclSend(comm, send, count, opt.dtype, next,
+                                       stream);
+            }
+        }
+        return status;
+    }
+    }
+    return INFINICCL_STATUS_INVALID_ARGUMENT;
+}
+
+// Nearest-rank percentile of sorted samples.
+double percentile(std::vector<double> const &sorted, double p) {
+    size_t idx = size_t(p * sorted.size() + 0.5);
+    return sorted[std::min(sorted.size() - 1, idx > 0 ? idx - 1 : 0)];
+}
+
+// Shared by the rank threads of one backend; rank 0 prints each row.
+struct Sweep {
+    Options const &opt;
+    Barrier barrier;
+    // Per rank, seconds of each timed iteration of the current size.
+    std::vector<std::vector<double>> times;
+    std::vector<infinicclStatus_t> status;
+
+    explicit Sweep(Options const &opt)
+        : opt(opt), barrier(opt.nranks),
+          times(opt.nranks, std::vector<double>(opt.iters)),
+          status(opt.nranks) {}
+
+    void report(OpInfo const &info, Shape const &shape) {
+        for (auto s : status) {
+            if (s != INFINICCL_STATUS_SUCCESS) {
+                printf("%12zu %12zu %6s %15s %10s   (status %d)\n", shape.bytes,
+                       shape.count, opt.dtype == INFINI_F16 ? "f16" : "f32",
+                       info.name, "n/a", int(s));
+                return;
+            }
+        }
+        // An iteration lasts as long as its slowest rank.
+        auto iter = std::vector<double>(opt.iters, 0.0);
+        for (auto const &rank_times : times) {
+            for (size_t i = 0; i < iter.size(); i++) {
+                iter[i] = std::max(iter[i], rank_times[i]);
+            }
+        }
+        double avg = 0;
+        for (auto t : iter) {
+            avg += t / iter.size();
+        }
+        std::sort(iter.begin(), iter.end());
+        double algbw = shape.bytes / avg / 1e9;
+        printf("%12zu %12zu %6s %15s %10.2f %10.2f %10.2f %8.3f %8.3f\n",
+               shape.bytes, shape.count,
+               opt.dtype == INFINI_F16 ? "f16" : "f32", info.name, avg * 1e6,
+               percentile(iter, 0.5) * 1e6, percentile(iter, 0.99) * 1e6,
+               algbw, algbw * busFactor(info.op, opt.nranks));
+        fflush(stdout);
+    }
+};
+
+void runRank(Sweep &sweep, DeviceType device, unsigned int rank,
+             infinicclComm_t comm) {
+    auto const &opt = sweep.opt;
+    void *send, *recv;
+    infinirtStream_t stream;
+    RUN_INFINI(infinirtMalloc(&send, device, rank, opt.max_bytes));
+    RUN_INFINI(infinirtMalloc(&recv, device, rank, opt.max_bytes));
+    RUN_INFINI(infinirtStreamCreate(&stream, device, rank));
+    // Zeros keep the sums finite however many iterations accumulate.
+    auto zeros = std::vector<char>(std::min<size_t>(opt.max_bytes, 64 << 20));
+    for (size_t offset = 0; offset < opt.max_bytes; offset += zeros.size()) {
+        size_t len = std::min(zeros.size(), opt.max_bytes - offset);
+        RUN_INFINI(infinirtMemcpyH2D(static_cast<char *>(send) + offset,
+                                     device, rank, zeros.data(), len));
+        RUN_INFINI(infinirtMemcpyH2D(static_cast<char *>(recv) + offset,
+                                     device, rank, zeros.data(), len));
+    }
+
+    size_t elem_size = opt.dtype == INFINI_F16 ? 2 : 4;
+    for (auto const &info : opt.ops) {
+        if (info.op == Op::SendRecv && opt.nranks == 1) {
+            continue;
+        }
+        for (double bytes = opt.min_bytes; bytes <= opt.max_bytes;
+             bytes *= opt.factor) {
+            auto shape = shapeOf(info.op, size_t(bytes), elem_size, opt.nranks);
+            if (shape.bytes > opt.max_bytes) {
+                break;
+            }
+            auto status = INFINICCL_STATUS_SUCCESS;
+            for (unsigned int i = 0; i < opt.warmup + opt.iters; i++) {
+                sweep.barrier.wait();
+                auto start = std::chrono::steady_clock::now();
+                if (status == INFINICCL_STATUS_SUCCESS) {
+                    status = runOp(info.op, opt, comm, rank, send, recv,
+                                   shape.count, stream);
+                }
+                RUN_INFINI(infinirtStreamSynchronize(stream));
+                auto end = std::chrono::steady_clock::now();
+                if (i >= opt.warmup) {
+                    sweep.times[rank][i - opt.warmup] =
+                        std::chrono::duration<double>(end - start).count();
+                }
+            }
+            sweep.status[rank] = status;
+            sweep.barrier.wait();
+            if (rank == 0) {
+                sweep.report(info, shape);
+            }
+            sweep.barrier.wait();
+        }
+    }
+    RUN_INFINI(infinirtStreamDestroy(stream));
+    RUN_INFINI(infinirtFree(send, device, rank));
+    RUN_INFINI(infinirtFree(recv, device, rank));
+}
+
+void runBackend(Backend const &backend, Options const &opt) {
+    static const char *compression[] = {"none", "int8", "fp8_e4m3"};
+    printf("#\n# backend %s, %u ranks, %s communicators, compression %s\n",
+           backend.name, opt.nranks,
+           opt.by_rank ? "per-rank" : "single-process",
+           compression[opt.compression]);
+    if (infinirtInit(backend.device) != INFINIRT_STATUS_SUCCESS) {
+        printf("# runtime unavailable, skipped\n");
+        return;
+    }
+    auto comms = std::vector<infinicclComm_t>(opt.nranks, nullptr);
+    infinicclUniqueId id;
+    if (opt.by_rank) {
+        RUN_INFINI(infinicclGetUniqueId(&id));
+    } else {
+        auto ids = std::vector<unsigned int>(opt.nranks);
+        for (unsigned int r = 0; r < opt.nranks; r++) {
+            ids[r] = r;
+        }
+        auto status = infinicclCommInitAll(backend.device, comms.data(),
+                                           opt.nranks, ids.data());
+        if (status != INFINICCL_STATUS_SUCCESS) {
+            printf("# no communicator (status %d), skipped\n", int(status));
+            return;
+        }
+    }
+    printf("# %10s %12s %6s %15s %10s %10s %10s %8s %8s\n", "size(B)", "count",
+           "type", "op", "avg(us)", "p50(us)", "p99(us)", "algbw", "busbw");
+    printf("# %10s %12s %6s %15s %10s %10s %10s %8s %8s\n", "", "(per rank)",
+           "", "", "", "", "", "(GB/s)", "(GB/s)");
+    Sweep sweep(opt);
+    auto threads = std::vector<std::thread>(opt.nranks);
+    for (unsigned int r = 0; r < opt.nranks; r++) {
+        threads[r] = std::thread([&, r] {
+            if (opt.by_rank) {
+                RUN_INFINI(infinicclCommInitRank(backend.device, &comms[r], &id,
+                                                 opt.nranks, r, r));
+            }
+            runRank(sweep, backend.device, r, comms[r]);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto comm : comms) {
+        infinicclCommDestroy(comm);
+    }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    auto opt = parseOptions(argc, argv);
+    for (auto const &backend : opt.backends) {
+        runBackend(backend, opt);
+    }
+    return 0;
+}
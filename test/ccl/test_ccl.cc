@@ -1,7 +1,10 @@
 #include "../../include/infinirt.h"
 #include "../../include/infiniccl.h"
 #include "../../src/tensor.h"
+#include "../../src/utils.h"
 #include "../test.h"
+#include <cmath>
+#include <random>
 #include <thread>
 #include <vector>
 
@@ -46,7 +49,7 @@ int test_allreduce_sum(DeviceType deviceType) {
         ans[i] = data[i] * TEST_GROUP_SIZE;
     }
 
-    auto output = std::vector<std::vector<float>>(len);
+    auto output = std::vector<std::vector<float>>(TEST_GROUP_SIZE);
     auto threads = std::vector<std::thread>(TEST_GROUP_SIZE);
 
     infinicclComm_t comm[TEST_GROUP_SIZE];
@@ -72,6 +75,420 @@ int test_allreduce_sum(DeviceType deviceType) {
     return TEST_PASSED;
 }
 
+int allreduce_sum_inplace_f16(DeviceType deviceType, uint32_t deviceID,
+                              infinicclComm_t comm, size_t len,
+                              std::vector<std::vector<uint16_t>> &output) {
+    auto data = std::vector<uint16_t>(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = f32_to_f16(float(i % 64) + deviceID);
+    }
+    auto buf = Tensor::weight(data.data(), INFINI_F16,
+                              std::vector<index_t>({len}), deviceType, deviceID);
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, deviceType, deviceID));
+    CHECK_RUN(infinicclAllReduceSum(comm, buf->data(), buf->data(), len,
+                                    INFINI_F16, stream));
+    CHECK_RUN(infinirtStreamSynchronize(stream));
+    CHECK_RUN(infinirtMemcpyD2H(data.data(), buf->data(), deviceType, deviceID,
+                                buf->byte_size()));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    output[deviceID] = std::move(data);
+    return TEST_PASSED;
+}
+
+// Odd length so the last rank's chunk is partial.
+int test_allreduce_sum_inplace_f16(DeviceType deviceType) {
+    size_t len = 1001;
+    auto output = std::vector<std::vector<uint16_t>>(TEST_GROUP_SIZE);
+    auto threads = std::vector<std::thread>(TEST_GROUP_SIZE);
+
+    infinicclComm_t comm[TEST_GROUP_SIZE];
+    auto deviceIds = std::vector<uint32_t>(TEST_GROUP_SIZE);
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        deviceIds[i] = (uint32_t)i;
+    }
+    CHECK_RUN(infinicclCommInitAll(deviceType, comm, TEST_GROUP_SIZE, deviceIds.data()));
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        threads[i] = std::thread(allreduce_sum_inplace_f16, deviceType,
+                                 deviceIds[i], comm[i], len, std::ref(output));
+    }
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        threads[i].join();
+    }
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        CHECK_RUN(infinicclCommDestroy(comm[i]));
+    }
+
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        TEST_EQUAL(output[i].size(), len);
+        for (size_t j = 0; j < len; j++) {
+            float expect = float(j % 64) * TEST_GROUP_SIZE +
+                           TEST_GROUP_SIZE * (TEST_GROUP_SIZE - 1) / 2;
+            TEST_EQUAL(f16_to_f32(output[i][j]), expect);
+        }
+    }
+    return TEST_PASSED;
+}
+
+// When set, run_group creates its communicators one rank at a time through
+// infinicclCommInitRank, as separate processes would.
+static bool init_by_rank = false;
+
+// Runs `body(rank, comm)` for every rank on its own thread.
+template <typename F> int run_group(DeviceType deviceType, F body) {
+    infinicclComm_t comm[TEST_GROUP_SIZE];
+    auto deviceIds = std::vector<uint32_t>(TEST_GROUP_SIZE);
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        deviceIds[i] = (uint32_t)i;
+    }
+    infinicclUniqueId id;
+    if (init_by_rank) {
+        CHECK_RUN(infinicclGetUniqueId(&id));
+    } else {
+        CHECK_RUN(infinicclCommInitAll(deviceType, comm, TEST_GROUP_SIZE, deviceIds.data()));
+    }
+    auto results = std::vector<int>(TEST_GROUP_SIZE);
+    auto threads = std::vector<std::thread>(TEST_GROUP_SIZE);
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        threads[i] = std::thread([&, i] {
+            if (init_by_rank &&
+                infinicclCommInitRank(deviceType, &comm[i], &id,
+                                      TEST_GROUP_SIZE, (uint32_t)i,
+                                      deviceIds[i]) != INFINICCL_STATUS_SUCCESS) {
+                results[i] = TEST_FAILED;
+                comm[i] = nullptr;
+                return;
+            }
+            results[i] = body((uint32_t)i, comm[i]);
+        });
+    }
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        threads[i].join();
+    }
+    for (int i = 0; i < TEST_GROUP_SIZE; i++) {
+        CHECK_RUN(infinicclCommDestroy(comm[i]));
+        TEST_EQUAL(results[i], TEST_PASSED);
+    }
+    return TEST_PASSED;
+}
+
+// Rank r contributes the values r * 10 + i.
+std::vector<float> rank_data(uint32_t rank, size_t len) {
+    auto data = std::vector<float>(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = float(rank * 10 + i);
+    }
+    return data;
+}
+
+int read_back(DeviceType deviceType, uint32_t rank, infinirtStream_t stream,
+              std::shared_ptr<Tensor> buf, std::vector<float> &out) {
+    CHECK_RUN(infinirtStreamSynchronize(stream));
+    out.resize(buf->byte_size() / sizeof(float));
+    CHECK_RUN(infinirtMemcpyD2H(out.data(), buf->data(), deviceType, rank,
+                                buf->byte_size()));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    return TEST_PASSED;
+}
+
+// Random finite f16 values of rank r, subnormals included.
+std::vector<uint16_t> rank_data_f16(uint32_t rank, size_t len) {
+    auto gen = std::mt19937(rank + 1);
+    auto data = std::vector<uint16_t>(len);
+    for (auto &h : data) {
+        do {
+            h = (uint16_t)gen();
+        } while ((h & 0x7C00) == 0x7C00);
+    }
+    return data;
+}
+
+// The f16 sum is bitwise the float sum over ranks in order, rounded once, on
+// full tiles and on the short last one.
+int test_allreduce_sum_f16_rounding(DeviceType deviceType) {
+    size_t len = 1001;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data_f16(rank, len);
+        auto buf = Tensor::weight(data.data(), INFINI_F16,
+                                  std::vector<index_t>({len}), deviceType,
+                                  rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        CHECK_RUN(infinicclAllReduceSum(comm, buf->data(), buf->data(), len,
+                                        INFINI_F16, stream));
+        CHECK_RUN(infinirtStreamSynchronize(stream));
+        CHECK_RUN(infinirtMemcpyD2H(data.data(), buf->data(), deviceType, rank,
+                                    buf->byte_size()));
+        CHECK_RUN(infinirtStreamDestroy(stream));
+        auto inputs = std::vector<std::vector<uint16_t>>();
+        for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+            inputs.push_back(rank_data_f16(r, len));
+        }
+        for (size_t i = 0; i < len; i++) {
+            float sum = f16_to_f32(inputs[0][i]);
+            for (uint32_t r = 1; r < TEST_GROUP_SIZE; r++) {
+                sum += f16_to_f32(inputs[r][i]);
+            }
+            TEST_EQUAL(data[i], f32_to_f16(sum));
+        }
+        return TEST_PASSED;
+    });
+}
+
+// Length not divisible by the group size, so chunks are uneven.
+int test_allreduce_sum_uneven(DeviceType deviceType) {
+    size_t len = 1001;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data(rank, len);
+        auto buf = Tensor::weight(data.data(), INFINI_F32, {len}, deviceType,
+                                  rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        CHECK_RUN(infinicclAllReduceSum(comm, buf->data(), buf->data(), len,
+                                        INFINI_F32, stream));
+        auto out = std::vector<float>();
+        CHECK_RUN(read_back(deviceType, rank, stream, buf, out));
+        for (size_t i = 0; i < len; i++) {
+            float expect = 0;
+            for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+                expect += float(r * 10 + i);
+            }
+            TEST_EQUAL(out[i], expect);
+        }
+        return TEST_PASSED;
+    });
+}
+
+int test_allgather(DeviceType deviceType) {
+    size_t len = 3;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data(rank, len);
+        auto zeros = std::vector<float>(len * TEST_GROUP_SIZE, 0);
+        auto send_buf = Tensor::weight(data.data(), INFINI_F32, {len},
+                                       deviceType, rank);
+        auto recv_buf = Tensor::weight(zeros.data(), INFINI_F32,
+                                       {len * TEST_GROUP_SIZE}, deviceType, rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        CHECK_RUN(infinicclAllGather(comm, send_buf->data(), recv_buf->data(),
+                                     len, INFINI_F32, stream));
+        auto out = std::vector<float>();
+        CHECK_RUN(read_back(deviceType, rank, stream, recv_buf, out));
+        for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+            for (size_t i = 0; i < len; i++) {
+                TEST_EQUAL(out[r * len + i], float(r * 10 + i));
+            }
+        }
+        return TEST_PASSED;
+    });
+}
+
+int test_reduce_scatter_sum(DeviceType deviceType) {
+    size_t len = 3;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data(rank, len * TEST_GROUP_SIZE);
+        auto zeros = std::vector<float>(len, 0);
+        auto send_buf = Tensor::weight(data.data(), INFINI_F32,
+                                       {len * TEST_GROUP_SIZE}, deviceType, rank);
+        auto recv_buf = Tensor::weight(zeros.data(), INFINI_F32, {len},
+                                       deviceType, rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        CHECK_RUN(infinicclReduceScatterSum(comm, send_buf->data(),
+                                            recv_buf->data(), len, INFINI_F32,
+                                            stream));
+        auto out = std::vector<float>();
+        CHECK_RUN(read_back(deviceType, rank, stream, recv_buf, out));
+        for (size_t i = 0; i < len; i++) {
+            float expect = 0;
+            for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+                expect += float(r * 10 + rank * len + i);
+            }
+            TEST_EQUAL(out[i], expect);
+        }
+        return TEST_PASSED;
+    });
+}
+
+int test_broadcast(DeviceType deviceType) {
+    size_t len = 4;
+    unsigned int root = TEST_GROUP_SIZE - 1;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data(rank, len);
+        auto zeros = std::vector<float>(len, 0);
+        auto send_buf = Tensor::weight(data.data(), INFINI_F32, {len},
+                                       deviceType, rank);
+        auto recv_buf = Tensor::weight(zeros.data(), INFINI_F32, {len},
+                                       deviceType, rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        CHECK_RUN(infinicclBroadcast(comm, send_buf->data(), recv_buf->data(),
+                                     len, INFINI_F32, root, stream));
+        auto out = std::vector<float>();
+        CHECK_RUN(read_back(deviceType, rank, stream, recv_buf, out));
+        TEST_EQUAL(out, rank_data(root, len));
+        return TEST_PASSED;
+    });
+}
+
+// Rank 0 sends its buffer to rank 1, which sends it back unchanged.
+int test_send_recv(DeviceType deviceType) {
+    size_t len = 5;
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        if (rank > 1) {
+            return TEST_PASSED;
+        }
+        auto data = rank_data(rank, len);
+        auto buf = Tensor::weight(data.data(), INFINI_F32, {len}, deviceType,
+                                  rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        if (rank == 0) {
+            CHECK_RUN(infinicclSend(comm, buf->data(), len, INFINI_F32, 1,
+                                    stream));
+            CHECK_RUN(infinicclRecv(comm, buf->data(), len, INFINI_F32, 1,
+                                    stream));
+        } else {
+            CHECK_RUN(infinicclRecv(comm, buf->data(), len, INFINI_F32, 0,
+                                    stream));
+            CHECK_RUN(infinicclSend(comm, buf->data(), len, INFINI_F32, 0,
+                                    stream));
+        }
+        auto out = std::vector<float>();
+        CHECK_RUN(read_back(deviceType, rank, stream, buf, out));
+        TEST_EQUAL(out, rank_data(0, len));
+        return TEST_PASSED;
+    });
+}
+
+// The residual is read from recvbuf itself, as the model does in place.
+int test_allreduce_sum_rmsnorm(DeviceType deviceType) {
+    size_t nrow = 3, dim = 8;
+    float epsilon = 1e-5f;
+    auto residual = rank_data(0, nrow * dim);
+    auto weight = std::vector<float>(dim);
+    for (size_t i = 0; i < dim; i++) {
+        weight[i] = 0.5f + i;
+    }
+    auto sum = residual;
+    for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+        auto data = rank_data(r, nrow * dim);
+        for (size_t i = 0; i < sum.size(); i++) {
+            sum[i] += data[i];
+        }
+    }
+    auto norm = std::vector<float>(nrow * dim);
+    for (size_t row = 0; row < nrow; row++) {
+        float ss = 0;
+        for (size_t i = 0; i < dim; i++) {
+            ss += sum[row * dim + i] * sum[row * dim + i];
+        }
+        float scale = 1.f / std::sqrt(ss / dim + epsilon);
+        for (size_t i = 0; i < dim; i++) {
+            norm[row * dim + i] = sum[row * dim + i] * scale * weight[i];
+        }
+    }
+    return run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto data = rank_data(rank, nrow * dim);
+        auto zeros = std::vector<float>(nrow * dim, 0);
+        auto send_buf = Tensor::weight(data.data(), INFINI_F32, {nrow, dim},
+                                       deviceType, rank);
+        auto recv_buf = Tensor::weight(residual.data(), INFINI_F32,
+                                       {nrow, dim}, deviceType, rank);
+        auto norm_buf = Tensor::weight(zeros.data(), INFINI_F32, {nrow, dim},
+                                       deviceType, rank);
+        auto weight_buf = Tensor::weight(weight.data(), INFINI_F32, {dim},
+                                         deviceType, rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        auto status = infinicclAllReduceSumRMSNorm(
+            comm, send_buf->data(), recv_buf->data(), recv_buf->data(),
+            norm_buf->data(), weight_buf->data(), nrow, dim, epsilon,
+            INFINI_F32, INFINI_F32, stream);
+        if (status == INFINICCL_STATUS_DEVICE_NOT_SUPPORTED) {
+            // Optional for backends; every rank skips alike.
+            CHECK_RUN(infinirtStreamDestroy(stream));
+            return TEST_PASSED;
+        }
+        CHECK_RUN(status);
+        auto out = std::vector<float>();
+        CHECK_RUN(infinirtStreamSynchronize(stream));
+        out.resize(nrow * dim);
+        CHECK_RUN(infinirtMemcpyD2H(out.data(), recv_buf->data(), deviceType,
+                                    rank, recv_buf->byte_size()));
+        TEST_EQUAL(out, sum);
+        CHECK_RUN(read_back(deviceType, rank, stream, norm_buf, out));
+        for (size_t i = 0; i < norm.size(); i++) {
+            TEST_TRUE(std::fabs(out[i] - norm[i]) <= 1e-5f * std::fabs(norm[i]));
+        }
+        return TEST_PASSED;
+    });
+}
+
+// Compared against the exact sum; every rank must also see identical values.
+int test_allreduce_sum_compressed(DeviceType deviceType,
+                                  infinicclCompression_t compression,
+                                  float tolerance) {
+    size_t len = 1001;
+    auto inputs = std::vector<std::vector<float>>(TEST_GROUP_SIZE);
+    auto exact = std::vector<float>(len, 0.f);
+    for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+        std::mt19937 gen(r);
+        std::uniform_real_distribution<float> dist(-4.f, 4.f);
+        for (size_t i = 0; i < len; i++) {
+            inputs[r].push_back(dist(gen));
+            exact[i] += inputs[r][i];
+        }
+    }
+    float max_exact = 0;
+    for (auto val : exact) {
+        max_exact = std::max(max_exact, std::fabs(val));
+    }
+    auto outputs = std::vector<std::vector<float>>(TEST_GROUP_SIZE);
+    CHECK_RUN(run_group(deviceType, [&](uint32_t rank, infinicclComm_t comm) {
+        auto buf = Tensor::weight(inputs[rank].data(), INFINI_F32, {len},
+                                  deviceType, rank);
+        infinirtStream_t stream;
+        CHECK_RUN(infinirtStreamCreate(&stream, deviceType, rank));
+        auto status = infinicclAllReduceSumCompressed(
+            comm, buf->data(), buf->data(), len, INFINI_F32, compression,
+            stream);
+        if (status == INFINICCL_STATUS_DEVICE_NOT_SUPPORTED) {
+            CHECK_RUN(infinirtStreamDestroy(stream));
+            outputs[rank] = exact;
+            return TEST_PASSED;
+        }
+        CHECK_RUN(status);
+        return read_back(deviceType, rank, stream, buf, outputs[rank]);
+    }));
+    for (uint32_t r = 0; r < TEST_GROUP_SIZE; r++) {
+        TEST_EQUAL(outputs[r], outputs[0]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        TEST_TRUE(std::fabs(outputs[0][i] - exact[i]) <= tolerance * max_exact);
+    }
+    return TEST_PASSED;
+}
+
 void test_ccl(DeviceType deviceType) {
     RUN_TEST(test_allreduce_sum(deviceType));
+    RUN_TEST(test_allreduce_sum_inplace_f16(deviceType));
+    RUN_TEST(test_allreduce_sum_f16_rounding(deviceType));
+    // The group tests once per way of creating communicators.
+    for (bool by_rank : {false, true}) {
+        init_by_rank = by_rank;
+        RUN_TEST(test_allreduce_sum_uneven(deviceType));
+        RUN_TEST(test_allgather(deviceType));
+        RUN_TEST(test_reduce_scatter_sum(deviceType));
+        RUN_TEST(test_broadcast(deviceType));
+        RUN_TEST(test_send_recv(deviceType));
+        RUN_TEST(test_allreduce_sum_rmsnorm(deviceType));
+        RUN_TEST(test_allreduce_sum_compressed(
+            deviceType, INFINICCL_COMPRESSION_NONE, 1e-6f));
+        RUN_TEST(test_allreduce_sum_compressed(
+            deviceType, INFINICCL_COMPRESSION_INT8, 0.02f));
+        RUN_TEST(test_allreduce_sum_compressed(
+            deviceType, INFINICCL_COMPRESSION_FP8_E4M3, 0.1f));
+    }
+    init_by_rank = false;
 }
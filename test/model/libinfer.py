@@ -1,6 +1,6 @@
 
 import ctypes
-from ctypes import c_uint, c_float, c_void_p, POINTER
+from ctypes import c_uint, c_float, c_size_t, c_void_p, POINTER
 import os
 
 class DataType(ctypes.c_int):
@@ -25,6 +25,60 @@ class DeviceType(ctypes.c_int):
     DEVICE_TYPE_CUDA = 1
     DEVICE_TYPE_CAMBRICON = 2
     DEVICE_TYPE_ASCEND = 3
+    DEVICE_TYPE_SIM = 4
+
+class InferMode(ctypes.c_int):
+    INFER_MODE_DEFAULT = 0
+    INFER_MODE_DUAL_STREAM = 1
+
+class CommCompression(ctypes.c_int):
+    INFINICCL_COMPRESSION_NONE = 0
+    INFINICCL_COMPRESSION_INT8 = 1
+    INFINICCL_COMPRESSION_FP8_E4M3 = 2
+
+class MemoryCategory(ctypes.c_int):
+    MEMORY_CATEGORY_WEIGHT = 0
+    MEMORY_CATEGORY_KV_CACHE = 1
+    MEMORY_CATEGORY_ACTIVATION = 2
+    MEMORY_CATEGORY_WORKSPACE = 3
+    MEMORY_CATEGORY_COUNT = 4
+
+class MemoryStats(ctypes.Structure):
+    _fields_ = [
+        ("current", c_size_t * MemoryCategory.MEMORY_CATEGORY_COUNT),
+        ("peak", c_size_t * MemoryCategory.MEMORY_CATEGORY_COUNT),
+        ("total", c_size_t),
+        ("total_peak", c_size_t),
+    ]
+
+class SpeculativeStats(ctypes.Structure):
+    _fields_ = [
+        ("rounds", c_size_t),
+        ("proposed", c_size_t),
+        ("accepted", c_size_t),
+    ]
+
+class InferOutputRows(ctypes.c_int):
+    INFER_OUTPUT_LAST = 0
+    INFER_OUTPUT_ALL = 1
+
+class InferOutputs(ctypes.Structure):
+    _fields_ = [
+        ("rows", InferOutputRows),
+        ("logits", c_void_p),
+        ("nlogprobs", c_uint),
+        ("logprob_ids", POINTER(c_uint)),
+        ("logprobs", POINTER(c_float)),
+        ("hidden", c_void_p),
+    ]
+
+class PrefixCacheStats(ctypes.Structure):
+    _fields_ = [
+        ("lookup_tokens", c_size_t),
+        ("hit_tokens", c_size_t),
+        ("resident_tokens", c_size_t),
+        ("evicted_tokens", c_size_t),
+    ]
 
 class LlamaMeta(ctypes.Structure):
     _fields_ = [
@@ -65,6 +119,9 @@ class Model(ctypes.Structure):
 class KVCache(ctypes.Structure):
     pass
 
+class PrefixCache(ctypes.Structure):
+    pass
+
 
 def open_library():    
     lib_path = os.path.join(os.environ.get("INFINI_ROOT"), "lib", "libinfiniinfer.so")
@@ -77,9 +134,51 @@ def open_library():
         c_uint,  # unsigned int ndev
         POINTER(c_uint),  # unsigned int const *dev_ids
     ]
+    lib.create_model_parallel.restype = POINTER(Model)
+    lib.create_model_parallel.argtypes = [
+        POINTER(LlamaMeta),  # LlamaMeta const *
+        POINTER(LlamaWeights),  # LlamaWeights const *
+        DeviceType,  # DeviceType
+        c_uint,  # unsigned int tp
+        c_uint,  # unsigned int pp
+        POINTER(c_uint),  # unsigned int const *dev_ids
+    ]
+    lib.create_model_with_comm.restype = POINTER(Model)
+    lib.create_model_with_comm.argtypes = [
+        POINTER(LlamaMeta),  # LlamaMeta const *
+        POINTER(LlamaWeights),  # LlamaWeights const *
+        DeviceType,  # DeviceType
+        c_uint,  # unsigned int dev_id
+        c_void_p,  # infinicclComm_t comm
+        c_uint,  # unsigned int rank
+        c_uint,  # unsigned int nrank
+    ]
 
+    lib.set_infer_mode.restype = None
+    lib.set_infer_mode.argtypes = [POINTER(Model), InferMode]
+    lib.set_comm_overlap.restype = None
+    lib.set_comm_overlap.argtypes = [POINTER(Model), c_uint]
+    lib.set_comm_compression.restype = None
+    lib.set_comm_compression.argtypes = [POINTER(Model), CommCompression]
+    lib.set_prefill_chunk.restype = None
+    lib.set_prefill_chunk.argtypes = [POINTER(Model), c_uint]
+    lib.get_memory_stats.restype = None
+    lib.get_memory_stats.argtypes = [POINTER(Model), c_uint, POINTER(MemoryStats)]
     lib.create_kv_cache.restype = POINTER(KVCache)
     lib.drop_kv_cache.argtypes= [ctypes.POINTER(Model), POINTER(KVCache)]
+    lib.create_prefix_cache.restype = POINTER(PrefixCache)
+    lib.create_prefix_cache.argtypes = [POINTER(Model), c_size_t]
+    lib.prefix_cache_match.restype = c_uint
+    lib.prefix_cache_match.argtypes = [
+        POINTER(PrefixCache), c_uint, POINTER(c_uint), POINTER(KVCache)
+    ]
+    lib.prefix_cache_insert.restype = None
+    lib.prefix_cache_insert.argtypes = [
+        POINTER(PrefixCache), c_uint, POINTER(c_uint), POINTER(KVCache)
+    ]
+    lib.get_prefix_cache_stats.restype = None
+    lib.get_prefix_cache_stats.argtypes = [POINTER(PrefixCache), POINTER(PrefixCacheStats)]
+    lib.destroy_prefix_cache.argtypes = [POINTER(PrefixCache)]
     lib.infer.restype = None
     lib.infer.argtypes = [
         ctypes.POINTER(Model),  # struct Model const *
@@ -94,5 +193,53 @@ def open_library():
         c_uint,  # unsigned int topk
         c_float,  # float topp
     ]
+    lib.infer_pass.restype = None
+    lib.infer_pass.argtypes = [
+        ctypes.POINTER(Model),  # struct Model const *
+        c_uint,  # unsigned int ntok
+        POINTER(c_uint),  # unsigned int const *tokens
+        c_uint,  # unsigned int nreq
+        POINTER(c_uint),  # unsigned int const *req_lens
+        POINTER(c_uint),  # unsigned int const *req_pos
+        POINTER(POINTER(KVCache)),  # struct KVCache **kv_caches
+        POINTER(c_uint),  # unsigned int *ans
+        POINTER(c_uint),  # unsigned int *req_done
+        c_float,  # float temperature
+        c_uint,  # unsigned int topk
+        c_float,  # float topp
+    ]
+    lib.infer_ex.restype = None
+    lib.infer_ex.argtypes = [
+        ctypes.POINTER(Model),  # struct Model const *
+        c_uint,  # unsigned int ntok
+        POINTER(c_uint),  # unsigned int const *tokens
+        c_uint,  # unsigned int nreq
+        POINTER(c_uint),  # unsigned int const *req_lens
+        POINTER(c_uint),  # unsigned int const *req_pos
+        POINTER(POINTER(KVCache)),  # struct KVCache **kv_caches
+        POINTER(InferOutputs),  # InferOutputs const *outputs
+        POINTER(c_uint),  # unsigned int *ans
+        c_float,  # float temperature
+        c_uint,  # unsigned int topk
+        c_float,  # float topp
+    ]
+    lib.infer_speculative.restype = None
+    lib.infer_speculative.argtypes = [
+        ctypes.POINTER(Model),  # struct Model *model
+        ctypes.POINTER(Model),  # struct Model const *draft
+        c_uint,  # unsigned int nreq
+        POINTER(c_uint),  # unsigned int const *tokens
+        POINTER(c_uint),  # unsigned int const *req_pos
+        POINTER(POINTER(KVCache)),  # struct KVCache **kv_caches
+        POINTER(POINTER(KVCache)),  # struct KVCache **draft_kv_caches
+        c_uint,  # unsigned int k
+        POINTER(c_uint),  # unsigned int *ans
+        POINTER(c_uint),  # unsigned int *ans_lens
+        c_float,  # float temperature
+        c_uint,  # unsigned int topk
+        c_float,  # float topp
+    ]
+    lib.get_speculative_stats.restype = None
+    lib.get_speculative_stats.argtypes = [POINTER(Model), POINTER(SpeculativeStats)]
     
     return lib
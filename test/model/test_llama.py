@@ -119,7 +119,7 @@ class LlamaWeightsHF(LlamaWeights):
         )
 
 class LlamaModel():
-    def __init__(self, model_dir_path, device=DeviceType.DEVICE_TYPE_CPU, n_device = 1):
+    def __init__(self, model_dir_path, device=DeviceType.DEVICE_TYPE_CPU, n_device = 1, n_stage = 1):
         llama = transformers.LlamaForCausalLM.from_pretrained(
             model_dir_path, torch_dtype=torch.float16
         )
@@ -147,13 +147,18 @@ class LlamaModel():
             theta=llama.config.rope_theta,
         )
 
-        self.weights = LlamaWeightsHF(llama, n_device)
+        # n_device devices split into n_stage pipeline stages, each stage
+        # tensor-parallel over the rest.
+        assert n_device % n_stage == 0
+        tp = n_device // n_stage
+        self.weights = LlamaWeightsHF(llama, tp)
         dev_ids = (c_uint * n_device)(*[i for i in range(n_device)])
-        self.model_instance = lib.create_model(
+        self.model_instance = lib.create_model_parallel(
             ctypes.byref(self.meta),
             ctypes.byref(self.weights),
             device,
-            n_device,
+            tp,
+            n_stage,
             dev_ids,
         )
     
@@ -208,7 +213,7 @@ class LlamaModel():
 
 def test():
     if len(sys.argv) < 3:
-        print("Usage: python test_llama.py [--cpu | --cuda | --cambricon | --ascend] <path/to/model_dir> [n_device]")
+        print("Usage: python test_llama.py [--cpu | --cuda | --cambricon | --ascend | --sim] <path/to/model_dir> [n_device] [n_stage]")
         sys.exit(1)
     model_path =  sys.argv[2]
     device_type = DeviceType.DEVICE_TYPE_CPU
@@ -220,12 +225,15 @@ def test():
         device_type = DeviceType.DEVICE_TYPE_CAMBRICON
     elif sys.argv[1] == "--ascend":
         device_type = DeviceType.DEVICE_TYPE_ASCEND
+    elif sys.argv[1] == "--sim":
+        device_type = DeviceType.DEVICE_TYPE_SIM
     else:
-        print("Usage: python test_llama.py [--cpu | --cuda | --cambricon | --ascend] <path/to/model_dir> [n_device]")
+        print("Usage: python test_llama.py [--cpu | --cuda | --cambricon | --ascend | --sim] <path/to/model_dir> [n_device] [n_stage]")
         sys.exit(1)
     
     ndev = int(sys.argv[3]) if len(sys.argv) > 3 else 1
-    model = LlamaModel(model_path, device_type, ndev)
+    nstage = int(sys.argv[4]) if len(sys.argv) > 4 else 1
+    model = LlamaModel(model_path, device_type, ndev, nstage)
     model.infer("讲个长故事", 500)
 
 if __name__ == "__main__":
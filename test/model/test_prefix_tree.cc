@@ -0,0 +1,135 @@
+#include "../../src/models/prefix_tree.h"
+#include "../test.h"
+#include <vector>
+
+// Blocks record the tokens they were made for, so every span can be checked
+// against the sequence it matched.
+using Tokens = std::vector<unsigned int>;
+
+Tokens make_block(Tokens const &tokens, size_t pos, size_t len) {
+    return Tokens(tokens.begin() + pos, tokens.begin() + pos + len);
+}
+
+// Total length of the spans, after checking they tile [0, n) with the
+// right tokens.
+size_t matched(std::vector<PrefixTree<Tokens>::Span> const &spans,
+               Tokens const &tokens) {
+    size_t pos = 0;
+    for (auto const &span : spans) {
+        if (span.pos != pos) {
+            return SIZE_MAX;
+        }
+        for (size_t i = 0; i < span.len; i++) {
+            if ((*span.block)[span.offset + i] != tokens[pos + i]) {
+                return SIZE_MAX;
+            }
+        }
+        pos += span.len;
+    }
+    return pos;
+}
+
+int test_prefix_tree_match() {
+    auto tree = PrefixTree<Tokens>(100);
+    auto a = Tokens{1, 2, 3, 4, 5, 6};
+    auto b = Tokens{1, 2, 3, 7, 8};
+    TEST_EQUAL(matched(tree.match(a.data(), a.size()), a), 0);
+    TEST_EQUAL(tree.insert(a.data(), a.size(),
+                           [&](size_t pos, size_t len) {
+                               return make_block(a, pos, len);
+                           }),
+               6);
+    // A partial edge matches up to the first differing token.
+    TEST_EQUAL(matched(tree.match(b.data(), b.size()), b), 3);
+    // Inserting b splits a's edge and stores only b's new tail.
+    size_t made_at = 0;
+    TEST_EQUAL(tree.insert(b.data(), b.size(),
+                           [&](size_t pos, size_t len) {
+                               made_at = pos;
+                               return make_block(b, pos, len);
+                           }),
+               2);
+    TEST_EQUAL(made_at, 3);
+    TEST_EQUAL(tree.resident(), 8);
+    TEST_EQUAL(matched(tree.match(a.data(), a.size()), a), 6);
+    TEST_EQUAL(matched(tree.match(b.data(), b.size()), b), 5);
+    auto c = Tokens{1, 2, 3, 4, 9};
+    TEST_EQUAL(matched(tree.match(c.data(), c.size()), c), 4);
+    TEST_EQUAL(tree.insert(a.data(), a.size(),
+                           [&](size_t, size_t) { return Tokens(); }),
+               0);
+    return TEST_PASSED;
+}
+
+int test_prefix_tree_evict() {
+    auto tree = PrefixTree<Tokens>(10);
+    auto a = Tokens{1, 2, 3, 4};
+    auto b = Tokens{5, 6, 7, 8};
+    auto c = Tokens{9, 10, 11, 12};
+    auto insert = [&](Tokens const &tokens) {
+        return tree.insert(tokens.data(), tokens.size(),
+                           [&](size_t pos, size_t len) {
+                               return make_block(tokens, pos, len);
+                           });
+    };
+    insert(a);
+    insert(b);
+    // a is used more recently than b, so b goes first.
+    tree.match(a.data(), a.size());
+    insert(c);
+    TEST_EQUAL(tree.resident(), 8);
+    TEST_EQUAL(tree.evicted(), 4);
+    TEST_EQUAL(matched(tree.match(b.data(), b.size()), b), 0);
+    TEST_EQUAL(matched(tree.match(a.data(), a.size()), a), 4);
+    TEST_EQUAL(matched(tree.match(c.data(), c.size()), c), 4);
+    // A split block stays resident until its last window is evicted.
+    auto d = Tokens{1, 2, 13};
+    insert(d);
+    tree.evict(6);
+    TEST_EQUAL(tree.resident(), 5);
+    TEST_EQUAL(matched(tree.match(d.data(), d.size()), d), 3);
+    tree.evict(0);
+    TEST_EQUAL(tree.resident(), 0);
+    TEST_EQUAL(matched(tree.match(d.data(), d.size()), d), 0);
+    return TEST_PASSED;
+}
+
+// A sequence longer than the capacity is truncated to what fits next to
+// its cached prefix instead of wiping the tree.
+int test_prefix_tree_oversized() {
+    auto tree = PrefixTree<Tokens>(10);
+    auto insert = [&](Tokens const &tokens) {
+        return tree.insert(tokens.data(), tokens.size(),
+                           [&](size_t pos, size_t len) {
+                               return make_block(tokens, pos, len);
+                           });
+    };
+    auto a = Tokens{1, 2, 3, 4};
+    auto b = Tokens{5, 6, 7};
+    insert(a);
+    insert(b);
+    auto c = Tokens{1, 2, 3, 4, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    // a's 4 tokens stay under the new leaf, leaving room for 6 more; b is
+    // evicted to make that room.
+    TEST_EQUAL(insert(c), 6);
+    TEST_EQUAL(tree.resident(), 10);
+    TEST_EQUAL(tree.evicted(), 3);
+    TEST_EQUAL(matched(tree.match(c.data(), c.size()), c), 10);
+    TEST_EQUAL(matched(tree.match(a.data(), a.size()), a), 4);
+    TEST_EQUAL(matched(tree.match(b.data(), b.size()), b), 0);
+    // With no cached prefix the sequence is cut to the capacity.
+    auto d = Tokens(25);
+    for (size_t i = 0; i < d.size(); i++) {
+        d[i] = 100 + i;
+    }
+    TEST_EQUAL(insert(d), 10);
+    TEST_EQUAL(tree.resident(), 10);
+    TEST_EQUAL(matched(tree.match(d.data(), d.size()), d), 10);
+    return TEST_PASSED;
+}
+
+void test_prefix_tree() {
+    RUN_TEST(test_prefix_tree_match());
+    RUN_TEST(test_prefix_tree_evict());
+    RUN_TEST(test_prefix_tree_oversized());
+}
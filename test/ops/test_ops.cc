@@ -0,0 +1,219 @@
+#include "../../src/ops/sample_candidates.h"
+#include "../../src/ops/top_logprobs.h"
+#include "../../src/ops/varlen_attention.h"
+#include "../test.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+constexpr size_t NH = 4, NKVH = 2, DH = 8, MAX_LEN = 16;
+constexpr size_t QKV_STRIDE = (NH + 2 * NKVH) * DH;
+
+inline float to_float(float x) { return x; }
+inline float to_float(uint16_t x) { return f16_to_f32(x); }
+inline void from_float(float &dst, float x) { dst = x; }
+inline void from_float(uint16_t &dst, float x) { dst = f32_to_f16(x); }
+
+// Three requests in one batch: a prompt, a decode step and a later prompt
+// chunk, on grouped heads.
+template <typename T>
+int check_varlen_attention(InfiniDataType_t dtype, float tolerance) {
+    auto past_lens = std::vector<size_t>{0, 6, 3};
+    auto cu_seqlens = std::vector<size_t>{0, 5, 6, 8};
+    size_t nreq = past_lens.size(), ntok = cu_seqlens.back();
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    auto random = [&](std::vector<T> &data) {
+        for (auto &x : data) {
+            from_float(x, dist(gen));
+        }
+    };
+    auto qkv = std::vector<T>(ntok * QKV_STRIDE);
+    random(qkv);
+    auto k_caches = std::vector<std::vector<T>>(nreq);
+    auto v_caches = std::vector<std::vector<T>>(nreq);
+    auto k_ptrs = std::vector<void *>(nreq), v_ptrs = std::vector<void *>(nreq);
+    for (size_t req = 0; req < nreq; req++) {
+        k_caches[req].resize(NKVH * MAX_LEN * DH);
+        v_caches[req].resize(NKVH * MAX_LEN * DH);
+        random(k_caches[req]);
+        random(v_caches[req]);
+        k_ptrs[req] = k_caches[req].data();
+        v_ptrs[req] = v_caches[req].data();
+    }
+    // Reference caches with the new rows appended.
+    auto k_ref = k_caches, v_ref = v_caches;
+    for (size_t req = 0; req < nreq; req++) {
+        for (size_t row = cu_seqlens[req]; row < cu_seqlens[req + 1]; row++) {
+            auto pos = past_lens[req] + row - cu_seqlens[req];
+            for (size_t h = 0; h < NKVH; h++) {
+                for (size_t x = 0; x < DH; x++) {
+                    auto dst = (h * MAX_LEN + pos) * DH + x;
+                    k_ref[req][dst] = qkv[row * QKV_STRIDE + (NH + h) * DH + x];
+                    v_ref[req][dst] =
+                        qkv[row * QKV_STRIDE + (NH + NKVH + h) * DH + x];
+                }
+            }
+        }
+    }
+
+    auto o = std::vector<T>(ntok * NH * DH);
+    auto desc = VarlenAttentionDesc{dtype,
+                                    NH,
+                                    NKVH,
+                                    DH,
+                                    QKV_STRIDE,
+                                    QKV_STRIDE,
+                                    NH * DH,
+                                    MAX_LEN * DH};
+    varlen_attention(desc, o.data(), qkv.data(), qkv.data() + NH * DH,
+                     qkv.data() + (NH + NKVH) * DH, nreq, cu_seqlens.data(),
+                     past_lens.data(), k_ptrs.data(), v_ptrs.data(), 4);
+
+    for (size_t req = 0; req < nreq; req++) {
+        TEST_TRUE(k_caches[req] == k_ref[req]);
+        TEST_TRUE(v_caches[req] == v_ref[req]);
+    }
+    for (size_t req = 0; req < nreq; req++) {
+        for (size_t row = cu_seqlens[req]; row < cu_seqlens[req + 1]; row++) {
+            auto total = past_lens[req] + row - cu_seqlens[req] + 1;
+            for (size_t h = 0; h < NH; h++) {
+                auto kv = h / (NH / NKVH);
+                auto scores = std::vector<double>(total);
+                double max = -INFINITY, sum = 0;
+                for (size_t j = 0; j < total; j++) {
+                    double dot = 0;
+                    for (size_t x = 0; x < DH; x++) {
+                        dot += to_float(qkv[row * QKV_STRIDE + h * DH + x]) *
+                               to_float(k_ref[req][(kv * MAX_LEN + j) * DH + x]);
+                    }
+                    scores[j] = dot / std::sqrt(double(DH));
+                    max = std::max(max, scores[j]);
+                }
+                for (auto &s : scores) {
+                    s = std::exp(s - max);
+                    sum += s;
+                }
+                for (size_t x = 0; x < DH; x++) {
+                    double expected = 0;
+                    for (size_t j = 0; j < total; j++) {
+                        auto value = v_ref[req][(kv * MAX_LEN + j) * DH + x];
+                        expected += scores[j] / sum * to_float(value);
+                    }
+                    auto actual = to_float(o[(row * NH + h) * DH + x]);
+                    TEST_TRUE(std::fabs(actual - expected) <= tolerance);
+                }
+            }
+        }
+    }
+    return TEST_PASSED;
+}
+
+int test_varlen_attention_f32() {
+    return check_varlen_attention<float>(INFINI_F32, 1e-5f);
+}
+
+int test_varlen_attention_f16() {
+    return check_varlen_attention<uint16_t>(INFINI_F16, 2e-3f);
+}
+
+// Two rows of distinct f16 logits, so the top ids are unambiguous.
+int test_top_logprobs() {
+    constexpr size_t DVOC = 6;
+    constexpr unsigned int N = 3;
+    auto values = std::vector<float>{0.5f, 2.f, -1.f, 1.f, 0.f, 3.f,
+                                     -2.f, -0.5f, 4.f, 0.25f, 1.5f, -3.f};
+    auto logits = std::vector<uint16_t>(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        logits[i] = f32_to_f16(values[i]);
+    }
+    auto ids = std::vector<unsigned int>(2 * N);
+    auto logprobs = std::vector<float>(2 * N);
+    top_logprobs(INFINI_F16, logits.data(), 2, DVOC, N, ids.data(),
+                 logprobs.data(), 2);
+    TEST_TRUE((ids == std::vector<unsigned int>{5, 1, 3, 2, 4, 3}));
+    for (size_t r = 0; r < 2; r++) {
+        double sum = 0;
+        for (size_t i = 0; i < DVOC; i++) {
+            sum += std::exp(double(values[r * DVOC + i]));
+        }
+        for (size_t i = 0; i < N; i++) {
+            auto expected = values[r * DVOC + ids[r * N + i]] - std::log(sum);
+            TEST_TRUE(std::fabs(logprobs[r * N + i] - expected) <= 1e-5);
+        }
+    }
+    return TEST_PASSED;
+}
+
+// Draws from the candidate records of three uneven vocabulary shards must
+// match the rule applied directly to the full rows.
+int test_sample_candidates() {
+    constexpr size_t NROW = 4, DVOC = 50;
+    constexpr unsigned int K = 5;
+    constexpr float TEMPERATURE = 0.7f, TOPP = 0.9f;
+    auto shard_begin = std::vector<size_t>{0, 20, 37, DVOC};
+    size_t nshard = shard_begin.size() - 1;
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> dist(-3.f, 3.f);
+    auto logits = std::vector<float>(NROW * DVOC);
+    for (auto &x : logits) {
+        x = dist(gen);
+    }
+    auto random_vals = std::vector<float>{0.f, 0.3f, 0.75f, 0.999f};
+
+    for (unsigned int k : {1u, K}) {
+        auto size = candidate_record_size(k);
+        auto records = std::vector<char>(nshard * NROW * size);
+        for (size_t s = 0; s < nshard; s++) {
+            auto len = shard_begin[s + 1] - shard_begin[s];
+            auto shard = std::vector<float>(NROW * len);
+            for (size_t r = 0; r < NROW; r++) {
+                std::copy_n(logits.begin() + r * DVOC + shard_begin[s], len,
+                            shard.begin() + r * len);
+            }
+            shard_candidates(INFINI_F32, shard.data(), NROW, len,
+                             shard_begin[s], k, TEMPERATURE,
+                             records.data() + s * NROW * size, 2);
+        }
+        auto result = std::vector<uint64_t>(NROW);
+        sample_candidates(records.data(), nshard, NROW, k, TEMPERATURE, TOPP,
+                          random_vals.data(), result.data());
+
+        for (size_t r = 0; r < NROW; r++) {
+            auto row = logits.begin() + r * DVOC;
+            auto order = std::vector<uint32_t>(DVOC);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return row[a] > row[b];
+            });
+            double total = 0;
+            for (size_t i = 0; i < DVOC; i++) {
+                total += std::exp((row[i] - row[order[0]]) / TEMPERATURE);
+            }
+            auto cumulative = std::vector<double>(k);
+            double acc = 0;
+            for (size_t i = 0; i < k; i++) {
+                acc += std::exp((row[order[i]] - row[order[0]]) / TEMPERATURE) /
+                       total;
+                cumulative[i] = acc;
+            }
+            auto threshold = random_vals[r] * std::min<double>(TOPP, acc);
+            size_t pick = 0;
+            while (pick + 1 < k && cumulative[pick] < threshold) {
+                pick++;
+            }
+            TEST_EQUAL(result[r], order[pick]);
+        }
+    }
+    return TEST_PASSED;
+}
+
+void test_ops() {
+    RUN_TEST(test_varlen_attention_f32());
+    RUN_TEST(test_varlen_attention_f16());
+    RUN_TEST(test_top_logprobs());
+    RUN_TEST(test_sample_candidates());
+}
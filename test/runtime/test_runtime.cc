@@ -0,0 +1,390 @@
+#include "../../include/infinirt.h"
+#include "../test.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define CHECK_RUN(EXPR)                                                        \
+    do {                                                                       \
+        int code = static_cast<int>(EXPR);                                     \
+        if (code != 0) {                                                       \
+            printf("Error at %s:%d with code %d\n", __FILE__, __LINE__, code); \
+            return TEST_FAILED;                                                \
+        }                                                                      \
+    } while (0)
+
+int test_load_backend(DeviceType deviceType) {
+    CHECK_RUN(infinirtInit(deviceType));
+    // A missing plugin leaves the registered backend in place.
+    TEST_TRUE(infinirtLoadBackend(deviceType, "/nonexistent/libinfinirt.so") ==
+              INFINIRT_STATUS_DEVICE_NOT_SUPPORTED);
+    CHECK_RUN(infinirtDeviceSynchronize(deviceType, 0));
+    return TEST_PASSED;
+}
+
+// The SIM backend built as a plugin (target infinirt_sim) sits next to the
+// test binary. Linked as libinfinirt_cambricon.so into a directory on
+// INFINIRT_BACKEND_PATH, infinirtInit discovers it for the Cambricon slot,
+// which has no built-in backend. Streams and events it creates are tagged
+// with that slot, so the asynchronous calls below reach the plugin rather
+// than the built-in SIM table.
+int test_load_backend_plugin() {
+    char exe[4096];
+    auto len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    TEST_TRUE(len > 0);
+    auto dir = std::string(exe, len);
+    auto path = dir.substr(0, dir.rfind('/')) + "/libinfinirt_sim.so";
+    char plugin_dir[] = "/tmp/infinirt_plugin_XXXXXX";
+    TEST_TRUE(mkdtemp(plugin_dir) != nullptr);
+    auto link = std::string(plugin_dir) + "/libinfinirt_cambricon.so";
+    TEST_TRUE(symlink(path.c_str(), link.c_str()) == 0);
+    auto old_path = getenv("INFINIRT_BACKEND_PATH");
+    auto saved = old_path != nullptr ? std::string(old_path) : std::string();
+    setenv("INFINIRT_BACKEND_PATH", plugin_dir, 1);
+    auto status = infinirtInit(DEVICE_CAMBRICON);
+    if (old_path != nullptr) {
+        setenv("INFINIRT_BACKEND_PATH", saved.c_str(), 1);
+    } else {
+        unsetenv("INFINIRT_BACKEND_PATH");
+    }
+    unlink(link.c_str());
+    rmdir(plugin_dir);
+    CHECK_RUN(status);
+    // Loading the same library again is a no-op; the built-in SIM slot stays.
+    CHECK_RUN(infinirtLoadBackend(DEVICE_CAMBRICON, path.c_str()));
+    TEST_TRUE(infinirtLoadBackend(DEVICE_SIM, path.c_str()) ==
+              INFINIRT_STATUS_INVALID_ARGUMENT);
+
+    auto data = std::vector<float>{1.0, 2.0, 3.0, 4.0};
+    auto result = std::vector<float>(data.size());
+    size_t size = data.size() * sizeof(float);
+    void *a, *b;
+    CHECK_RUN(infinirtMalloc(&a, DEVICE_CAMBRICON, 0, size));
+    CHECK_RUN(infinirtMalloc(&b, DEVICE_CAMBRICON, 0, size));
+    infinirtStream_t stream;
+    infinirtEvent_t event;
+    CHECK_RUN(infinirtStreamCreate(&stream, DEVICE_CAMBRICON, 0));
+    CHECK_RUN(infinirtEventCreate(&event, DEVICE_CAMBRICON, 0));
+    DeviceType streamDevice;
+    CHECK_RUN(infinirtGetStreamDeviceInfo(&streamDevice, nullptr, stream));
+    TEST_TRUE(streamDevice == DEVICE_CAMBRICON);
+    CHECK_RUN(infinirtMemcpyH2DAsync(a, DEVICE_CAMBRICON, 0, data.data(), size,
+                                     stream));
+    CHECK_RUN(infinirtMemcpyAsync(b, a, DEVICE_CAMBRICON, 0, size, stream));
+    CHECK_RUN(infinirtEventRecord(event, stream));
+    CHECK_RUN(infinirtStreamWaitEvent(event, stream));
+    CHECK_RUN(infinirtMemcpyD2HAsync(result.data(), b, DEVICE_CAMBRICON, 0,
+                                     size, stream));
+    CHECK_RUN(infinirtStreamSynchronize(stream));
+    CHECK_RUN(infinirtEventSynchronize(event));
+    TEST_TRUE(result == data);
+    CHECK_RUN(infinirtEventDestroy(event));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    CHECK_RUN(infinirtFree(a, DEVICE_CAMBRICON, 0));
+    CHECK_RUN(infinirtFree(b, DEVICE_CAMBRICON, 0));
+    return TEST_PASSED;
+}
+
+int test_stream_order(DeviceType deviceType) {
+    auto data = std::vector<float>{1.0, 2.0, 3.0, 4.0};
+    auto result = std::vector<float>(data.size());
+    size_t size = data.size() * sizeof(float);
+    void *a, *b, *c;
+    CHECK_RUN(infinirtMalloc(&a, deviceType, 0, size));
+    CHECK_RUN(infinirtMalloc(&b, deviceType, 0, size));
+    CHECK_RUN(infinirtMalloc(&c, deviceType, 0, size));
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, deviceType, 0));
+    CHECK_RUN(infinirtMemcpyH2DAsync(a, deviceType, 0, data.data(), size, stream));
+    CHECK_RUN(infinirtMemcpyAsync(b, a, deviceType, 0, size, stream));
+    CHECK_RUN(infinirtMemcpyAsync(c, b, deviceType, 0, size, stream));
+    // A synchronous copy waits for the device's streams first.
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), c, deviceType, 0, size));
+    TEST_EQUAL(result, data);
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    CHECK_RUN(infinirtFree(a, deviceType, 0));
+    CHECK_RUN(infinirtFree(b, deviceType, 0));
+    CHECK_RUN(infinirtFree(c, deviceType, 0));
+    return TEST_PASSED;
+}
+
+int test_stream_priority(DeviceType deviceType) {
+    int least, greatest;
+    CHECK_RUN(infinirtDeviceGetStreamPriorityRange(deviceType, 0, &least, &greatest));
+    TEST_TRUE(greatest <= least);
+    infinirtStream_t high, low;
+    CHECK_RUN(infinirtStreamCreateWithPriority(&high, deviceType, 0, greatest));
+    // Out-of-range priorities are clamped rather than rejected.
+    CHECK_RUN(infinirtStreamCreateWithPriority(&low, deviceType, 0, least + 1));
+    auto data = std::vector<float>{1.0, 2.0, 3.0, 4.0};
+    auto result = std::vector<float>(data.size());
+    size_t size = data.size() * sizeof(float);
+    void *a;
+    CHECK_RUN(infinirtMalloc(&a, deviceType, 0, size));
+    CHECK_RUN(infinirtMemcpyH2DAsync(a, deviceType, 0, data.data(), size, low));
+    infinirtEvent_t event;
+    CHECK_RUN(infinirtEventCreate(&event, deviceType, 0));
+    CHECK_RUN(infinirtEventRecord(event, low));
+    CHECK_RUN(infinirtStreamWaitEvent(event, high));
+    CHECK_RUN(infinirtMemcpyD2HAsync(result.data(), a, deviceType, 0, size, high));
+    CHECK_RUN(infinirtStreamSynchronize(high));
+    TEST_EQUAL(result, data);
+    CHECK_RUN(infinirtEventDestroy(event));
+    CHECK_RUN(infinirtStreamDestroy(high));
+    CHECK_RUN(infinirtStreamDestroy(low));
+    CHECK_RUN(infinirtFree(a, deviceType, 0));
+    return TEST_PASSED;
+}
+
+struct HostFlag {
+    std::atomic<int> value{0};
+    int observed = -1;
+};
+
+int test_stream_wait_event(DeviceType deviceType) {
+    infinirtStream_t producer, consumer;
+    CHECK_RUN(infinirtStreamCreate(&producer, deviceType, 0));
+    CHECK_RUN(infinirtStreamCreate(&consumer, deviceType, 0));
+    infinirtEvent_t event;
+    CHECK_RUN(infinirtEventCreate(&event, deviceType, 0));
+    HostFlag flag;
+    CHECK_RUN(infinirtLaunchHostFunc(
+        producer,
+        [](void *p) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            static_cast<HostFlag *>(p)->value = 1;
+        },
+        &flag));
+    CHECK_RUN(infinirtEventRecord(event, producer));
+    CHECK_RUN(infinirtStreamWaitEvent(event, consumer));
+    CHECK_RUN(infinirtLaunchHostFunc(
+        consumer,
+        [](void *p) {
+            auto f = static_cast<HostFlag *>(p);
+            f->observed = f->value;
+        },
+        &flag));
+    CHECK_RUN(infinirtStreamSynchronize(consumer));
+    TEST_EQUAL(flag.observed, 1);
+    TEST_EQUAL(infinirtEventQuery(event), INFINIRT_STATUS_SUCCESS);
+    CHECK_RUN(infinirtEventDestroy(event));
+    CHECK_RUN(infinirtStreamDestroy(producer));
+    CHECK_RUN(infinirtStreamDestroy(consumer));
+    return TEST_PASSED;
+}
+
+int test_event_elapsed_time(DeviceType deviceType) {
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, deviceType, 0));
+    infinirtEvent_t start, end, plain;
+    CHECK_RUN(infinirtEventCreateWithFlags(&start, deviceType, 0,
+                                           INFINIRT_EVENT_ENABLE_TIMING));
+    CHECK_RUN(infinirtEventCreateWithFlags(&end, deviceType, 0,
+                                           INFINIRT_EVENT_ENABLE_TIMING));
+    CHECK_RUN(infinirtEventCreate(&plain, deviceType, 0));
+    CHECK_RUN(infinirtEventRecord(start, stream));
+    CHECK_RUN(infinirtLaunchHostFunc(
+        stream,
+        [](void *) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        },
+        nullptr));
+    CHECK_RUN(infinirtEventRecord(end, stream));
+    CHECK_RUN(infinirtEventRecord(plain, stream));
+    CHECK_RUN(infinirtEventSynchronize(end));
+    float ms = 0;
+    CHECK_RUN(infinirtEventElapsedTime(start, end, &ms));
+    // The stamp is taken when the stream reaches the record, so the host
+    // function's sleep is included.
+    TEST_TRUE(ms >= 15.0f);
+    TEST_TRUE(infinirtEventElapsedTime(start, plain, &ms) ==
+              INFINIRT_STATUS_INVALID_ARGUMENT);
+    CHECK_RUN(infinirtEventDestroy(start));
+    CHECK_RUN(infinirtEventDestroy(end));
+    CHECK_RUN(infinirtEventDestroy(plain));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    return TEST_PASSED;
+}
+
+int test_mem_pool(DeviceType deviceType) {
+    infinirtMemPool_t pool;
+    CHECK_RUN(infinirtMemPoolCreate(&pool, deviceType, 0, nullptr));
+    infinirtStream_t first, second;
+    CHECK_RUN(infinirtStreamCreate(&first, deviceType, 0));
+    CHECK_RUN(infinirtStreamCreate(&second, deviceType, 0));
+    auto stale = std::vector<float>(256, 1.0f);
+    auto fresh = std::vector<float>(256, 2.0f);
+    auto result = std::vector<float>(256);
+    size_t size = fresh.size() * sizeof(float);
+
+    void *a;
+    CHECK_RUN(infinirtMallocFromPoolAsync(&a, size, pool, first));
+    // Keep the first stream busy so the block is still in use when freed.
+    CHECK_RUN(infinirtLaunchHostFunc(
+        first,
+        [](void *) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        },
+        nullptr));
+    CHECK_RUN(infinirtMemcpyH2DAsync(a, deviceType, 0, stale.data(), size, first));
+    CHECK_RUN(infinirtFreeToPoolAsync(a, pool, first));
+
+    // The second stream's write is ordered after the first stream's even
+    // when the cached block is reused.
+    void *b;
+    CHECK_RUN(infinirtMallocFromPoolAsync(&b, size, pool, second));
+    if (deviceType == DEVICE_CPU) {
+        TEST_TRUE(a == b);
+    }
+    CHECK_RUN(infinirtMemcpyH2DAsync(b, deviceType, 0, fresh.data(), size, second));
+    CHECK_RUN(infinirtStreamSynchronize(second));
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), b, deviceType, 0, size));
+    TEST_EQUAL(result, fresh);
+
+    infinirtMemPoolStats_t stats;
+    CHECK_RUN(infinirtMemPoolGetStats(pool, &stats));
+    TEST_TRUE(stats.usedCurrent >= size);
+    TEST_EQUAL(stats.reservedCurrent, stats.reservedPeak);
+    CHECK_RUN(infinirtFreeToPoolAsync(b, pool, second));
+    CHECK_RUN(infinirtStreamSynchronize(second));
+    CHECK_RUN(infinirtMemPoolTrim(pool, 0));
+    CHECK_RUN(infinirtMemPoolGetStats(pool, &stats));
+    TEST_EQUAL(stats.usedCurrent, (size_t)0);
+    TEST_EQUAL(stats.reservedCurrent, (size_t)0);
+    TEST_TRUE(stats.usedPeak >= size);
+
+    CHECK_RUN(infinirtMemPoolDestroy(pool));
+    CHECK_RUN(infinirtStreamDestroy(first));
+    CHECK_RUN(infinirtStreamDestroy(second));
+    return TEST_PASSED;
+}
+
+int test_host_register(DeviceType deviceType) {
+    auto data = std::vector<float>(1024, 3.0f);
+    auto result = std::vector<float>(data.size());
+    size_t size = data.size() * sizeof(float);
+    CHECK_RUN(infinirtHostRegister(data.data(), deviceType, 0, size));
+    // Overlapping ranges are rejected.
+    TEST_EQUAL(infinirtHostRegister(data.data() + 1, deviceType, 0,
+                                    sizeof(float)),
+               INFINIRT_STATUS_ALREADY_REGISTERED);
+    void *device_data;
+    CHECK_RUN(infinirtMalloc(&device_data, deviceType, 0, size));
+    CHECK_RUN(infinirtMemcpyH2D(device_data, deviceType, 0, data.data(), size));
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), device_data, deviceType, 0, size));
+    TEST_EQUAL(result, data);
+    CHECK_RUN(infinirtHostUnregister(data.data(), deviceType, 0));
+    TEST_TRUE(infinirtHostUnregister(data.data(), deviceType, 0) !=
+              INFINIRT_STATUS_SUCCESS);
+    CHECK_RUN(infinirtFree(device_data, deviceType, 0));
+    return TEST_PASSED;
+}
+
+int test_memcpy_peer(DeviceType deviceType) {
+    int can_access = 0;
+    if (infinirtDeviceCanAccessPeer(&can_access, deviceType, 1, 0) !=
+            INFINIRT_STATUS_SUCCESS ||
+        !can_access) {
+        // Needs two devices that can reach each other.
+        return TEST_PASSED;
+    }
+    CHECK_RUN(infinirtDeviceEnablePeerAccess(deviceType, 1, 0));
+    CHECK_RUN(infinirtDeviceEnablePeerAccess(deviceType, 1, 0));
+    auto data = std::vector<float>{5.0, 6.0, 7.0, 8.0};
+    auto result = std::vector<float>(data.size());
+    size_t size = data.size() * sizeof(float);
+    void *src, *dst;
+    CHECK_RUN(infinirtMalloc(&src, deviceType, 0, size));
+    CHECK_RUN(infinirtMalloc(&dst, deviceType, 1, size));
+    CHECK_RUN(infinirtMemcpyH2D(src, deviceType, 0, data.data(), size));
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, deviceType, 1));
+    CHECK_RUN(infinirtMemcpyPeerAsync(dst, 1, src, 0, deviceType, size, stream));
+    CHECK_RUN(infinirtStreamSynchronize(stream));
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), dst, deviceType, 1, size));
+    TEST_EQUAL(result, data);
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    CHECK_RUN(infinirtFree(src, deviceType, 0));
+    CHECK_RUN(infinirtFree(dst, deviceType, 1));
+    return TEST_PASSED;
+}
+
+int test_sim_transfer_cost() {
+    infinirtSimConfig_t saved, config{};
+    CHECK_RUN(infinirtSimGetConfig(&saved));
+    config.h2dBandwidth = 1e9;
+    CHECK_RUN(infinirtSimSetConfig(&config));
+    size_t size = 16 << 20;
+    auto data = std::vector<char>(size, 1);
+    void *dst;
+    CHECK_RUN(infinirtMalloc(&dst, DEVICE_SIM, 0, size));
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, DEVICE_SIM, 0));
+    infinirtEvent_t start, end;
+    CHECK_RUN(infinirtEventCreateWithFlags(&start, DEVICE_SIM, 0, INFINIRT_EVENT_ENABLE_TIMING));
+    CHECK_RUN(infinirtEventCreateWithFlags(&end, DEVICE_SIM, 0, INFINIRT_EVENT_ENABLE_TIMING));
+    auto issued = std::chrono::steady_clock::now();
+    CHECK_RUN(infinirtEventRecord(start, stream));
+    CHECK_RUN(infinirtMemcpyH2DAsync(dst, DEVICE_SIM, 0, data.data(), size, stream));
+    CHECK_RUN(infinirtEventRecord(end, stream));
+    // Issuing does not wait for the modeled transfer.
+    auto issue_ms = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - issued)
+                        .count();
+    CHECK_RUN(infinirtEventSynchronize(end));
+    float ms;
+    CHECK_RUN(infinirtEventElapsedTime(start, end, &ms));
+    // 16 MiB at 1 GB/s takes about 16.8 ms.
+    TEST_TRUE(ms >= 16.0f);
+    TEST_TRUE(issue_ms < ms);
+    CHECK_RUN(infinirtEventDestroy(start));
+    CHECK_RUN(infinirtEventDestroy(end));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    CHECK_RUN(infinirtFree(dst, DEVICE_SIM, 0));
+    CHECK_RUN(infinirtSimSetConfig(&saved));
+    return TEST_PASSED;
+}
+
+int test_sim_capacity() {
+    infinirtSimConfig_t saved, config{};
+    CHECK_RUN(infinirtSimGetConfig(&saved));
+    config.memoryCapacity = 1 << 20;
+    CHECK_RUN(infinirtSimSetConfig(&config));
+    void *a, *b;
+    CHECK_RUN(infinirtMalloc(&a, DEVICE_SIM, 0, 768 << 10));
+    TEST_TRUE(infinirtMalloc(&b, DEVICE_SIM, 0, 512 << 10) ==
+              INFINIRT_STATUS_OUT_OF_MEMORY);
+    // Each device has its own capacity.
+    CHECK_RUN(infinirtMalloc(&b, DEVICE_SIM, 1, 512 << 10));
+    CHECK_RUN(infinirtFree(b, DEVICE_SIM, 1));
+    // Stream-ordered frees return capacity when the stream reaches them.
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, DEVICE_SIM, 0));
+    CHECK_RUN(infinirtFreeAsync(a, DEVICE_SIM, 0, stream));
+    CHECK_RUN(infinirtStreamSynchronize(stream));
+    CHECK_RUN(infinirtMalloc(&b, DEVICE_SIM, 0, 1 << 20));
+    CHECK_RUN(infinirtFree(b, DEVICE_SIM, 0));
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    CHECK_RUN(infinirtSimSetConfig(&saved));
+    return TEST_PASSED;
+}
+
+void test_runtime(DeviceType deviceType) {
+    RUN_TEST(test_load_backend(deviceType));
+    RUN_TEST(test_stream_order(deviceType));
+    RUN_TEST(test_stream_priority(deviceType));
+    RUN_TEST(test_stream_wait_event(deviceType));
+    RUN_TEST(test_event_elapsed_time(deviceType));
+    RUN_TEST(test_mem_pool(deviceType));
+    RUN_TEST(test_host_register(deviceType));
+    RUN_TEST(test_memcpy_peer(deviceType));
+    if (deviceType == DEVICE_SIM) {
+        RUN_TEST(test_load_backend_plugin());
+        RUN_TEST(test_sim_transfer_cost());
+        RUN_TEST(test_sim_capacity());
+    }
+}
@@ -1,6 +1,7 @@
 #include "../../include/infinirt.h"
 #include "../../src/tensor.h"
 #include "../test.h"
+#include <cstdio>
 #include <vector>
 
 #define CHECK_RUN(EXPR)                                                        \
@@ -95,9 +96,183 @@ int test_tensor_slice(DeviceType deviceType) {
     return TEST_PASSED;
 }
 
+int test_tensor_snapshot(DeviceType deviceType) {
+    auto data = std::vector<float>{1.0, 2.0, 3.0, 4.0,  5.0,  6.0,
+                                   7.0, 8.0, 9.0, 10.0, 11.0, 12.0};
+    auto tensor =
+        Tensor::weight(data.data(), INFINI_F32, std::vector<index_t>({2, 3, 2}),
+                       deviceType, 0);
+    auto filename = std::string("/tmp/infini_test_snapshot.bin");
+    // Only the [2, 2, 2] view is written, compacted to row-major order.
+    tensor->slice(1, 1, 2)->save(filename);
+    auto loaded = Tensor::load(filename, deviceType, 0);
+    TEST_TRUE(loaded != nullptr);
+    TEST_EQUAL(loaded->dtype(), INFINI_F32);
+    TEST_EQUAL(loaded->shape(), std::vector<index_t>({2, 2, 2}));
+    TEST_EQUAL(loaded->strides(), std::vector<stride_t>({4, 2, 1}));
+    auto result = std::vector<float>(8);
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), loaded->data(), deviceType, 0,
+                                loaded->byte_size()));
+    auto ans = std::vector<float>{3.0, 4.0, 5.0, 6.0, 9.0, 10.0, 11.0, 12.0};
+    TEST_EQUAL(result, ans);
+    std::remove(filename.c_str());
+    return TEST_PASSED;
+}
+
+// A tensor with a zero-size dimension round-trips with no data.
+int test_tensor_snapshot_empty(DeviceType deviceType) {
+    auto tensor = Tensor::buffer(INFINI_F32, {2, 0, 3}, deviceType, 0);
+    auto filename = std::string("/tmp/infini_test_snapshot_empty.bin");
+    tensor->save(filename);
+    auto loaded = Tensor::load(filename, deviceType, 0);
+    TEST_TRUE(loaded != nullptr);
+    TEST_EQUAL(loaded->shape(), std::vector<index_t>({2, 0, 3}));
+    TEST_EQUAL(loaded->byte_size(), 0);
+    std::remove(filename.c_str());
+    return TEST_PASSED;
+}
+
+// Damaged snapshots are rejected rather than aborting the process.
+int test_tensor_snapshot_corrupt(DeviceType deviceType) {
+    auto data = std::vector<float>{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+    auto tensor = Tensor::weight(data.data(), INFINI_F32,
+                                 std::vector<index_t>({2, 3}), deviceType, 0);
+    auto filename = std::string("/tmp/infini_test_snapshot_corrupt.bin");
+    tensor->save(filename);
+    auto file = fopen(filename.c_str(), "r+b");
+    TEST_TRUE(file != nullptr);
+    auto contents = std::vector<char>(4096);
+    contents.resize(fread(contents.data(), 1, contents.size(), file));
+    // The shape follows the 40-byte header; a larger first dimension no
+    // longer matches the data size.
+    uint64_t dim = 5;
+    fseek(file, 40, SEEK_SET);
+    fwrite(&dim, sizeof(dim), 1, file);
+    fclose(file);
+    TEST_TRUE(Tensor::load(filename, deviceType, 0) == nullptr);
+    // Cut short inside the data.
+    file = fopen(filename.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size() - 4, file);
+    fclose(file);
+    TEST_TRUE(Tensor::load(filename, deviceType, 0) == nullptr);
+    std::remove(filename.c_str());
+    return TEST_PASSED;
+}
+
+int test_tensor_copy(DeviceType deviceType) {
+    if (deviceType != DEVICE_CPU && deviceType != DEVICE_SIM) {
+        // Other devices go through infiniopRearrange, which needs a handle.
+        return TEST_PASSED;
+    }
+    auto data = std::vector<float>(2 * 3 * 4);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (float)i;
+    }
+    auto src = Tensor::weight(data.data(), INFINI_F32,
+                              std::vector<index_t>({2, 3, 4}), deviceType, 0);
+    // Row-strided slice into a contiguous buffer.
+    auto dst = Tensor::buffer(INFINI_F32, {2, 2, 4}, deviceType, 0);
+    dst->copy_from(src->slice(1, 1, 2), nullptr);
+    auto out = (float const *)dst->data();
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            for (size_t k = 0; k < 4; k++) {
+                TEST_EQUAL(out[(i * 2 + j) * 4 + k],
+                           data[(i * 3 + j + 1) * 4 + k]);
+            }
+        }
+    }
+    // Stream-ordered copy; data() waits for it on the host.
+    infinirtStream_t stream;
+    CHECK_RUN(infinirtStreamCreate(&stream, deviceType, 0));
+    auto dst_async = Tensor::buffer(INFINI_F32, {2, 2, 4}, deviceType, 0);
+    dst_async->copy_from(src->slice(1, 1, 2), nullptr, stream);
+    out = (float const *)dst_async->data();
+    for (size_t i = 0; i < 16; i++) {
+        TEST_EQUAL(out[i], ((float const *)dst->data())[i]);
+    }
+    CHECK_RUN(infinirtStreamDestroy(stream));
+    // Transposing copy with no contiguous inner run.
+    auto dst_t = Tensor::buffer(INFINI_F32, {4, 3, 2}, deviceType, 0);
+    dst_t->copy_from(src->slice(0, 0, 2)->permute({2, 1, 0}), nullptr);
+    out = (float const *)dst_t->data();
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            for (size_t k = 0; k < 2; k++) {
+                TEST_EQUAL(out[(i * 3 + j) * 2 + k], data[(k * 3 + j) * 4 + i]);
+            }
+        }
+    }
+    return TEST_PASSED;
+}
+
+int test_memory_account(DeviceType deviceType) {
+    auto account = std::make_shared<MemoryAccount>();
+    auto data = std::vector<float>(16);
+    {
+        MemoryScope weights(account, MEMORY_CATEGORY_WEIGHT);
+        auto w = Tensor::weight(data.data(), INFINI_F32, {16}, deviceType, 0);
+        {
+            MemoryScope cache(account, MEMORY_CATEGORY_KV_CACHE, 1);
+            auto k = Tensor::buffer(INFINI_F32, {4, 8}, deviceType, 0);
+            auto stats = account->stats();
+            TEST_EQUAL(stats.current[MEMORY_CATEGORY_WEIGHT], (size_t)64);
+            TEST_EQUAL(stats.current[MEMORY_CATEGORY_KV_CACHE], (size_t)128);
+        }
+        // The outer scope applies again once the inner one ends.
+        auto b = Tensor::buffer(INFINI_F32, {8}, deviceType, 0);
+        auto stats = account->stats();
+        TEST_EQUAL(stats.current[MEMORY_CATEGORY_WEIGHT], (size_t)96);
+        TEST_EQUAL(stats.current[MEMORY_CATEGORY_KV_CACHE], (size_t)0);
+        TEST_EQUAL(stats.total_peak, (size_t)192);
+    }
+    // Untagged allocations are not charged.
+    auto untracked = Tensor::buffer(INFINI_F32, {8}, deviceType, 0);
+    auto stats = account->stats();
+    TEST_EQUAL(stats.total, (size_t)0);
+    TEST_EQUAL(stats.peak[MEMORY_CATEGORY_KV_CACHE], (size_t)128);
+    return TEST_PASSED;
+}
+
+int test_host_pins(DeviceType deviceType) {
+    if (deviceType == DEVICE_CPU) {
+        // Weights on the host are copied without pinning.
+        return TEST_PASSED;
+    }
+    auto data = std::vector<float>((1 << 24) / sizeof(float), 1.0f);
+    size_t size = data.size() * sizeof(float);
+    {
+        HostPinScope scope(std::make_shared<HostPins>());
+        auto a = Tensor::weight(data.data(), INFINI_F32,
+                                std::vector<index_t>({data.size()}),
+                                deviceType, 0);
+        auto b = Tensor::weight(data.data(), INFINI_F32,
+                                std::vector<index_t>({data.size()}),
+                                deviceType, 0);
+        // Still pinned between and after the uploads.
+        TEST_EQUAL(infinirtHostRegister(data.data(), deviceType, 0, size),
+                   INFINIRT_STATUS_ALREADY_REGISTERED);
+    }
+    CHECK_RUN(infinirtHostRegister(data.data(), deviceType, 0, size));
+    // Uploads of a range the caller pinned leave it registered.
+    auto c = Tensor::weight(data.data(), INFINI_F32,
+                            std::vector<index_t>({data.size()}), deviceType, 0);
+    CHECK_RUN(infinirtHostUnregister(data.data(), deviceType, 0));
+    auto result = std::vector<float>(data.size());
+    CHECK_RUN(infinirtMemcpyD2H(result.data(), c->data(), deviceType, 0, size));
+    TEST_EQUAL(result, data);
+    return TEST_PASSED;
+}
+
 void test_tensor(DeviceType deviceType) {
     RUN_TEST(test_tensor_weight(deviceType));
     RUN_TEST(test_tensor_buffer(deviceType));
     RUN_TEST(test_tensor_reshape(deviceType));
     RUN_TEST(test_tensor_slice(deviceType));
+    RUN_TEST(test_tensor_snapshot(deviceType));
+    RUN_TEST(test_tensor_snapshot_empty(deviceType));
+    RUN_TEST(test_tensor_snapshot_corrupt(deviceType));
+    RUN_TEST(test_tensor_copy(deviceType));
+    RUN_TEST(test_memory_account(deviceType));
+    RUN_TEST(test_host_pins(deviceType));
 }
@@ -2,13 +2,35 @@
 #include <iostream>
 
 int main() {
+    printf("Test runtime functions: CPU\n");
+    test_runtime(DEVICE_CPU);
+    printf("Test tensor functions: CPU\n");
+    test_tensor(DEVICE_CPU);
+    printf("Test runtime functions: Sim\n");
+    test_runtime(DEVICE_SIM);
+    printf("Test tensor functions: Sim\n");
+    test_tensor(DEVICE_SIM);
+    printf("Test host operators\n");
+    test_ops();
+    printf("Test prefix tree\n");
+    test_prefix_tree();
+#ifdef ENABLE_CCL
+    printf("Test CCL functions: CPU\n");
+    test_ccl(DEVICE_CPU);
+    printf("Test CCL functions: Sim\n");
+    test_ccl(DEVICE_SIM);
+#endif
 #ifdef ENABLE_NV_GPU
+    printf("Test runtime functions: Nvidia\n");
+    test_runtime(DEVICE_NVIDIA);
     printf("Test tensor functions: Nvidia\n");
     test_tensor(DEVICE_NVIDIA);
     printf("Test CCL functions: Nvidia\n");
     test_ccl(DEVICE_NVIDIA);
 #endif
 #ifdef ENABLE_ASCEND_NPU
+    printf("Test runtime functions: Ascend\n");
+    test_runtime(DEVICE_ASCEND);
     printf("Test tensor functions: Ascend\n");
     test_tensor(DEVICE_ASCEND);
     printf("Test CCL functions: Ascend\n");
@@ -25,5 +25,8 @@
         }                                                                      \
     } while (0)
 
+void test_runtime(DeviceType);
 void test_tensor(DeviceType);
 void test_ccl(DeviceType);
+void test_ops();
+void test_prefix_tree();
@@ -29,10 +29,18 @@ option("ascend-npu")
     add_defines("ENABLE_ASCEND_NPU")
 option_end()
 
+option("runtime-plugins")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build the Nvidia and Ascend runtimes as plugins that infinirtInit loads, instead of linking them into infinirt")
+    add_defines("ENABLE_RUNTIME_PLUGINS")
+option_end()
+
 option("ccl")
     set_default(true)
     set_showmenu(true)
     set_description("Enable or disable multi-device communication support")
+    add_defines("ENABLE_CCL")
 option_end()
 
 option("infer")
@@ -48,12 +56,20 @@ end
 
 local infini_root = os.getenv("INFINI_ROOT") or os.getenv(is_host("windows") and "HOMEPATH" or "HOME") .. "/.infini"
 
+if has_config("runtime-plugins") then
+    add_defines("ENABLE_RUNTIME_PLUGINS")
+end
+-- With runtime plugins the device targets below only hold the CCL backends.
+local static_runtime = not has_config("runtime-plugins")
+local device_static = static_runtime or has_config("ccl")
+
 if has_config("infer") then
     add_includedirs(infini_root .. "/include")
 end
 
 if has_config("nv-gpu") then
     add_defines("ENABLE_NV_GPU")
+    if device_static then
     target("nv-gpu")
         set_kind("static")
         on_install(function (target) end)
@@ -71,7 +87,9 @@ if has_config("nv-gpu") then
         add_cxflags("-fPIC")
 
         set_languages("cxx17")
-        add_files("src/runtime/cuda/*.cc")
+        if static_runtime then
+            add_files("src/runtime/cuda/*.cc")
+        end
         if has_config("ccl") then
             -- Check if NCCL_ROOT is defined
             local nccl_root = os.getenv("NCCL_ROOT")
@@ -84,6 +102,21 @@ if has_config("nv-gpu") then
             add_files("src/ccl/cuda/*.cc")
         end
     target_end()
+    end
+
+    if has_config("runtime-plugins") then
+    -- Found by infinirtInit next to libinfinirt.
+    target("infinirt_nvidia")
+        set_kind("shared")
+        set_toolchains("cuda")
+        add_links("cudart")
+        set_languages("cxx17")
+        add_defines("INFINIRT_BACKEND_PLUGIN")
+        add_cxflags("-fPIC", "-fvisibility=hidden")
+        add_files("src/runtime/cuda/*.cc")
+        set_installdir(infini_root)
+    target_end()
+    end
 end
 
 if has_config("ascend-npu") then
@@ -104,13 +137,16 @@ if has_config("ascend-npu") then
     add_links("libascend_hal.so")
     add_links("pthread")
 
+    if device_static then
     target("ascend-npu")
         -- Other configs
         set_kind("static")
         set_languages("cxx17")
         on_install(function (target) end)
         -- Add files
-        add_files("src/runtime/ascend/*.cc")
+        if static_runtime then
+            add_files("src/runtime/ascend/*.cc")
+        end
         if has_config("ccl") then
             add_includedirs(ASCEND_HOME .. "/include/hccl")
             add_links("libhccl.so")
@@ -119,20 +155,61 @@ if has_config("ascend-npu") then
         add_cxflags("-lstdc++ -Wall -Werror -fPIC")
 
     target_end()
+    end
+
+    if has_config("runtime-plugins") then
+    target("infinirt_ascend")
+        set_kind("shared")
+        set_languages("cxx17")
+        add_defines("INFINIRT_BACKEND_PLUGIN")
+        add_cxflags("-Wall -Werror -fPIC -fvisibility=hidden")
+        add_files("src/runtime/ascend/*.cc")
+        set_installdir(infini_root)
+    target_end()
+    end
 end
 
+-- The SIM backend built as a plugin, loaded by the runtime tests through
+-- infinirtInit and infinirtLoadBackend.
+target("infinirt_sim")
+    set_kind("shared")
+    set_languages("cxx17")
+    on_install(function (target) end)
+    add_defines("INFINIRT_BACKEND_PLUGIN")
+    add_cxflags("-fvisibility=hidden")
+    add_files("src/runtime/sim/*.cc")
+    add_files("src/runtime/cpu/*.cc")
+    add_files("src/runtime/host_stream.cc")
+    add_syslinks("pthread")
+target_end()
+
 target("infinirt")
     set_kind("shared")
 
-    if has_config("nv-gpu") then
-        add_deps("nv-gpu")
-    end
-    if has_config("ascend-npu") then
-        add_deps("ascend-npu")
+    if has_config("runtime-plugins") then
+        -- Built and installed alongside, loaded at infinirtInit; not linked.
+        if has_config("nv-gpu") then
+            add_deps("infinirt_nvidia", {inherit = false})
+        end
+        if has_config("ascend-npu") then
+            add_deps("infinirt_ascend", {inherit = false})
+        end
+    else
+        if has_config("nv-gpu") then
+            add_deps("nv-gpu")
+        end
+        if has_config("ascend-npu") then
+            add_deps("ascend-npu")
+        end
     end
 
     set_languages("cxx17")
     add_files("src/runtime/runtime.cc")
+    add_files("src/runtime/mem_pool.cc")
+    add_files("src/runtime/host_stream.cc")
+    add_files("src/runtime/cpu/*.cc")
+    add_files("src/runtime/sim/*.cc")
+    add_syslinks("pthread", "dl")
 
     set_installdir(infini_root)
     add_installfiles("include/infinirt.h", {prefixdir = "include"})
@@ -150,10 +227,24 @@ target("infiniccl")
     end
     set_languages("cxx17")
     add_files("src/ccl/infiniccl.cc")
+    add_files("src/ccl/bootstrap.cc")
+    add_files("src/ccl/cpu/*.cc")
+    add_syslinks("pthread", "dl")
 
     set_installdir(infini_root)
     add_installfiles("include/infiniccl.h", {prefixdir = "include"})
 target_end()
+
+target("infiniccl_bench")
+    set_kind("binary")
+    set_languages("cxx17")
+    on_install(function (target) end)
+    add_deps("infinirt")
+    add_deps("infiniccl")
+    add_cxflags("-O2")
+    add_files("test/bench/infiniccl_bench.cc")
+    add_syslinks("pthread")
+target_end()
 end
 
 if has_config("infer") then
@@ -164,6 +255,7 @@ target("infiniinfer")
     add_links(infini_root .. "/lib/libinfiniop.so")
     set_languages("cxx17")
     add_files("src/models/*.cc")
+    add_files("src/ops/*.cc")
     add_files("src/tensor/*.cc")
     add_includedirs("src")
 
@@ -178,26 +270,47 @@ target("infini_infer_test")
     set_languages("cxx17")
     on_install(function (target) end)
     add_includedirs("src")
-    if has_config("nv-gpu") then
+    if has_config("nv-gpu") and device_static then
         add_deps("nv-gpu")
     end
-    if has_config("ascend-npu") then
+    if has_config("ascend-npu") and device_static then
         add_deps("ascend-npu")
     end
+    -- Built next to the test binary, which dlopens them; not linked.
+    add_deps("infinirt_sim", {inherit = false})
+    if has_config("runtime-plugins") then
+        if has_config("nv-gpu") then
+            add_deps("infinirt_nvidia", {inherit = false})
+        end
+        if has_config("ascend-npu") then
+            add_deps("infinirt_ascend", {inherit = false})
+        end
+    end
     add_cxflags("-g", "-O0")
     add_ldflags("-g")
     add_files("test/test.cc")
+    add_files("test/runtime/*.cc")
     add_files("test/tensor/*.cc")
+    add_files("test/ops/*.cc")
+    add_files("test/model/*.cc")
     add_files("src/runtime/runtime.cc")
+    add_files("src/runtime/mem_pool.cc")
+    add_files("src/runtime/host_stream.cc")
+    add_files("src/runtime/cpu/*.cc")
+    add_files("src/runtime/sim/*.cc")
     if has_config("ccl") then
         add_files("src/ccl/infiniccl.cc")
+        add_files("src/ccl/bootstrap.cc")
+        add_files("src/ccl/cpu/*.cc")
         add_files("test/ccl/*.cc")
     end
 
     add_files("src/models/*.cc")
+    add_files("src/ops/*.cc")
     add_links(infini_root .. "/lib/libinfiniop.so")
     add_files("src/tensor/*.cc")
     add_cxflags("-lstdc++ -Wall -fPIC")
+    add_syslinks("pthread", "dl")
 
     if has_config("omp") then
         add_cxflags("-fopenmp")